@@ -1,12 +1,26 @@
 /* TODO: Calibrate DMATransferSize for each SPI_CLK value */
 
 #include "DMA_SPI_Interface.h"
+#include "HRADC_Boards.h"
+#include "common/timestamp.h"
+#include "ipc/ipc.h"
 
 __interrupt void local_D_INTCH1_ISR(void);
 __interrupt void local_D_INTCH2_ISR(void);
+__interrupt void isr_HRADC_frame(void);
+void poll_HRADC_frame(void);
 void Init_DMA_McBSP_nBuffers(Uint16 n_buffers, Uint16 size_buffers, Uint16 spiClk);
 void start_DMA(void);
 void stop_DMA(void);
+Uint16 cfg_decimation_HRADC(Uint16 order, Uint16 enable_fir);
+Uint16 burst_McBSP_DMA(volatile Uint16 *rx_buffer, Uint16 n_words);
+
+static void reset_frames_HRADC(void);
+static void process_HRADC_frame(void);
+
+#pragma CODE_SECTION(isr_HRADC_frame, "ramfuncs");
+#pragma CODE_SECTION(poll_HRADC_frame, "ramfuncs");
+#pragma CODE_SECTION(process_HRADC_frame, "ramfuncs");
 
 //#pragma DATA_SECTION(buffers_HRADC, "SHARERAMS1_1")
 
@@ -19,11 +33,72 @@ volatile Uint16 DMATransferSize[5][4] = { {1, 15, 45, 60},
 volatile Uint32 i_rdata;
 volatile Uint32 dummy_data = 0x00000000;
 //volatile tbuffers_HRADC buffers_HRADC;
-volatile Uint32 buffers_HRADC[4][HRADC_BUFFERS_SIZE];
+volatile Uint32 buffers_HRADC[2][HRADC_MAX_BOARDS][HRADC_BUFFERS_SIZE];
+
+volatile tHRADC_Frame frames_HRADC[2];
+volatile tHRADC_Frame *p_frame_HRADC;
+volatile Uint32 overruns_HRADC;
+volatile Uint32 invalid_stamps_HRADC;
+volatile Uint32 latency_HRADC;
+volatile Uint32 latency_max_HRADC;
+
+static Uint16 n_boards_frame;
+Uint16 size_frame_HRADC;
+static Uint16 half_DMA;						// Half of current frame
+static Uint16 polled_frame;					// Pending frame interrupt already served
+
+static decimator_t decimators_HRADC[HRADC_MAX_BOARDS];
+static Uint16 order_decimation = 1;
+static Uint16 enable_fir_decimation = 0;
 
 void Init_DMA_McBSP_nBuffers(Uint16 n_buffers, Uint16 size_buffers, Uint16 spiClk)
 {
-
+  Uint16 i, j, k;
+
+  HRADCs_Info.fault = 0;
+
+  // Frames wouldn't match control period, so power supplies can't be turned on
+  if( (size_buffers < 1) || (size_buffers > HRADC_BUFFERS_SIZE) ||
+	  (n_buffers < 1) || (n_buffers > HRADC_MAX_BOARDS) )
+  {
+	  HRADCs_Info.fault |= HRADC_FAULT_CONFIG;
+	  send_ipc_lowpriority_msg(size_buffers, HRADC_Config_Error);
+
+	  size_buffers = (size_buffers < 1) ? 1 : HRADC_BUFFERS_SIZE;
+	  n_buffers = (n_buffers < 1) ? 1 : ((n_buffers > HRADC_MAX_BOARDS) ? HRADC_MAX_BOARDS : n_buffers);
+  }
+
+  n_boards_frame = n_buffers;
+  size_frame_HRADC = size_buffers;
+
+  for(i = 0; i < 2; i++)
+  {
+	  for(j = 0; j < HRADC_MAX_BOARDS; j++)
+	  {
+		  for(k = 0; k < HRADC_BUFFERS_SIZE; k++)
+		  {
+			  buffers_HRADC[i][j][k] = 0;
+		  }
+
+		  frames_HRADC[i].samples[j] = 0.0;
+	  }
+
+	  frames_HRADC[i].counter = 0;
+	  frames_HRADC[i].timestamp = 0;
+	  frames_HRADC[i].carrier_phase = 0.0;
+	  frames_HRADC[i].valid = 0;
+  }
+
+  p_frame_HRADC = &frames_HRADC[0];
+  overruns_HRADC = 0;
+  invalid_stamps_HRADC = 0;
+  latency_HRADC = 0;
+  latency_max_HRADC = 0;
+
+  if(cfg_decimation_HRADC(order_decimation, enable_fir_decimation))
+  {
+	  cfg_decimation_HRADC(1, 0);
+  }
 
   i_rdata = 0;
 
@@ -86,9 +161,14 @@ void Init_DMA_McBSP_nBuffers(Uint16 n_buffers, Uint16 size_buffers, Uint16 spiCl
   //   Set the destination to the start of the receive buffer
   //
   DmaRegs.CH1.SRC_ADDR_SHADOW = (Uint32) &McbspaRegs.DRR2.all;
-  DmaRegs.CH1.DST_ADDR_SHADOW = ((Uint32) &buffers_HRADC) + 1;
+  //   First frame is written in half 0 of ping-pong buffers
+  //
   DmaRegs.CH1.SRC_BEG_ADDR_SHADOW = (Uint32) &McbspaRegs.DRR2.all;
-  DmaRegs.CH1.DST_BEG_ADDR_SHADOW = ((Uint32) &buffers_HRADC) + 1;
+  EDIS;
+
+  reset_frames_HRADC();
+
+  EALLOW;
   //
   // Clear sync flag and error flag
   //
@@ -135,12 +215,67 @@ void Init_DMA_McBSP_nBuffers(Uint16 n_buffers, Uint16 size_buffers, Uint16 spiCl
   XIntruptRegs.XINT1CR.bit.POLARITY = 0;   // XINT1 (HRADC_BUSY_OUT) negative-edge triggering
   XIntruptRegs.XINT1CR.bit.ENABLE = 1;	   // XINT1 Enable
 
-  DmaRegs.CH1.MODE.bit.CHINTE = 0;
+  //
+  // Receive channel interrupts at end of each transfer (frame). Shadow
+  // registers are only loaded by next McBSP event, so ISR has one sampling
+  // period to point them to the other half of ping-pong buffers
+  //
+  DmaRegs.CH1.MODE.bit.CHINTE = 1;
   DmaRegs.CH1.MODE.bit.CHINTMODE = 1;
   DmaRegs.CH1.MODE.bit.PERINTE = 1;
   DmaRegs.CH1.MODE.bit.PERINTSEL = DMA_MREVTA;
   DmaRegs.CH1.CONTROL.bit.PERINTCLR = 1;
+
+  PieVectTable.DINTCH1 = &isr_HRADC_frame;
   EDIS;
+
+  PieCtrlRegs.PIEIER7.bit.INTx1 = 1;
+  IER |= M_INT7;
+}
+
+//*****************************************************************************
+// Configure CIC decimators of all HRADC boards. Order must be compatible with
+// frame size (see common/decimator.h). Returns 1 if arguments are invalid.
+//*****************************************************************************
+Uint16 cfg_decimation_HRADC(Uint16 order, Uint16 enable_fir)
+{
+    Uint16 i, int_status, error;
+
+    int_status = __disable_interrupts();
+
+    error = 0;
+    for(i = 0; (i < HRADC_MAX_BOARDS) && !error; i++)
+    {
+        error = cfg_decimator(&decimators_HRADC[i], order, size_frame_HRADC,
+                              enable_fir);
+    }
+
+    if(!error)
+    {
+        order_decimation = order;
+        enable_fir_decimation = enable_fir;
+
+        // Decimation cost depends on order
+        latency_max_HRADC = 0;
+    }
+
+    __restore_interrupts(int_status);
+
+    return error;
+}
+
+//*****************************************************************************
+// Point DMA receive channel to first half of ping-pong buffers
+//*****************************************************************************
+static void reset_frames_HRADC(void)
+{
+    half_DMA = 0;
+    polled_frame = 0;
+
+    EALLOW;
+    DmaRegs.CH1.DST_ADDR_SHADOW = ((Uint32) &buffers_HRADC[0][0][0]) + 1;
+    DmaRegs.CH1.DST_BEG_ADDR_SHADOW = ((Uint32) &buffers_HRADC[0][0][0]) + 1;
+    EDIS;
 }
 //*****************************************************************************
 // Start DMA transmit and receive from McBSP A
@@ -153,6 +288,8 @@ void start_DMA(void)
     // Disable access to protected registers (EDIS)
     //
 
+    reset_frames_HRADC();
+
     EALLOW;
     DmaRegs.CH1.CONTROL.bit.RUN = 1;
     DmaRegs.CH2.CONTROL.bit.RUN = 1;
@@ -190,6 +327,106 @@ void stop_DMA(void)
     EDIS;
 }
 
+//*****************************************************************************
+// Burst transfer of n_words from McBSP A into rx_buffer, transmitting dummy
+// words, for UFM access on HRADC boards. McBSP word length is kept as
+// configured. Channels 5 (receive) and 6 (transmit) are used, so sampling
+// channels don't need to be reconfigured, but they must be stopped.
+//
+// Transmission is kept back-to-back by DMA, instead of waiting each word to
+// be received as CPU polling does. Returns 1 on timeout (10 us per word).
+//*****************************************************************************
+Uint16 burst_McBSP_DMA(volatile Uint16 *rx_buffer, Uint16 n_words)
+{
+    Uint16 timeout;
+
+    if(!n_words)
+    {
+        return 0;
+    }
+
+    EALLOW;
+
+    DmaRegs.CH5.CONTROL.bit.SOFTRESET = 1;
+    DmaRegs.CH6.CONTROL.bit.SOFTRESET = 1;
+    __asm(" NOP");
+
+    //
+    // Receive: McBSP DRR1 -> rx_buffer, one word per burst
+    //
+    DmaRegs.CH5.BURST_SIZE.all = 0;
+    DmaRegs.CH5.SRC_BURST_STEP = 0;
+    DmaRegs.CH5.DST_BURST_STEP = 0;
+    DmaRegs.CH5.TRANSFER_SIZE = n_words - 1;
+    DmaRegs.CH5.SRC_TRANSFER_STEP = 0;
+    DmaRegs.CH5.DST_TRANSFER_STEP = 1;
+    DmaRegs.CH5.SRC_ADDR_SHADOW = (Uint32) &McbspaRegs.DRR1.all;
+    DmaRegs.CH5.SRC_BEG_ADDR_SHADOW = (Uint32) &McbspaRegs.DRR1.all;
+    DmaRegs.CH5.DST_ADDR_SHADOW = (Uint32) rx_buffer;
+    DmaRegs.CH5.DST_BEG_ADDR_SHADOW = (Uint32) rx_buffer;
+    DmaRegs.CH5.SRC_WRAP_SIZE = 0xFFFF;
+    DmaRegs.CH5.DST_WRAP_SIZE = 0xFFFF;
+    DmaRegs.CH5.SRC_WRAP_STEP = 0;
+    DmaRegs.CH5.DST_WRAP_STEP = 0;
+    DmaRegs.CH5.MODE.bit.CONTINUOUS = 0;
+    DmaRegs.CH5.MODE.bit.ONESHOT = 0;
+    DmaRegs.CH5.MODE.bit.CHINTE = 0;
+    DmaRegs.CH5.MODE.bit.PERINTE = 1;
+    DmaRegs.CH5.MODE.bit.PERINTSEL = DMA_MREVTA;
+    DmaRegs.CH5.CONTROL.bit.PERINTCLR = 1;
+    DmaRegs.CH5.CONTROL.bit.ERRCLR = 1;
+
+    //
+    // Transmit: dummy_data -> McBSP DXR1. McBSP transmitter is already
+    // ready, so it won't generate an event for the first word, which is
+    // written by CPU. DMA transmits the remaining n_words - 1.
+    //
+    DmaRegs.CH6.BURST_SIZE.all = 0;
+    DmaRegs.CH6.SRC_BURST_STEP = 0;
+    DmaRegs.CH6.DST_BURST_STEP = 0;
+    DmaRegs.CH6.TRANSFER_SIZE = n_words - 2;
+    DmaRegs.CH6.SRC_TRANSFER_STEP = 0;
+    DmaRegs.CH6.DST_TRANSFER_STEP = 0;
+    DmaRegs.CH6.SRC_ADDR_SHADOW = (Uint32) &dummy_data;
+    DmaRegs.CH6.SRC_BEG_ADDR_SHADOW = (Uint32) &dummy_data;
+    DmaRegs.CH6.DST_ADDR_SHADOW = (Uint32) &McbspaRegs.DXR1.all;
+    DmaRegs.CH6.DST_BEG_ADDR_SHADOW = (Uint32) &McbspaRegs.DXR1.all;
+    DmaRegs.CH6.SRC_WRAP_SIZE = 0xFFFF;
+    DmaRegs.CH6.DST_WRAP_SIZE = 0xFFFF;
+    DmaRegs.CH6.SRC_WRAP_STEP = 0;
+    DmaRegs.CH6.DST_WRAP_STEP = 0;
+    DmaRegs.CH6.MODE.bit.CONTINUOUS = 0;
+    DmaRegs.CH6.MODE.bit.ONESHOT = 0;
+    DmaRegs.CH6.MODE.bit.CHINTE = 0;
+    DmaRegs.CH6.MODE.bit.PERINTE = 1;
+    DmaRegs.CH6.MODE.bit.PERINTSEL = DMA_MXEVTA;
+    DmaRegs.CH6.CONTROL.bit.PERINTCLR = 1;
+    DmaRegs.CH6.CONTROL.bit.ERRCLR = 1;
+
+    DmaRegs.CH5.CONTROL.bit.RUN = 1;
+
+    if(n_words > 1)
+    {
+        DmaRegs.CH6.CONTROL.bit.RUN = 1;
+    }
+
+    EDIS;
+
+    McbspaRegs.DXR1.all = 0x0000;
+
+    for(timeout = 10 * n_words; DmaRegs.CH5.CONTROL.bit.RUNSTS && timeout; timeout--)
+    {
+        DELAY_US(1);
+    }
+
+    EALLOW;
+    DmaRegs.CH5.CONTROL.bit.HALT = 1;
+    DmaRegs.CH6.CONTROL.bit.HALT = 1;
+    EDIS;
+
+    return (timeout == 0);
+}
+
 //*****************************************************************************
 // DMA Channel 1 interrupt service routine
 //*****************************************************************************
@@ -242,3 +479,147 @@ __interrupt void local_D_INTCH2_ISR(void)
     EDIS;
     return;
 }
+
+//*****************************************************************************
+// HRADC frame interrupt service routine
+//
+// Triggered by DMA receive channel at the end of each frame. Frame is
+// processed here, unless control ISR has already done it through
+// poll_HRADC_frame() while this interrupt was pending.
+//*****************************************************************************
+__interrupt void isr_HRADC_frame(void)
+{
+    if(polled_frame)
+    {
+        polled_frame = 0;
+    }
+    else
+    {
+        process_HRADC_frame();
+    }
+
+    PieCtrlRegs.PIEACK.all = PIEACK_GROUP7;
+}
+
+//*****************************************************************************
+// Process pending HRADC frame from control ISR
+//
+// Frame interrupt (PIE group 7) has lower priority than control ISR (ePWM1,
+// group 3), and neither preempts the other, so a frame completed right
+// before control ISR would only be serviced after it. Called at the start of
+// control ISR, this processes such a pending frame, and its interrupt, still
+// to be serviced, does nothing.
+//*****************************************************************************
+void poll_HRADC_frame(void)
+{
+    if(PieCtrlRegs.PIEIFR7.bit.INTx1 && !polled_frame)
+    {
+        process_HRADC_frame();
+        polled_frame = 1;
+    }
+}
+
+//*****************************************************************************
+// Process completed HRADC frame
+//
+// Points DMA to the other half of ping-pong buffers for the next frame,
+// decimates the frame just completed and publishes it through p_frame_HRADC,
+// stamped with time and carrier phase of its last conversion, unless ePWM10
+// has wrapped since then. Its duration, which delays the control ISR, is
+// measured on latency_HRADC.
+//*****************************************************************************
+static void process_HRADC_frame(void)
+{
+    Uint16 i, half, counter_soc, counter_busy, counter_carrier, valid;
+    int32 phase_soc, period_carrier;
+    Uint32 latency;
+    Uint64 timestamp;
+    volatile tHRADC_Frame *p_frame;
+
+    // Counters are read first, close to each other, since ePWM time-bases,
+    // XINT1 counter and timestamp all count at CPU clock
+    counter_soc = EPwm10Regs.TBCTR;
+    counter_busy = XIntruptRegs.XINT1CTR;
+    counter_carrier = EPwm1Regs.TBCTR;
+    timestamp = get_timestamp64();
+
+    // Last SoC must precede last end of conversion, which must be the one
+    // of this frame, i.e., no later conversion is being transferred.
+    // XEMPTY is active low.
+    valid = (counter_busy < counter_soc) && !McbspaRegs.SPCR2.bit.XEMPTY &&
+            !DmaRegs.CH1.CONTROL.bit.TRANSFERSTS;
+
+    half = half_DMA;
+
+    // DMA is pointed to the other half before checking whether next frame
+    // has started, so a McBSP event between both can't go unnoticed
+    EALLOW;
+    DmaRegs.CH1.DST_ADDR_SHADOW = ((Uint32) &buffers_HRADC[half ^ 1][0][0]) + 1;
+    DmaRegs.CH1.DST_BEG_ADDR_SHADOW = ((Uint32) &buffers_HRADC[half ^ 1][0][0]) + 1;
+    EDIS;
+
+    // If next frame has already started with former shadow registers, it's
+    // overwriting the completed one, which is discarded. Since the frame after
+    // it goes to the other half, next interrupt will find it in the same half.
+    // Decimators are still run, with their outputs discarded, on the previous
+    // frame, which is complete in the other half, so CIC integrators and
+    // combs keep advancing one frame per frame.
+    if( DmaRegs.CH1.CONTROL.bit.TRANSFERSTS &&
+        (DmaRegs.CH1.DST_BEG_ADDR_ACTIVE == ((Uint32) &buffers_HRADC[half][0][0]) + 1) )
+    {
+        for(i = 0; i < n_boards_frame; i++)
+        {
+            run_decimator(&decimators_HRADC[i], buffers_HRADC[half ^ 1][i]);
+        }
+
+        overruns_HRADC++;
+        return;
+    }
+
+    half_DMA = half ^ 1;
+
+    // Decimate into the frame not being read by control ISR
+    if(p_frame_HRADC == &frames_HRADC[0])
+    {
+        p_frame = &frames_HRADC[1];
+    }
+    else
+    {
+        p_frame = &frames_HRADC[0];
+    }
+
+    for(i = 0; i < n_boards_frame; i++)
+    {
+        p_frame->samples[i] = run_decimator(&decimators_HRADC[i],
+                                            buffers_HRADC[half][i]);
+    }
+
+    // Carrier counter when last SoC happened, unwrapped to current period
+    period_carrier = (int32) EPwm1Regs.TBPRD + 1;
+    phase_soc = (int32) counter_carrier - (int32) counter_soc;
+
+    while(phase_soc < 0)
+    {
+        phase_soc += period_carrier;
+    }
+
+    p_frame->timestamp = timestamp - counter_soc;
+    p_frame->carrier_phase = (float) phase_soc / (float) period_carrier;
+    p_frame->valid = valid;
+
+    if(!valid)
+    {
+        invalid_stamps_HRADC++;
+    }
+
+    p_frame->counter = p_frame_HRADC->counter + 1;
+    p_frame_HRADC = p_frame;
+
+    latency = GET_TIMESTAMP - (Uint32) timestamp;
+    latency_HRADC = latency;
+
+    if(latency > latency_max_HRADC)
+    {
+        latency_max_HRADC = latency;
+    }
+}
@@ -1,10 +1,66 @@
 #include "DSP28x_Project.h"
+#include "common/decimator.h"
 //#include "../C28 Project/config.h"
 
 #ifndef DMA_SPI_INTERFACE_H
 #define DMA_SPI_INTERFACE_H
 
-#define HRADC_BUFFERS_SIZE	64
+/*
+ * Samples from HRADC boards are received by DMA in ping-pong buffers: while
+ * one frame of n_buffers x size_buffers samples is written in one half, the
+ * last completed frame is kept in the other. At the end of each frame, DMA
+ * interrupts CPU, which points DMA to the other half for the next frame and
+ * decimates the completed one. Control ISRs always read the last decimated
+ * frame through p_frame_HRADC, and don't depend on DMA position.
+ *
+ * Decimation uses a CIC filter per board (see common/decimator.h), whose
+ * order and droop compensation are set by cfg_decimation_HRADC(). Default is
+ * first-order without compensation, i.e., a boxcar sum over the frame. Since
+ * reconfiguration clears decimator states, and its first outputs are
+ * transients, it's only allowed while all power supplies are off.
+ *
+ * Frame interrupt (PIE group 7) has lower priority than control ISR (ePWM1,
+ * group 3), so if both are pending, control ISR would run first and miss the
+ * frame just completed. To enforce their ordering, Get_HRADC_Samples() calls
+ * poll_HRADC_frame(), which processes a frame whose interrupt is pending, and
+ * the frame ISR then finds nothing to do.
+ *
+ * Since the frame is completed right before the control ISR, which can't
+ * preempt the frame ISR, decimation adds to control ISR latency. Its cost
+ * grows as n_buffers x size_buffers x order, and duration of the frame ISR
+ * is measured on every frame, in CPU cycles, on latency_HRADC (last) and
+ * latency_max_HRADC (maximum since last configuration), so the added latency
+ * of each configuration can be checked on target.
+ *
+ * If the frame interrupt is serviced after next frame has started, the
+ * completed frame is discarded and counted on overruns_HRADC. Control ISR
+ * then gets the previous frame again, which is reported by
+ * Get_HRADC_Samples() (see HRADC_Boards.h).
+ *
+ * Each frame is stamped with the 64-bit timestamp (see common/timestamp.h) of
+ * its last conversion, i.e., last SoC from ePWM10, and the phase of PWM
+ * carrier (ePWM1, which triggers control ISR) at that instant. Both time-bases
+ * count at CPU clock, so SoC instant is obtained from ePWM10 counter when the
+ * frame interrupt is serviced, which must happen before next SoC.
+ *
+ * If it's serviced later, ePWM10 has wrapped and the stamp would be one SoC
+ * period late. This is detected by sampling, along with the counters, the
+ * time since last end of conversion (XINT1 counter, from HRADC busy) and
+ * whether a later conversion is being transferred (McBSP transmitter or DMA
+ * receive channel active). Such stamps are marked as invalid and counted on
+ * invalid_stamps_HRADC.
+ */
+#define HRADC_BUFFERS_SIZE	64		// Maximum decimation factor
+#define HRADC_MAX_BOARDS	4
+
+typedef volatile struct
+{
+	Uint32	counter;						// Number of completed frames
+	float	samples[HRADC_MAX_BOARDS];		// Decimated raw samples, as sum
+	Uint64	timestamp;						// Last conversion [CPU cycles]
+	float	carrier_phase;					// Last conversion [pu of carrier period]
+	Uint16	valid;							// Timestamp and carrier phase are valid
+} tHRADC_Frame;
 
 typedef volatile struct
 {
@@ -16,13 +72,23 @@ typedef volatile struct
 
 extern __interrupt void local_D_INTCH1_ISR(void);
 extern __interrupt void local_D_INTCH2_ISR(void);
+extern __interrupt void isr_HRADC_frame(void);
+extern void poll_HRADC_frame(void);
 extern void Init_DMA_McBSP_nBuffers(Uint16 n_buffers, Uint16 size_buffers, Uint16 spiClk);
 extern void start_DMA(void);
 extern void stop_DMA(void);
+extern Uint16 cfg_decimation_HRADC(Uint16 order, Uint16 enable_fir);
+extern Uint16 burst_McBSP_DMA(volatile Uint16 *rx_buffer, Uint16 n_words);
 
 extern volatile Uint32 i_rdata;
 extern volatile Uint32 dummy_data;
 //extern volatile tbuffers_HRADC buffers_HRADC;
-extern volatile Uint32 buffers_HRADC[4][HRADC_BUFFERS_SIZE];
+extern volatile Uint32 buffers_HRADC[2][HRADC_MAX_BOARDS][HRADC_BUFFERS_SIZE];
+extern volatile tHRADC_Frame *p_frame_HRADC;
+extern volatile Uint32 overruns_HRADC;
+extern volatile Uint32 invalid_stamps_HRADC;
+extern volatile Uint32 latency_HRADC;
+extern volatile Uint32 latency_max_HRADC;
+extern Uint16 size_frame_HRADC;
 
 #endif	/* DMA_SPI_INTERFACE_H */
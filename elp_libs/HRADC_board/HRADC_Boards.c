@@ -14,8 +14,13 @@
  */
 
 #include <math.h>
+#include <string.h>
 #include "HRADC_Boards.h"
+#include "common/timestamp.h"
+#include "event_manager/event_manager.h"
+#include "ipc/ipc.h"
 #include "pwm/pwm.h"
+#include "sync/sync.h"
 
 /**********************************************************************************************/
 //
@@ -24,11 +29,22 @@
 void Init_HRADC_Info(volatile HRADC_struct *hradcPtr, Uint16 ID, Uint16 buffer_size, volatile Uint32 *buffer, float transducer_gain);
 void Config_HRADC_board(volatile HRADC_struct *hradcPtr, eInputType AnalogInput, Uint16 enHeater, Uint16 enRails);
 Uint16 Try_Config_HRADC_board(volatile HRADC_struct *hradcPtr, eInputType AnalogInput, Uint16 enHeater, Uint16 enRails);
+void Request_HRADC_board(Uint16 ID, Uint16 buffer_size, volatile Uint32 *buffer, float transducer_gain,
+						 eInputType AnalogInput, Uint16 enHeater, Uint16 enRails);
+Uint16 Bringup_HRADC_boards(Uint16 n_boards);
 
 void SendCommand_HRADC(volatile HRADC_struct *hradcPtr, Uint16 command);
 Uint16 CheckStatus_HRADC(volatile HRADC_struct *hradcPtr);
 
 void Config_HRADC_SoC(float freq);
+void Update_HRADC_Calibration(void);
+Uint16 Get_HRADC_Samples(float *samples);
+Uint16 Set_HRADC_Boards_PS(Uint16 id, Uint16 boards);
+Uint16 Is_HRADC_Fault(Uint16 id);
+void Reset_HRADC_Fault(void);
+Uint16 Config_HRADC_Offline_Calibration(Uint16 enable, float period);
+void Run_HRADC_Offline_Calibration(void);
+Uint16 Is_HRADC_Offline_Calibration_Busy(void);
 void Enable_HRADC_Sampling(void);
 void Disable_HRADC_Sampling(void);
 
@@ -36,10 +52,21 @@ void Config_HRADC_Sampling_OpMode(Uint16 ID, Uint16 spiClk);
 void Config_HRADC_UFM_OpMode(Uint16 ID);
 
 void Erase_HRADC_UFM(Uint16 ID);
-void Read_HRADC_UFM(Uint16 ID, Uint16 ufm_address, Uint16 n_words, volatile Uint16 *ufm_buffer);
+Uint16 Read_HRADC_UFM(Uint16 ID, Uint16 ufm_address, Uint16 n_words, volatile Uint16 *ufm_buffer);
 void Write_HRADC_UFM(Uint16 ID, Uint16 ufm_address, Uint16 data);
 
-void Read_HRADC_BoardData(HRADC_struct *hradcPtr);
+Uint16 Read_HRADC_BoardData(HRADC_struct *hradcPtr);
+Uint16 Write_HRADC_BoardData(Uint16 ID, uHRADC_BoardData *data);
+Uint16 Is_PS_Off(void);
+
+static Uint16 CRC16_HRADC_UFM(volatile Uint16 *data, Uint16 n_words);
+static Uint16 Is_HRADC_BoardData_Plausible(uHRADC_BoardData *data);
+
+static Uint16 Set_HRADC_Config(volatile HRADC_struct *hradcPtr, eInputType AnalogInput, Uint16 enHeater, Uint16 enRails);
+static Uint16 Is_HRADC_Input(volatile HRADC_struct *hradcPtr, eInputType AnalogInput);
+static void Turn_Off_All_PS(Uint16 fault, float value);
+static Uint16 Switch_HRADC_Input(Uint16 ID, eInputType AnalogInput);
+static void Update_HRADC_Drift(Uint16 ID);
 
 /**********************************************************************************************/
 //
@@ -65,6 +92,42 @@ volatile float AverageFilter;
 
 volatile Uint32 HRADC_BoardSelector[4] = GPE_PORT_BITS_HRADC_CS;
 
+// Double buffered, so background may update the copy not being read by control ISR
+tHRADC_Calibration HRADC_Calibration[2];
+tHRADC_Calibration *p_HRADC_Calibration = &HRADC_Calibration[0];
+
+tHRADC_OfflineCalib HRADC_OfflineCalib;
+
+tHRADC_Bringup HRADC_Bringup[N_MAX_HRADC];
+
+tHRADC_BoardDataCache HRADC_BoardData_Cache[N_MAX_HRADC];
+
+// UFM bytes received by DMA, and board data read back for verification
+static volatile Uint16 ufm_burst_bytes[2*UFM_BURST_MAX_WORDS];
+static volatile Uint16 ufm_verify[UFM_BOARDDATA_SIZE];
+
+// Sources measured on each offline calibration slot, in this order
+static const eInputType HRADC_Calib_Sources[HRADC_CALIB_N_SOURCES] = {Vref_bipolar_p,
+																	  Vref_bipolar_n, GND};
+#define CALIB_VREF_P	0
+#define CALIB_VREF_N	1
+#define CALIB_GND		2
+
+// Board held on its last value during offline calibration slot (N_MAX_HRADC if none)
+static Uint16 hold_HRADC = N_MAX_HRADC;
+static float hold_value_HRADC;
+
+// Frames reused by control ISR, since last new one (loss is latched on HRADCs_Info.fault)
+static Uint32 counter_last_frame_HRADC = 0;
+static Uint16 counter_stale_HRADC = 0;
+
+// Bitmask of boards used by each power supply, for which their failure is a fault. Unset
+// entries (0) mean all boards, which fits power supplies using a single module.
+static Uint16 boards_PS_HRADC[NUM_MAX_PS_MODULES] = {0};
+
+#pragma CODE_SECTION(Get_HRADC_Samples, "ramfuncs");
+#pragma CODE_SECTION(Turn_Off_All_PS, "ramfuncs");
+
 /**********************************************************************************************/
 //
 //	Initialize information of selected HRADC board
@@ -72,10 +135,6 @@ volatile Uint32 HRADC_BoardSelector[4] = GPE_PORT_BITS_HRADC_CS;
 
 void Init_HRADC_Info(volatile HRADC_struct *hradcPtr, Uint16 ID, Uint16 buffer_size, volatile Uint32 *buffer, float transducer_gain )
 {
-    static Uint16 spiClk;
-
-    spiClk = McbspaRegs.SRGR1.bit.CLKGDV;
-
 	hradcPtr->ID = ID;
 	hradcPtr->index_SamplesBuffer = 0;
 	hradcPtr->size_SamplesBuffer = buffer_size;
@@ -88,12 +147,10 @@ void Init_HRADC_Info(volatile HRADC_struct *hradcPtr, Uint16 ID, Uint16 buffer_s
 
 	hradcPtr->SamplesBuffer = buffer;
 
-	Config_HRADC_UFM_OpMode(ID);
+	memset(&HRADC_OfflineCalib.drift[ID], 0, sizeof(tHRADC_Drift));
 
 	Read_HRADC_BoardData(hradcPtr);
 
-	Config_HRADC_Sampling_OpMode(ID, spiClk);
-
 	if( isinf(hradcPtr->BoardData.t.gain_Vin_bipolar) ||
 	    isnan(hradcPtr->BoardData.t.gain_Vin_bipolar) )
 	{
@@ -109,8 +166,17 @@ void Init_HRADC_Info(volatile HRADC_struct *hradcPtr, Uint16 ID, Uint16 buffer_s
     hradcPtr->BoardData.t.gain_Vin_bipolar *= 		transducer_gain * HRADC_VIN_BI_P_GAIN;
     hradcPtr->BoardData.t.offset_Vin_bipolar -= 	hradcPtr->BoardData.t.gain_Vin_bipolar*HRADC_BI_OFFSET;
 
-    hradcPtr->BoardData.t.gain_Iin_bipolar   *= transducer_gain * (1.0/(hradcPtr->BoardData.t.Rburden * HRADC_BI_OFFSET));
-    hradcPtr->BoardData.t.offset_Iin_bipolar -=		hradcPtr->BoardData.t.gain_Iin_bipolar*HRADC_BI_OFFSET;
+    // Without burden resistor, current input can't be calibrated
+    if(hradcPtr->BoardData.t.Rburden > 0.0)
+    {
+        hradcPtr->BoardData.t.gain_Iin_bipolar   *= transducer_gain * (1.0/(hradcPtr->BoardData.t.Rburden * HRADC_BI_OFFSET));
+        hradcPtr->BoardData.t.offset_Iin_bipolar -=		hradcPtr->BoardData.t.gain_Iin_bipolar*HRADC_BI_OFFSET;
+    }
+    else
+    {
+        hradcPtr->BoardData.t.gain_Iin_bipolar =    0.0;
+        hradcPtr->BoardData.t.offset_Iin_bipolar =  0.0;
+    }
 
     hradcPtr->gain = hradcPtr->BoardData.t.gain_Vin_bipolar;
     hradcPtr->offset = hradcPtr->BoardData.t.offset_Vin_bipolar;
@@ -129,37 +195,7 @@ void Config_HRADC_board(volatile HRADC_struct *hradcPtr, eInputType AnalogInput,
 		return;
 	}
 
-	switch(AnalogInput)
-	{
-		case Vin_bipolar:
-		{
-			hradcPtr->gain = hradcPtr->BoardData.t.gain_Vin_bipolar;
-			hradcPtr->offset = hradcPtr->BoardData.t.offset_Vin_bipolar;
-			break;
-		}
-
-		case Iin_bipolar:
-		{
-			hradcPtr->gain = hradcPtr->BoardData.t.gain_Iin_bipolar;
-			hradcPtr->offset = hradcPtr->BoardData.t.offset_Iin_bipolar;
-			break;
-		}
-
-		default:
-		{
-			hradcPtr->gain = hradcPtr->BoardData.t.gain_Vin_bipolar;
-			hradcPtr->offset = hradcPtr->BoardData.t.offset_Vin_bipolar;
-			break;
-		}
-	}
-
-	// Store new configuration parameters
-	hradcPtr->AnalogInput = AnalogInput;
-	hradcPtr->enable_Heater = enHeater;
-	hradcPtr->enable_RailsMonitor = enRails;
-
-	// Create command according to the HRADC Command Protocol (HCP)
-	command = ((enRails << 8) | (enHeater << 7) | (AnalogInput << 3)) & 0x01F8;
+	command = Set_HRADC_Config(hradcPtr, AnalogInput, enHeater, enRails);
 
 	SendCommand_HRADC(hradcPtr, command);
 	//CheckStatus_HRADC(hradcPtr);
@@ -179,6 +215,44 @@ Uint16 Try_Config_HRADC_board(volatile HRADC_struct *hradcPtr, eInputType Analog
 		return 1;
 	}
 
+	command = Set_HRADC_Config(hradcPtr, AnalogInput, enHeater, enRails);
+
+	// Configure CPU Timer 1 for HRADC configuration timeout monitor
+	ConfigCpuTimer(&CpuTimer1, C28_FREQ_MHZ, TIMEOUT_uS_HRADC_CONFIG);
+	CpuTimer1Regs.TCR.all = 0x8000;
+
+	// Try to configure HRADC board
+	SendCommand_HRADC(hradcPtr, command);
+
+	// Start timeout monitor
+	StartCpuTimer1();
+
+	// Check HRADC configuration
+	while(CheckStatus_HRADC(hradcPtr))
+	{
+		// If timeout, stops test
+		if(CpuTimer1Regs.TCR.bit.TIF)
+		{
+			StopCpuTimer1();
+			CpuTimer1Regs.TCR.all = 0x8000;
+			return 1;
+		}
+		else
+		{
+			SendCommand_HRADC(hradcPtr, command);
+		}
+	}
+
+	return 0;
+}
+
+/**********************************************************************************************/
+//
+//	Select gain and offset for analog input, store new configuration parameters and
+//	create command according to the HRADC Command Protocol (HCP)
+//
+static Uint16 Set_HRADC_Config(volatile HRADC_struct *hradcPtr, eInputType AnalogInput, Uint16 enHeater, Uint16 enRails)
+{
 	switch(AnalogInput)
 	{
 		case Vin_bipolar:
@@ -203,41 +277,165 @@ Uint16 Try_Config_HRADC_board(volatile HRADC_struct *hradcPtr, eInputType Analog
 		}
 	}
 
-	// Store new configuration parameters
 	hradcPtr->AnalogInput = AnalogInput;
 	hradcPtr->enable_Heater = enHeater;
 	hradcPtr->enable_RailsMonitor = enRails;
 
-	// Create command according to the HRADC Command Protocol (HCP)
-	command = ((enRails << 8) | (enHeater << 7) | (AnalogInput << 3)) & 0x01F8;
+	return ((enRails << 8) | (enHeater << 7) | (AnalogInput << 3)) & 0x01F8;
+}
 
-	// Configure CPU Timer 1 for HRADC configuration timeout monitor
-	ConfigCpuTimer(&CpuTimer1, C28_FREQ_MHZ, TIMEOUT_uS_HRADC_CONFIG);
-	CpuTimer1Regs.TCR.all = 0x8000;
+/**********************************************************************************************/
+//
+//	Register board to be initialized by Bringup_HRADC_boards(), with the same parameters
+//	of Init_HRADC_Info() and Config_HRADC_board()
+//
+void Request_HRADC_board(Uint16 ID, Uint16 buffer_size, volatile Uint32 *buffer, float transducer_gain,
+						 eInputType AnalogInput, Uint16 enHeater, Uint16 enRails)
+{
+	tHRADC_Bringup *p = &HRADC_Bringup[ID];
+
+	p->state = HRADC_Bringup_Wait_Power;
+	p->buffer_size = buffer_size;
+	p->buffer = buffer;
+	p->transducer_gain = transducer_gain;
+	p->AnalogInput = AnalogInput;
+	p->enable_Heater = enHeater;
+	p->enable_RailsMonitor = enRails;
+	p->time_ready = 0;
+	p->time_done = 0;
+	p->n_attempts = 0;
+
+	HRADCs_Info.HRADC_boards[ID].ID = ID;
+}
 
-	// Try to configure HRADC board
-	SendCommand_HRADC(hradcPtr, command);
+/**********************************************************************************************/
+//
+//	Power up and configure requested boards, without blocking on any of them:
+//
+//		1. Wait power: board is polled with a probe configuration (GND input), since
+//		   an unpowered board may read back as any fixed pattern
+//		2. Read calibration data from UFM (Init_HRADC_Info)
+//		3. Configure: requested configuration is sent until board echoes it
+//
+//	CPU Timer 1 monitors timeout, as on Try_Config_HRADC_board(). Failed boards are
+//	reported to ARM and zeroed on acquisition path, which can't be mistaken for a valid
+//	feedback: they are latched on HRADCs_Info.failed_boards, so power supplies which use
+//	them can't be turned on (see Is_HRADC_Fault()). Returns bitmask of failed boards.
+//
+Uint16 Bringup_HRADC_boards(Uint16 n_boards)
+{
+	Uint16 i, pending, failed, command;
+	Uint32 elapsed;
+	tHRADC_Bringup *p;
+	volatile HRADC_struct *hradcPtr;
 
-	// Start timeout monitor
-	StartCpuTimer1();
+	if(HRADCs_Info.enable_Sampling)
+	{
+		return (1 << n_boards) - 1;
+	}
 
-	// Check HRADC configuration
-	while(CheckStatus_HRADC(hradcPtr))
+	// CPU Timer 1 is used directly, since CPU timers may not be initialized yet
+	CpuTimer1Regs.TCR.bit.TSS = 1;
+	CpuTimer1Regs.PRD.all = (Uint32) TIMEOUT_uS_HRADC_BRINGUP * (Uint32) C28_FREQ_MHZ;
+	CpuTimer1Regs.TPR.all = 0;
+	CpuTimer1Regs.TPRH.all = 0;
+	CpuTimer1Regs.TCR.bit.TRB = 1;
+	CpuTimer1Regs.TCR.bit.TIF = 1;
+	CpuTimer1Regs.TCR.bit.TSS = 0;
+
+	send_ipc_lowpriority_msg(0, Enable_HRADC_Boards);
+
+	do
 	{
-		// If timeout, stops test
-		if(CpuTimer1Regs.TCR.bit.TIF)
+		pending = 0;
+
+		for(i = 0; i < n_boards; i++)
 		{
-			StopCpuTimer1();
-			CpuTimer1Regs.TCR.all = 0x8000;
-			return 1;
+			p = &HRADC_Bringup[i];
+			hradcPtr = &HRADCs_Info.HRADC_boards[i];
+			elapsed = (CpuTimer1Regs.PRD.all - CpuTimer1Regs.TIM.all) / (Uint32) C28_FREQ_MHZ;
+
+			switch(p->state)
+			{
+				case HRADC_Bringup_Wait_Power:
+				{
+					pending = 1;
+
+					SendCommand_HRADC(hradcPtr, (GND << 3));
+
+					if(Is_HRADC_Input(hradcPtr, GND))
+					{
+						p->time_ready = elapsed;
+
+						Init_HRADC_Info(hradcPtr, i, p->buffer_size, p->buffer, p->transducer_gain);
+
+						p->state = HRADC_Bringup_Configure;
+					}
+
+					break;
+				}
+
+				case HRADC_Bringup_Configure:
+				{
+					pending = 1;
+
+					command = Set_HRADC_Config(hradcPtr, p->AnalogInput, p->enable_Heater,
+											   p->enable_RailsMonitor);
+					SendCommand_HRADC(hradcPtr, command);
+					p->n_attempts++;
+
+					if(Is_HRADC_Input(hradcPtr, p->AnalogInput))
+					{
+						p->time_done = elapsed;
+						p->state = HRADC_Bringup_Done;
+					}
+
+					break;
+				}
+
+				default:
+				{
+					break;
+				}
+			}
 		}
-		else
+	} while(pending && !CpuTimer1Regs.TCR.bit.TIF);
+
+	CpuTimer1Regs.TCR.bit.TSS = 1;
+	CpuTimer1Regs.TCR.bit.TIF = 1;
+
+	failed = 0;
+
+	for(i = 0; i < n_boards; i++)
+	{
+		if(HRADC_Bringup[i].state != HRADC_Bringup_Done)
 		{
-			SendCommand_HRADC(hradcPtr, command);
+			HRADC_Bringup[i].state = HRADC_Bringup_Failed;
+
+			HRADCs_Info.HRADC_boards[i].gain = 0.0;
+			HRADCs_Info.HRADC_boards[i].offset = 0.0;
+
+			send_ipc_lowpriority_msg(i, HRADC_Board_Failure);
+
+			failed |= (1 << i);
 		}
 	}
 
-	return 0;
+	HRADCs_Info.failed_boards = failed;
+
+	return failed;
+}
+
+/**********************************************************************************************/
+//
+//	Read back status of selected HRADC board and check whether it's configured with
+//	selected analog input. Unlike CheckStatus_HRADC(), mismatches aren't counted as errors.
+//
+static Uint16 Is_HRADC_Input(volatile HRADC_struct *hradcPtr, eInputType AnalogInput)
+{
+	SendCommand_HRADC(hradcPtr, CHECK_STATUS);
+
+	return (((hradcPtr->StatusReg & 0x00000078) >> 3) == AnalogInput);
 }
 
 /**********************************************************************************************/
@@ -373,6 +571,478 @@ void Config_HRADC_SoC(float freq)
 	EDIS;
 }
 
+/**********************************************************************************************/
+//
+//	Precompute calibration constants used by Get_HRADC_Samples(). It must be called
+//	after gain and offset of all boards are set, and after DMA is initialized.
+//	Drift correction from offline calibration is fused as well:
+//
+//		value = gain x (code - offset_error) / (1 + gain_error) + offset
+//
+//	Constants are written on the copy not in use, which is then swapped in at once.
+//
+void Update_HRADC_Calibration(void)
+{
+	Uint16 i;
+	float decimation_coeff, gain;
+	tHRADC_Calibration *p_calib;
+
+	decimation_coeff = 1.0 / (float) size_frame_HRADC;
+
+	if(p_HRADC_Calibration == &HRADC_Calibration[0])
+	{
+		p_calib = &HRADC_Calibration[1];
+	}
+	else
+	{
+		p_calib = &HRADC_Calibration[0];
+	}
+
+	for(i = 0; i < N_MAX_HRADC; i++)
+	{
+		if(i == hold_HRADC)
+		{
+			p_calib->scale[i] = 0.0;
+			p_calib->offset[i] = hold_value_HRADC;
+		}
+		else
+		{
+			gain = HRADCs_Info.HRADC_boards[i].gain /
+				   (1.0 + HRADC_OfflineCalib.drift[i].gain_error);
+
+			p_calib->scale[i] = gain * decimation_coeff;
+			p_calib->offset[i] = HRADCs_Info.HRADC_boards[i].offset -
+								 gain * HRADC_OfflineCalib.drift[i].offset_error;
+		}
+	}
+
+	p_HRADC_Calibration = p_calib;
+}
+
+/**********************************************************************************************/
+//
+//	Get calibrated samples of all boards from last decimated frame. Its stamp is
+//	published on g_frame_stamp, for consumers of these samples. Called from control ISR,
+//	a completed frame whose interrupt is still pending is processed first.
+//
+//	A frame not updated since last call, due to an overrun or stalled sampling, is reused
+//	and reported by returning 1. After HRADC_MAX_STALE_FRAMES consecutive ones while
+//	sampling is enabled, feedback is considered lost: all power supplies are turned off,
+//	which is recorded on SOE and flagged on HRADCs_Info.fault, and turn on is refused until
+//	Reset_HRADC_Fault() (see Is_HRADC_Fault()).
+//
+Uint16 Get_HRADC_Samples(float *samples)
+{
+	Uint16 stale;
+	volatile tHRADC_Frame *p_frame;
+	tHRADC_Calibration *p_calib;
+
+	poll_HRADC_frame();
+
+	p_frame = p_frame_HRADC;
+	p_calib = p_HRADC_Calibration;
+
+	stale = (p_frame->counter == counter_last_frame_HRADC);
+	counter_last_frame_HRADC = p_frame->counter;
+
+	if(!stale || !HRADCs_Info.enable_Sampling)
+	{
+		counter_stale_HRADC = 0;
+	}
+	else if( (++counter_stale_HRADC >= HRADC_MAX_STALE_FRAMES) &&
+			 !(HRADCs_Info.fault & HRADC_FAULT_STALE_FRAMES) )
+	{
+		HRADCs_Info.fault |= HRADC_FAULT_STALE_FRAMES;
+		Turn_Off_All_PS(HRADC_FAULT_STALE_FRAMES, (float) counter_stale_HRADC);
+	}
+
+	samples[0] = p_frame->samples[0] * p_calib->scale[0] + p_calib->offset[0];
+	samples[1] = p_frame->samples[1] * p_calib->scale[1] + p_calib->offset[1];
+	samples[2] = p_frame->samples[2] * p_calib->scale[2] + p_calib->offset[2];
+	samples[3] = p_frame->samples[3] * p_calib->scale[3] + p_calib->offset[3];
+
+	g_frame_stamp.timestamp = p_frame->timestamp;
+	g_frame_stamp.counter = p_frame->counter;
+	g_frame_stamp.carrier_phase = p_frame->carrier_phase;
+	g_frame_stamp.valid = p_frame->valid;
+
+	return stale;
+}
+
+/**********************************************************************************************/
+//
+//	Set bitmask of HRADC boards used by selected power supply, e.g., when each module of a
+//	power supply has its own board. Returns 1 if arguments are invalid.
+//
+Uint16 Set_HRADC_Boards_PS(Uint16 id, Uint16 boards)
+{
+	if( (id >= NUM_MAX_PS_MODULES) || !boards || (boards >> N_MAX_HRADC) )
+	{
+		return 1;
+	}
+
+	boards_PS_HRADC[id] = boards;
+
+	return 0;
+}
+
+/**********************************************************************************************/
+//
+//	Indicate whether HRADC feedback of selected power supply can't be trusted, when it must
+//	not be turned on: frames were lost, frame size is unsupported, or any board it uses
+//	failed bring-up (see Set_HRADC_Boards_PS()).
+//
+Uint16 Is_HRADC_Fault(Uint16 id)
+{
+	Uint16 boards;
+
+	boards = boards_PS_HRADC[id];
+
+	if(!boards)
+	{
+		boards = (1 << N_MAX_HRADC) - 1;
+	}
+
+	return (HRADCs_Info.fault || (HRADCs_Info.failed_boards & boards));
+}
+
+/**********************************************************************************************/
+//
+//	Clear feedback loss. If frames are still stale, it's latched again on next control ISR.
+//	Boards which failed bring-up remain failed until reboot.
+//
+void Reset_HRADC_Fault(void)
+{
+	Uint16 int_status;
+
+	int_status = __disable_interrupts();
+
+	counter_stale_HRADC = 0;
+	HRADCs_Info.fault &= ~HRADC_FAULT_STALE_FRAMES;
+
+	__restore_interrupts(int_status);
+}
+
+/**********************************************************************************************/
+//
+//	Configure offline calibration. Period between slots is given in seconds, and each slot
+//	measures a single board, in round-robin. Slots are only taken while all power supplies
+//	are off. Returns 1 if arguments are invalid.
+//
+Uint16 Config_HRADC_Offline_Calibration(Uint16 enable, float period)
+{
+	if( (enable > 1) || !(period >= HRADC_CALIB_MIN_PERIOD) ||
+		(period > HRADC_CALIB_MAX_PERIOD) || !(HRADCs_Info.freq_Sampling > 0.0) )
+	{
+		return 1;
+	}
+
+	HRADC_OfflineCalib.period_frames = (Uint32) (period * HRADCs_Info.freq_Sampling /
+												 (float) size_frame_HRADC);
+	HRADC_OfflineCalib.counter_next_slot = p_frame_HRADC->counter +
+										   HRADC_OfflineCalib.period_frames;
+	HRADC_OfflineCalib.enable = enable;
+
+	return 0;
+}
+
+/**********************************************************************************************/
+//
+//	Offline calibration state machine. It must be called periodically from background
+//	loop, and it blocks only while HRADC input is switched (up to TIMEOUT_uS_HRADC_CONFIG).
+//	A slot started is always completed, restoring original input, even if disabled meanwhile.
+//
+void Run_HRADC_Offline_Calibration(void)
+{
+	Uint16 int_status;
+	volatile tHRADC_Frame *p_frame;
+	tHRADC_OfflineCalib *p_offline = &HRADC_OfflineCalib;
+
+	p_frame = p_frame_HRADC;
+
+	// Abort slot if a power supply leaves off state, which shouldn't happen
+	if( (p_offline->state >= HRADC_Calib_Switch) && (p_offline->state <= HRADC_Calib_Acquire) &&
+		!Is_PS_Off() )
+	{
+		p_offline->drift[p_offline->board].counter_errors++;
+		p_offline->state = HRADC_Calib_Restore;
+	}
+
+	switch(p_offline->state)
+	{
+		case HRADC_Calib_Idle:
+		{
+			if( !p_offline->enable || !HRADCs_Info.enable_Sampling ||
+				!HRADCs_Info.n_HRADC_boards ||
+				((int32) (p_frame->counter - p_offline->counter_next_slot) < 0) )
+			{
+				break;
+			}
+
+			if(++p_offline->board >= HRADCs_Info.n_HRADC_boards)
+			{
+				p_offline->board = 0;
+			}
+
+			// Failed boards are skipped, trying next one on next call
+			if(HRADC_Bringup[p_offline->board].state == HRADC_Bringup_Failed)
+			{
+				break;
+			}
+
+			// Turn on is refused while slot is busy, so check and start it atomically
+			int_status = __disable_interrupts();
+
+			if(Is_PS_Off())
+			{
+				p_offline->state = HRADC_Calib_Switch;
+			}
+
+			__restore_interrupts(int_status);
+
+			if(p_offline->state == HRADC_Calib_Idle)
+			{
+				p_offline->counter_next_slot = p_frame->counter + p_offline->period_frames;
+				break;
+			}
+
+			p_offline->input = HRADCs_Info.HRADC_boards[p_offline->board].AnalogInput;
+			p_offline->source = 0;
+
+			hold_value_HRADC = p_frame->samples[p_offline->board] *
+							   p_HRADC_Calibration->scale[p_offline->board] +
+							   p_HRADC_Calibration->offset[p_offline->board];
+			hold_HRADC = p_offline->board;
+			Update_HRADC_Calibration();
+
+			break;
+		}
+
+		case HRADC_Calib_Switch:
+		{
+			if(Switch_HRADC_Input(p_offline->board, HRADC_Calib_Sources[p_offline->source]))
+			{
+				p_offline->drift[p_offline->board].counter_errors++;
+				p_offline->state = HRADC_Calib_Restore;
+			}
+			else
+			{
+				p_offline->counter_frame = p_frame_HRADC->counter;
+				p_offline->state = HRADC_Calib_Settle;
+			}
+
+			break;
+		}
+
+		case HRADC_Calib_Settle:
+		{
+			if((p_frame->counter - p_offline->counter_frame) >= HRADC_CALIB_SETTLE_FRAMES)
+			{
+				p_offline->acc = 0.0;
+				p_offline->n_frames = 0;
+				p_offline->counter_frame = p_frame->counter;
+				p_offline->state = HRADC_Calib_Acquire;
+			}
+
+			break;
+		}
+
+		case HRADC_Calib_Acquire:
+		{
+			if(p_frame->counter != p_offline->counter_frame)
+			{
+				p_offline->acc += p_frame->samples[p_offline->board];
+				p_offline->counter_frame = p_frame->counter;
+
+				if(++p_offline->n_frames == HRADC_CALIB_AVG_FRAMES)
+				{
+					p_offline->drift[p_offline->board].measured[p_offline->source] =
+						p_offline->acc / ((float) HRADC_CALIB_AVG_FRAMES * (float) size_frame_HRADC);
+
+					if(++p_offline->source < HRADC_CALIB_N_SOURCES)
+					{
+						p_offline->state = HRADC_Calib_Switch;
+					}
+					else
+					{
+						p_offline->state = HRADC_Calib_Restore;
+					}
+				}
+			}
+
+			break;
+		}
+
+		case HRADC_Calib_Restore:
+		{
+			// On failure, it's retried on next call
+			if(Switch_HRADC_Input(p_offline->board, p_offline->input))
+			{
+				p_offline->drift[p_offline->board].counter_errors++;
+			}
+			else
+			{
+				p_offline->counter_frame = p_frame_HRADC->counter;
+				p_offline->state = HRADC_Calib_Restore_Settle;
+			}
+
+			break;
+		}
+
+		case HRADC_Calib_Restore_Settle:
+		{
+			if((p_frame->counter - p_offline->counter_frame) >= HRADC_CALIB_SETTLE_FRAMES)
+			{
+				if(p_offline->source == HRADC_CALIB_N_SOURCES)
+				{
+					Update_HRADC_Drift(p_offline->board);
+				}
+
+				hold_HRADC = N_MAX_HRADC;
+				Update_HRADC_Calibration();
+
+				p_offline->counter_next_slot = p_frame->counter + p_offline->period_frames;
+				p_offline->state = HRADC_Calib_Idle;
+			}
+
+			break;
+		}
+
+		default:
+		{
+			p_offline->state = HRADC_Calib_Idle;
+			break;
+		}
+	}
+}
+
+/**********************************************************************************************/
+//
+//	Indicate whether an offline calibration slot is in progress, when power supplies must
+//	not be turned on.
+//
+Uint16 Is_HRADC_Offline_Calibration_Busy(void)
+{
+	return (HRADC_OfflineCalib.state != HRADC_Calib_Idle);
+}
+
+/**********************************************************************************************/
+//
+//	Indicate whether all active power supplies are off, when HRADC signal chain may be
+//	changed without disturbing control loops.
+//
+Uint16 Is_PS_Off(void)
+{
+	Uint16 i;
+
+	for(i = 0; i < NUM_MAX_PS_MODULES; i++)
+	{
+		if( g_ipc_ctom.ps_module[i].ps_status.bit.active &&
+			(g_ipc_ctom.ps_module[i].ps_status.bit.state > Interlock) )
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/**********************************************************************************************/
+//
+//	Turn off all active power supplies which are on, due to specified HRADC fault, which is
+//	recorded on SOE for each of them.
+//
+static void Turn_Off_All_PS(Uint16 fault, float value)
+{
+	Uint16 i;
+
+	for(i = 0; i < NUM_MAX_PS_MODULES; i++)
+	{
+		if( g_ipc_ctom.ps_module[i].ps_status.bit.active &&
+			(g_ipc_ctom.ps_module[i].ps_status.bit.state > Interlock) )
+		{
+			g_ipc_ctom.ps_module[i].turn_off(i);
+			record_soe_fault(i, fault, SOE_Source_HRADC, value);
+		}
+	}
+}
+
+/**********************************************************************************************/
+//
+//	Switch analog input of selected board, which requires sampling to be stopped. Time-bases
+//	are restarted from zero, as on power supply initialization, so frames remain aligned
+//	with control ISR. Carrier phase to sync pulses is lost meanwhile, so sync PLL, if
+//	enabled, must lock again.
+//
+static Uint16 Switch_HRADC_Input(Uint16 ID, eInputType AnalogInput)
+{
+	Uint16 error;
+	volatile HRADC_struct *hradcPtr = &HRADCs_Info.HRADC_boards[ID];
+
+	Disable_HRADC_Sampling();
+
+	error = Try_Config_HRADC_board(hradcPtr, AnalogInput, hradcPtr->enable_Heater,
+								   hradcPtr->enable_RailsMonitor);
+
+	EPwm1Regs.TBCTR = 0;
+	EPwm10Regs.TBCTR = 0;
+
+	Enable_HRADC_Sampling();
+
+	relock_sync_pll(&g_sync_pll);
+
+	return error;
+}
+
+/**********************************************************************************************/
+//
+//	Update drift correction of selected board with references measured on last slot.
+//	First slot after boot only sets baseline. Gain and offset errors are fitted from
+//	Vref_bipolar_p/n, and GND is used to validate the fit.
+//
+static void Update_HRADC_Drift(Uint16 ID)
+{
+	float span, gain_error, offset_error, residue;
+	tHRADC_Drift *p_drift = &HRADC_OfflineCalib.drift[ID];
+
+	if(!p_drift->has_baseline)
+	{
+		if((p_drift->measured[CALIB_VREF_P] - p_drift->measured[CALIB_VREF_N]) <
+		   HRADC_CALIB_MIN_REF_SPAN)
+		{
+			p_drift->counter_rejects++;
+			return;
+		}
+
+		p_drift->baseline[CALIB_VREF_P] = p_drift->measured[CALIB_VREF_P];
+		p_drift->baseline[CALIB_VREF_N] = p_drift->measured[CALIB_VREF_N];
+		p_drift->baseline[CALIB_GND] = p_drift->measured[CALIB_GND];
+		p_drift->has_baseline = 1;
+		return;
+	}
+
+	span = p_drift->baseline[CALIB_VREF_P] - p_drift->baseline[CALIB_VREF_N];
+
+	gain_error = (p_drift->measured[CALIB_VREF_P] - p_drift->measured[CALIB_VREF_N]) / span - 1.0;
+	offset_error = 0.5 * ( p_drift->measured[CALIB_VREF_P] + p_drift->measured[CALIB_VREF_N] -
+						   (1.0 + gain_error) * (p_drift->baseline[CALIB_VREF_P] +
+												 p_drift->baseline[CALIB_VREF_N]) );
+	residue = p_drift->measured[CALIB_GND] -
+			  (1.0 + gain_error) * p_drift->baseline[CALIB_GND] - offset_error;
+
+	if( !(fabs(gain_error) <= HRADC_CALIB_MAX_GAIN_DRIFT) ||
+		!(fabs(offset_error) <= HRADC_CALIB_MAX_OFFSET_DRIFT) ||
+		!(fabs(residue) <= HRADC_CALIB_MAX_GND_RESIDUE) )
+	{
+		p_drift->counter_rejects++;
+		return;
+	}
+
+	p_drift->gain_error = gain_error;
+	p_drift->offset_error = offset_error;
+	p_drift->counter_updates++;
+}
+
 void Enable_HRADC_Sampling(void)
 {
 	if(HRADCs_Info.enable_Sampling)
@@ -613,17 +1283,22 @@ if(HRADCs_Info.enable_Sampling)
 	HRADC_CS_CLEAR;
 }
 
-void Read_HRADC_UFM(Uint16 ID, Uint16 ufm_address, Uint16 n_words, volatile Uint16 *ufm_buffer)
+/**********************************************************************************************/
+//
+//	Read n_words from UFM, starting at ufm_address, in a single READ command. Words are
+//	received in bursts of up to UFM_BURST_MAX_WORDS by DMA. Returns 1 on failure.
+//
+Uint16 Read_HRADC_UFM(Uint16 ID, Uint16 ufm_address, Uint16 n_words, volatile Uint16 *ufm_buffer)
 {
-	Uint16 dummy, n;
+	Uint16 dummy, n, n_burst, error;
 
 	if(HRADCs_Info.enable_Sampling)
 	{
-		return;
+		return 1;
 	}
 
 	dummy = 0;
-	n = 0;
+	error = 0;
 
 	// Set appropriate Chip-Select signals
 	HRADC_CS_SET(ID);
@@ -642,22 +1317,27 @@ void Read_HRADC_UFM(Uint16 ID, Uint16 ufm_address, Uint16 n_words, volatile Uint
 	while(!McbspaRegs.SPCR1.bit.RRDY){}
 	dummy = McbspaRegs.DRR1.all;
 
-	// Iterates to receive n_words
-	while(n++ < n_words)
+	// Receive n_words in bursts, two bytes per word (Extended Mode: Word size = 16 bits)
+	while(n_words && !error)
 	{
-		// Receive current word, transmiting two dummy bytes (Extended Mode: Word size = 16 bits)
-		McbspaRegs.DXR1.all = 0x0000;
-		while(!McbspaRegs.SPCR1.bit.RRDY){}
-		*(ufm_buffer) = (McbspaRegs.DRR1.all << 8) & 0xFF00;
+		n_burst = (n_words > UFM_BURST_MAX_WORDS) ? UFM_BURST_MAX_WORDS : n_words;
 
-		McbspaRegs.DXR1.all = 0x0000;
-		while(!McbspaRegs.SPCR1.bit.RRDY){}
-		*(ufm_buffer++) |= McbspaRegs.DRR1.all;
+		error = burst_McBSP_DMA(ufm_burst_bytes, 2*n_burst);
+
+		for(n = 0; n < n_burst; n++)
+		{
+			*(ufm_buffer++) = ((ufm_burst_bytes[2*n] << 8) & 0xFF00) |
+							  (ufm_burst_bytes[2*n+1] & 0x00FF);
+		}
+
+		n_words -= n_burst;
 	}
 
 	// Reset and Clear Chip-Select signals
 	HRADC_CS_RESET(ID);
 	HRADC_CS_CLEAR;
+
+	return error;
 }
 
 void Write_HRADC_UFM(Uint16 ID, Uint16 ufm_address, Uint16 data)
@@ -753,7 +1433,167 @@ void Write_HRADC_UFM(Uint16 ID, Uint16 ufm_address, Uint16 data)
 	HRADC_CS_CLEAR;
 }
 
-void Read_HRADC_BoardData(HRADC_struct *hradcPtr)
+/**********************************************************************************************/
+//
+//	Get board data of selected board. It's read from UFM only once, on first call, and
+//	accepted only if it matches the CRC stored with it by Write_HRADC_BoardData(), so
+//	a bus returning a fixed pattern isn't mistaken for valid data. Boards written before
+//	CRC was stored have it erased: their data is accepted if two consecutive reads match
+//	and values are plausible, and its CRC is written back. Afterwards, it's copied from
+//	cache. If it can't be validated, board data is filled as erased UFM (NaN), so default
+//	values are used by Init_HRADC_Info(). Returns 1 on failure.
+//
+Uint16 Read_HRADC_BoardData(HRADC_struct *hradcPtr)
+{
+	Uint16 i, attempt, spiClk, crc, crc_stored;
+	tHRADC_BoardDataCache *p_cache = &HRADC_BoardData_Cache[hradcPtr->ID];
+
+	if(!p_cache->valid && !HRADCs_Info.enable_Sampling)
+	{
+		spiClk = McbspaRegs.SRGR1.bit.CLKGDV;
+
+		Config_HRADC_UFM_OpMode(hradcPtr->ID);
+
+		for(attempt = 0; (attempt < UFM_READ_ATTEMPTS) && !p_cache->valid; attempt++)
+		{
+			if( !Read_HRADC_UFM(hradcPtr->ID, UFM_BOARDDATA_ADDRESS, UFM_BOARDDATA_SIZE,
+								p_cache->data.u) &&
+				!Read_HRADC_UFM(hradcPtr->ID, UFM_BOARDDATA_CRC_ADDRESS, 1, &crc_stored) )
+			{
+				crc = CRC16_HRADC_UFM(p_cache->data.u, UFM_BOARDDATA_SIZE);
+
+				if(crc == crc_stored)
+				{
+					p_cache->crc = crc;
+					p_cache->valid = 1;
+				}
+				else if( (crc_stored == 0xFFFF) &&
+						 !Read_HRADC_UFM(hradcPtr->ID, UFM_BOARDDATA_ADDRESS, UFM_BOARDDATA_SIZE,
+										 ufm_verify) &&
+						 (crc == CRC16_HRADC_UFM(ufm_verify, UFM_BOARDDATA_SIZE)) &&
+						 Is_HRADC_BoardData_Plausible(&p_cache->data) )
+				{
+					// Erased word can be written without erasing sector
+					Write_HRADC_UFM(hradcPtr->ID, UFM_BOARDDATA_CRC_ADDRESS, crc);
+
+					p_cache->crc = crc;
+					p_cache->valid = 1;
+				}
+			}
+
+			if(!p_cache->valid)
+			{
+				p_cache->counter_errors++;
+			}
+		}
+
+		Config_HRADC_Sampling_OpMode(hradcPtr->ID, spiClk);
+	}
+
+	for(i = 0; i < UFM_BOARDDATA_SIZE; i++)
+	{
+		hradcPtr->BoardData.u[i] = p_cache->valid ? p_cache->data.u[i] : 0xFFFF;
+	}
+
+	return !p_cache->valid;
+}
+
+/**********************************************************************************************/
+//
+//	Store board data into UFM of selected board, followed by its CRC, verifying both by
+//	reading them back in burst. UFM only supports single word writes. On success, cache
+//	is updated, so it's used by next Init_HRADC_Info(). Returns 1 on failure.
+//
+Uint16 Write_HRADC_BoardData(Uint16 ID, uHRADC_BoardData *data)
 {
-	Read_HRADC_UFM(hradcPtr->ID, UFM_BOARDDATA_ADDRESS, UFM_BOARDDATA_SIZE, hradcPtr->BoardData.u);
+	Uint16 i, spiClk, crc, crc_stored, error;
+	tHRADC_BoardDataCache *p_cache = &HRADC_BoardData_Cache[ID];
+
+	if(HRADCs_Info.enable_Sampling)
+	{
+		return 1;
+	}
+
+	spiClk = McbspaRegs.SRGR1.bit.CLKGDV;
+
+	Config_HRADC_UFM_OpMode(ID);
+
+	Erase_HRADC_UFM(ID);
+
+	for(i = 0; i < UFM_BOARDDATA_SIZE; i++)
+	{
+		Write_HRADC_UFM(ID, UFM_BOARDDATA_ADDRESS + i, data->u[i]);
+	}
+
+	crc = CRC16_HRADC_UFM(data->u, UFM_BOARDDATA_SIZE);
+
+	Write_HRADC_UFM(ID, UFM_BOARDDATA_CRC_ADDRESS, crc);
+
+	error = Read_HRADC_UFM(ID, UFM_BOARDDATA_ADDRESS, UFM_BOARDDATA_SIZE, ufm_verify) ||
+			Read_HRADC_UFM(ID, UFM_BOARDDATA_CRC_ADDRESS, 1, &crc_stored) ||
+			(CRC16_HRADC_UFM(ufm_verify, UFM_BOARDDATA_SIZE) != crc) ||
+			(crc_stored != crc);
+
+	Config_HRADC_Sampling_OpMode(ID, spiClk);
+
+	if(error)
+	{
+		p_cache->valid = 0;
+		p_cache->counter_errors++;
+		return 1;
+	}
+
+	for(i = 0; i < UFM_BOARDDATA_SIZE; i++)
+	{
+		p_cache->data.u[i] = data->u[i];
+	}
+
+	p_cache->crc = crc;
+	p_cache->valid = 1;
+
+	return 0;
+}
+
+/**********************************************************************************************/
+//
+//	Range check of board data stored without CRC. Erased or garbage data (NaN, infinite or
+//	out of range) is rejected.
+//
+static Uint16 Is_HRADC_BoardData_Plausible(uHRADC_BoardData *data)
+{
+	return ( (fabs(data->t.gain_Vin_bipolar - 1.0) <= HRADC_BOARDDATA_MAX_GAIN_ERROR) &&
+			 (fabs(data->t.offset_Vin_bipolar) <= HRADC_BOARDDATA_MAX_OFFSET) &&
+			 !isnan(data->t.gain_Iin_bipolar) && !isinf(data->t.gain_Iin_bipolar) &&
+			 !isnan(data->t.offset_Iin_bipolar) && !isinf(data->t.offset_Iin_bipolar) &&
+			 !isnan(data->t.Rburden) && !isinf(data->t.Rburden) );
+}
+
+/**********************************************************************************************/
+//
+//	CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF) of UFM words, MSB first
+//
+static Uint16 CRC16_HRADC_UFM(volatile Uint16 *data, Uint16 n_words)
+{
+	Uint16 crc, i, bit;
+
+	crc = 0xFFFF;
+
+	for(i = 0; i < n_words; i++)
+	{
+		crc ^= data[i];
+
+		for(bit = 0; bit < 16; bit++)
+		{
+			if(crc & 0x8000)
+			{
+				crc = (crc << 1) ^ 0x1021;
+			}
+			else
+			{
+				crc <<= 1;
+			}
+		}
+	}
+
+	return crc;
 }
@@ -23,6 +23,7 @@
 #define RAILS_ENABLE 		1
 
 #define TIMEOUT_uS_HRADC_CONFIG 		10000
+#define TIMEOUT_uS_HRADC_BRINGUP		3000000
 
 #define UFM_OPCODE_WREN			0x0006
 #define UFM_OPCODE_WRDI			0x0004
@@ -35,10 +36,32 @@
 
 #define UFM_BOARDDATA_SIZE		28
 #define UFM_BOARDDATA_ADDRESS	0x0000
+#define UFM_BOARDDATA_CRC_ADDRESS	(UFM_BOARDDATA_ADDRESS + UFM_BOARDDATA_SIZE)
+#define UFM_BURST_MAX_WORDS		32		// Maximum UFM words per DMA burst
+#define UFM_READ_ATTEMPTS		3
+
+#define HRADC_BOARDDATA_MAX_GAIN_ERROR	0.1		// Range check of board data without CRC
+#define HRADC_BOARDDATA_MAX_OFFSET		1000.0	// [codes]
+
+#define HRADC_MAX_STALE_FRAMES	8		// Consecutive stale frames until feedback is lost
 
 #define HRADC_VIN_BI_P_GAIN		(20.0/262144.0)
 #define HRADC_BI_OFFSET			131072.0
 
+/**********************************************************************************************/
+//
+// 	Offline calibration parameters
+//
+#define HRADC_CALIB_N_SOURCES			3		// Vref_bipolar_p, Vref_bipolar_n, GND
+#define HRADC_CALIB_SETTLE_FRAMES		16		// Frames discarded after each input switch
+#define HRADC_CALIB_AVG_FRAMES			64		// Frames averaged per source
+#define HRADC_CALIB_MIN_PERIOD			1.0		// Minimum period between slots [s]
+#define HRADC_CALIB_MAX_PERIOD			3600.0	// Maximum period between slots [s]
+#define HRADC_CALIB_MIN_REF_SPAN		10000.0	// Minimum Vref_bipolar_p - Vref_bipolar_n [codes]
+#define HRADC_CALIB_MAX_GAIN_DRIFT		0.005	// Maximum relative gain drift
+#define HRADC_CALIB_MAX_OFFSET_DRIFT	500.0	// Maximum offset drift [codes]
+#define HRADC_CALIB_MAX_GND_RESIDUE		20.0	// Maximum GND misfit of drift model [codes]
+
 
 
 /**********************************************************************************************/
@@ -136,6 +159,19 @@ typedef volatile union
 	Uint16 				u[UFM_BOARDDATA_SIZE];
 } uHRADC_BoardData;
 
+//
+// 	Raw copy of board data, as stored in UFM. It's validated once at boot against CRC
+//	stored right after it in UFM, and kept in local RAM, since BoardData in HRADCs_Info
+//	is scaled by Init_HRADC_Info().
+//
+typedef struct
+{
+	Uint16				valid;
+	Uint16				crc;					// CRC-16/CCITT of data
+	uHRADC_BoardData	data;
+	Uint32				counter_errors;			// Failed reads/writes
+} tHRADC_BoardDataCache;
+
 
 /**********************************************************************************************/
 //
@@ -158,12 +194,115 @@ typedef volatile struct
 	uHRADC_BoardData	BoardData;				// Calibration database
 } HRADC_struct;
 
+/**********************************************************************************************/
+//
+// 	HRADC boards bring-up
+//
+// 	All requested boards are powered up and configured in an interleaved way, each one
+//	advancing a step per pass, so boot time is set by the slowest board rather than their
+//	sum. Boards not configured until TIMEOUT_uS_HRADC_BRINGUP are reported as failed.
+//
+typedef enum {
+		HRADC_Bringup_Idle,
+		HRADC_Bringup_Wait_Power,
+		HRADC_Bringup_Configure,
+		HRADC_Bringup_Done,
+		HRADC_Bringup_Failed
+} eHRADCBringupState;
+
+typedef struct
+{
+	eHRADCBringupState	state;
+	Uint16				buffer_size;
+	volatile Uint32		*buffer;
+	float				transducer_gain;
+	eInputType			AnalogInput;
+	Uint16				enable_Heater;
+	Uint16				enable_RailsMonitor;
+	Uint32				time_ready;				// Time until board answered [us]
+	Uint32				time_done;				// Time until board was configured [us]
+	Uint32				n_attempts;				// Configuration attempts
+} tHRADC_Bringup;
+
+/**********************************************************************************************/
+//
+// 	HRADC calibration constants for acquisition routine, fusing gain with decimation
+//	coefficient. Kept in local RAM, apart from shared HRADCs_Info.
+//
+typedef struct
+{
+	float			scale[N_MAX_HRADC];		// gain x decimation_coeff
+	float			offset[N_MAX_HRADC];
+} tHRADC_Calibration;
+
+/**********************************************************************************************/
+//
+// 	HRADC offline calibration
+//
+// 	Drift of each board is modeled as code = (1 + gain_error) x code_0 + offset_error,
+//	where code_0 are the reference codes measured on first slot after boot. Errors fitted
+//	on last valid slot are applied until the next one.
+//
+//	References can only be measured with sampling stopped, so slots are taken only while
+//	all power supplies are off. Measured board is held on its last value meanwhile. This
+//	is therefore an off-state recalibration only: drift while a power supply is running
+//	is not tracked, and correction stays frozen at its value from last off period.
+//
+//	Temperature compensation is not implemented: board temperature (Temp input) can't be
+//	read while sampling either, and no other reading of it is available, so a temperature
+//	model couldn't extrapolate drift beyond what references measure directly.
+//
+typedef enum {
+		HRADC_Calib_Idle,
+		HRADC_Calib_Switch,
+		HRADC_Calib_Settle,
+		HRADC_Calib_Acquire,
+		HRADC_Calib_Restore,
+		HRADC_Calib_Restore_Settle
+} eHRADCCalibState;
+
+typedef struct
+{
+	Uint16			has_baseline;
+	float			baseline[HRADC_CALIB_N_SOURCES];	// Reference codes on first slot
+	float			measured[HRADC_CALIB_N_SOURCES];	// Reference codes on last slot
+	float			gain_error;							// Applied drift correction
+	float			offset_error;						// [codes]
+	Uint32			counter_updates;
+	Uint32			counter_rejects;
+	Uint32			counter_errors;
+} tHRADC_Drift;
+
+typedef struct
+{
+	Uint16				enable;
+	eHRADCCalibState	state;
+	Uint16				board;
+	Uint16				source;
+	eInputType			input;					// Input restored after slot
+	Uint16				n_frames;
+	Uint32				counter_frame;
+	Uint32				counter_next_slot;
+	Uint32				period_frames;
+	float				acc;
+	tHRADC_Drift		drift[N_MAX_HRADC];
+} tHRADC_OfflineCalib;
+
+//
+// 	Faults of HRADC acquisition, which prevent power supplies from being turned on. They
+//	are published to ARM on HRADCs_Info.fault.
+//
+#define HRADC_FAULT_STALE_FRAMES	0x0001		// Feedback lost, until Reset_HRADC_Fault()
+#define HRADC_FAULT_CONFIG			0x0002		// Unsupported frame size, until reboot
+
 typedef volatile struct
 {
 	float			freq_Sampling;
 	Uint16 			enable_Sampling;
 	Uint16 			n_HRADC_boards;
 	HRADC_struct 	HRADC_boards[4];
+	Uint16			fault;					// HRADC_FAULT_* flags
+	Uint16			failed_boards;			// Bitmask of boards which failed bring-up
 } HRADCs_struct;
 
 
@@ -179,26 +318,43 @@ extern volatile HRADC_struct  HRADC3_board;*/
 
 extern volatile Uint32 HRADC_BoardSelector[4];
 
+extern tHRADC_OfflineCalib HRADC_OfflineCalib;
+extern tHRADC_Bringup HRADC_Bringup[N_MAX_HRADC];
+extern tHRADC_BoardDataCache HRADC_BoardData_Cache[N_MAX_HRADC];
+
 extern volatile Uint32 counterErrorSendCommand;
 extern volatile float AverageFilter;
 
 extern void Init_HRADC_Info(volatile HRADC_struct *hradcPtr, Uint16 ID, Uint16 buffer_size, volatile Uint32 *buffer, float transducer_gain);
 extern void Config_HRADC_board(volatile HRADC_struct *hradcPtr, eInputType AnalogInput, Uint16 enHeater, Uint16 enRails);
 extern Uint16 Try_Config_HRADC_board(volatile HRADC_struct *hradcPtr, eInputType AnalogInput, Uint16 enHeater, Uint16 enRails);
+extern void Request_HRADC_board(Uint16 ID, Uint16 buffer_size, volatile Uint32 *buffer, float transducer_gain,
+								eInputType AnalogInput, Uint16 enHeater, Uint16 enRails);
+extern Uint16 Bringup_HRADC_boards(Uint16 n_boards);
 
 extern void SendCommand_HRADC(volatile HRADC_struct *hradcPtr, Uint16 command);
 extern Uint16 CheckStatus_HRADC(volatile HRADC_struct *hradcPtr);
 
 extern void Config_HRADC_SoC(float freq);
+extern void Update_HRADC_Calibration(void);
+extern Uint16 Get_HRADC_Samples(float *samples);
+extern Uint16 Set_HRADC_Boards_PS(Uint16 id, Uint16 boards);
+extern Uint16 Is_HRADC_Fault(Uint16 id);
+extern void Reset_HRADC_Fault(void);
+extern Uint16 Config_HRADC_Offline_Calibration(Uint16 enable, float period);
+extern void Run_HRADC_Offline_Calibration(void);
+extern Uint16 Is_HRADC_Offline_Calibration_Busy(void);
+extern Uint16 Is_PS_Off(void);
 extern void Enable_HRADC_Sampling(void);
 extern void Disable_HRADC_Sampling(void);
 
 extern void Config_HRADC_Sampling_OpMode(Uint16 ID, Uint16 spiClk);
 extern void Config_HRADC_UFM_OpMode(Uint16 ID);
 extern void Erase_HRADC_UFM(Uint16 ID);
-extern void Read_HRADC_UFM(Uint16 ID, Uint16 ufm_address, Uint16 n_words, volatile Uint16 *ufm_buffer);
+extern Uint16 Read_HRADC_UFM(Uint16 ID, Uint16 ufm_address, Uint16 n_words, volatile Uint16 *ufm_buffer);
 extern void Write_HRADC_UFM(Uint16 ID, Uint16 ufm_address, Uint16 data);
 
-extern void Read_HRADC_BoardData(HRADC_struct *hradcPtr);
+extern Uint16 Read_HRADC_BoardData(HRADC_struct *hradcPtr);
+extern Uint16 Write_HRADC_BoardData(Uint16 ID, uHRADC_BoardData *data);
 
 #endif
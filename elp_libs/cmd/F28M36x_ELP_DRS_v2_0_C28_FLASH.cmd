@@ -154,10 +154,23 @@ SECTIONS
        PUTREADIDX :   TYPE = DSECT
    }
 
-   SHARERAMS0_0        : > RAMS0_0,        PAGE = 1     // g_controller_mtoc
+   GROUP               : > RAMS0_0,        PAGE = 1
+   {
+      SHARERAMS0_0                                     // g_controller_mtoc
+      SHARERAMS0_0_FASTREF                             // g_fastref_ring
+   }
    SHARERAMS0_1        : > RAMS0_1,        PAGE = 1     // g_param_bank
    SHARERAMS1_0        : > RAMS1_0,        PAGE = 1     // g_controller_ctom
-   SHARERAMS1_1        : > RAMS1_1,        PAGE = 1     // HRADCs_Info
+   GROUP               : > RAMS1_1,        PAGE = 1
+   {
+      SHARERAMS1_1                                     // HRADCs_Info
+      SHARERAMS1_1_IPC                                 // g_ipc_lowpriority_stats, g_ipc_snapshot_ctom
+      SHARERAMS1_1_FASTREF                             // g_fastref
+      SHARERAMS1_1_SYNC                                // g_sync, g_sync_pll
+      SHARERAMS1_1_EVENTS                              // g_soe
+      SHARERAMS1_1_POSTMORTEM                          // g_postmortem
+      SHARERAMS1_1_INTEGRITY                           // g_integrity
+   }
    //SHARERAMS2          : > RAMS2,        PAGE = 1
    //SHARERAMS3          : > RAMS3,        PAGE = 1
    //SHARERAMS4          : > RAMS4,        PAGE = 1
@@ -167,7 +180,7 @@ SECTIONS
    //SHARERAMS23         : > RAMS23,       PAGE = 1     // g_wfmref
    //SHARERAMS45         : > RAMS45,       PAGE = 1     // g_buf_samples_ctom
    SHARERAMS2345       : > RAMS2345,       PAGE = 1     // g_wfmref
-   SHARERAMS67         : > RAMS67,       PAGE = 1       // g_buf_samples_ctom
+   SHARERAMS67         : > RAMS67,       PAGE = 1       // g_buf_samples_ctom, g_postmortem frames
    
    MTOC_MSG_RAM		   : > MTOCRAM,		PAGE = 1        // g_ipc_mtoc
    CTOM_MSG_RAM		   : > CTOMRAM,		PAGE = 1        // g_ipc_ctom
@@ -0,0 +1,174 @@
+/******************************************************************************
+ * Copyright (C) 2026 by LNLS - Brazilian Synchrotron Light Laboratory
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. LNLS and
+ * the Brazilian Center for Research in Energy and Materials (CNPEM) are not
+ * liable for any misuse of this material.
+ *
+ *****************************************************************************/
+
+/**
+ * @file decimator.c
+ * @brief CIC decimator module.
+ *
+ * Multi-stage CIC decimator with optional FIR droop compensation, for
+ * oversampled ADC streams.
+ *
+ * @author gabriel.brunheira
+ * @date 19/10/2026
+ *
+ */
+
+#include <math.h>
+#include "common/decimator.h"
+
+#define PI      3.14159265358979323846
+
+#pragma CODE_SECTION(run_decimator, "ramfuncs");
+
+/**
+ * Configure decimator and reset its states. FIR coefficients are designed
+ * to compensate CIC droop at a quarter of output sampling frequency.
+ *
+ * @param p_dec pointer to decimator struct
+ * @param order number of CIC stages [1 - DECIMATOR_MAX_ORDER]
+ * @param ratio decimation ratio
+ * @param enable_fir enable droop compensation FIR [0 - 1]
+ * @return 1 if arguments are invalid, 0 otherwise
+ */
+uint16_t cfg_decimator(decimator_t *p_dec, uint16_t order, uint16_t ratio,
+                       uint16_t enable_fir)
+{
+    uint16_t i, bits;
+    float droop;
+
+    if( (order < 1) || (order > DECIMATOR_MAX_ORDER) || (ratio < 1) ||
+        (enable_fir > 1) )
+    {
+        return 1;
+    }
+
+    /// Register growth must fit in 32 bits
+    bits = 0;
+    while( (1UL << bits) < ratio )
+    {
+        bits++;
+    }
+
+    if( (DECIMATOR_INPUT_BITS + order * bits) > 32 )
+    {
+        return 1;
+    }
+
+    p_dec->order = order;
+    p_dec->ratio = ratio;
+    p_dec->enable_fir = enable_fir;
+
+    /// CIC DC gain is ratio^order, while output is scaled as a sum
+    p_dec->gain = 1.0;
+    for(i = 1; i < order; i++)
+    {
+        p_dec->gain /= (float) ratio;
+    }
+
+    /**
+     * FIR is h = [a, 1 - 2a, a], with unity DC gain and gain (1 - 2a) at a
+     * quarter of output sampling frequency, which is set to the inverse of
+     * CIC droop at this frequency.
+     */
+    droop = 1.0;
+    if(ratio > 1)
+    {
+        droop = sinf(0.25 * PI) / ((float) ratio * sinf(0.25 * PI / (float) ratio));
+        droop = powf(droop, (float) order);
+    }
+
+    p_dec->fir_coeff = 0.5 * (1.0 - 1.0 / droop);
+
+    reset_decimator(p_dec);
+
+    return 0;
+}
+
+/**
+ * Clear CIC and FIR states.
+ *
+ * @param p_dec pointer to decimator struct
+ */
+void reset_decimator(decimator_t *p_dec)
+{
+    uint16_t i;
+
+    for(i = 0; i < DECIMATOR_MAX_ORDER; i++)
+    {
+        p_dec->integrator[i] = 0;
+        p_dec->comb[i] = 0;
+    }
+
+    p_dec->fir_delay[0] = 0.0;
+    p_dec->fir_delay[1] = 0.0;
+}
+
+/**
+ * Process one frame of input samples. Integrators run at input rate over
+ * the whole frame, and combs at output rate, with unity differential delay.
+ *
+ * @param p_dec pointer to decimator struct
+ * @param p_samples pointer to ```ratio``` consecutive raw input samples
+ * @return decimated output sample
+ */
+float run_decimator(decimator_t *p_dec, volatile uint32_t *p_samples)
+{
+    uint16_t i, k, order, ratio;
+    uint32_t acc, diff;
+    uint32_t integrator[DECIMATOR_MAX_ORDER];
+    float out, fir_out;
+
+    /// Local copies, which don't alias input samples
+    order = p_dec->order;
+    ratio = p_dec->ratio;
+
+    for(k = 0; k < order; k++)
+    {
+        integrator[k] = p_dec->integrator[k];
+    }
+
+    for(i = 0; i < ratio; i++)
+    {
+        acc = p_samples[i];
+
+        for(k = 0; k < order; k++)
+        {
+            acc += integrator[k];
+            integrator[k] = acc;
+        }
+    }
+
+    for(k = 0; k < order; k++)
+    {
+        p_dec->integrator[k] = integrator[k];
+    }
+
+    for(k = 0; k < order; k++)
+    {
+        diff = acc - p_dec->comb[k];
+        p_dec->comb[k] = acc;
+        acc = diff;
+    }
+
+    out = ((float) acc) * p_dec->gain;
+
+    if(p_dec->enable_fir)
+    {
+        fir_out = p_dec->fir_coeff * (out + p_dec->fir_delay[1]) +
+                  (1.0 - 2.0 * p_dec->fir_coeff) * p_dec->fir_delay[0];
+
+        p_dec->fir_delay[1] = p_dec->fir_delay[0];
+        p_dec->fir_delay[0] = out;
+
+        out = fir_out;
+    }
+
+    return out;
+}
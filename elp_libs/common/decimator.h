@@ -0,0 +1,88 @@
+/******************************************************************************
+ * Copyright (C) 2026 by LNLS - Brazilian Synchrotron Light Laboratory
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. LNLS and
+ * the Brazilian Center for Research in Energy and Materials (CNPEM) are not
+ * liable for any misuse of this material.
+ *
+ *****************************************************************************/
+
+/**
+ * @file decimator.h
+ * @brief CIC decimator module.
+ *
+ * Decimator for oversampled ADC streams, composed of a multi-stage CIC
+ * (cascaded integrator-comb) filter followed by an optional 3-tap FIR which
+ * compensates the CIC passband droop.
+ *
+ * CIC stages run in 32-bit unsigned fixed-point over raw ADC words, whose
+ * modular arithmetic gives exact results as long as the output fits in 32
+ * bits, i.e., DECIMATOR_INPUT_BITS + order * ceil(log2(ratio)) <= 32. A whole
+ * frame of ```ratio``` input samples is processed at once, producing one
+ * output sample.
+ *
+ * Output is scaled as the sum of ```ratio``` input samples, just like a
+ * boxcar decimator, so a first-order decimator without FIR is equivalent to
+ * it. Group delay is ```order * (ratio - 1) / 2``` input samples, plus one
+ * output sample when FIR is enabled.
+ *
+ * Decimator struct is not volatile, so its states may be kept in registers
+ * along the frame. It must be owned by a single ISR, and configured with
+ * interrupts disabled.
+ *
+ * @author gabriel.brunheira
+ * @date 19/10/2026
+ *
+ */
+
+#ifndef DECIMATOR_H_
+#define DECIMATOR_H_
+
+#include <stdint.h>
+
+#define DECIMATOR_MAX_ORDER     4
+#define DECIMATOR_INPUT_BITS    18
+
+typedef struct
+{
+    uint16_t    order;
+    uint16_t    ratio;
+    uint16_t    enable_fir;
+    float       fir_coeff;
+    float       gain;
+    uint32_t    integrator[DECIMATOR_MAX_ORDER];
+    uint32_t    comb[DECIMATOR_MAX_ORDER];
+    float       fir_delay[2];
+} decimator_t;
+
+/**
+ * Configure decimator and reset its states. FIR coefficients are designed
+ * to compensate CIC droop at a quarter of output sampling frequency.
+ *
+ * @param p_dec pointer to decimator struct
+ * @param order number of CIC stages [1 - DECIMATOR_MAX_ORDER]
+ * @param ratio decimation ratio
+ * @param enable_fir enable droop compensation FIR [0 - 1]
+ * @return 1 if arguments are invalid, 0 otherwise
+ */
+extern uint16_t cfg_decimator(decimator_t *p_dec, uint16_t order,
+                              uint16_t ratio, uint16_t enable_fir);
+
+/**
+ * Clear CIC and FIR states.
+ *
+ * @param p_dec pointer to decimator struct
+ */
+extern void reset_decimator(decimator_t *p_dec);
+
+/**
+ * Process one frame of input samples.
+ *
+ * @param p_dec pointer to decimator struct
+ * @param p_samples pointer to ```ratio``` consecutive raw input samples
+ * @return decimated output sample
+ */
+extern float run_decimator(decimator_t *p_dec, volatile uint32_t *p_samples);
+
+#endif /* DECIMATOR_H_ */
@@ -0,0 +1,212 @@
+/******************************************************************************
+ * Copyright (C) 2026 by LNLS - Brazilian Synchrotron Light Laboratory
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. LNLS and
+ * the Brazilian Center for Research in Energy and Materials (CNPEM) are not
+ * liable for any misuse of this material.
+ *
+ *****************************************************************************/
+
+/**
+ * @file integrity.c
+ * @brief Sample integrity module.
+ *
+ * Plausibility checks for acquired samples and vote between redundant
+ * sensors.
+ *
+ * @author gabriel.brunheira
+ * @date 19/10/2026
+ *
+ */
+
+#include <math.h>
+#include "common/integrity.h"
+
+#pragma DATA_SECTION(g_integrity,"SHARERAMS1_1_INTEGRITY");
+volatile integrity_t g_integrity;
+
+#pragma CODE_SECTION(run_sample_check,"ramfuncs");
+#pragma CODE_SECTION(run_vote,"ramfuncs");
+
+/**
+ * Initialization of integrity module. All checks but NaN rejection are
+ * disabled.
+ *
+ * @param p_integrity pointer to integrity struct
+ */
+void init_integrity(integrity_t *p_integrity)
+{
+    uint16_t i;
+
+    for(i = 0; i < NUM_MAX_INTEGRITY_CHECKS; i++)
+    {
+        cfg_sample_check(&p_integrity->check[i], 0.0, 0, 1);
+    }
+
+    reset_vote(&p_integrity->vote);
+}
+
+/**
+ * Configure sample check. Check is reset.
+ *
+ * @param p_check pointer to sample check struct
+ * @param max_delta rate-of-change limit, per sample [0: disabled]
+ * @param enable_median enable median of 3 [0/1]
+ * @param max_holds maximum consecutive rejections before following signal
+ *                  [1 - INTEGRITY_MAX_HOLDS]
+ * @return 1 if arguments are invalid, 0 otherwise
+ */
+uint16_t cfg_sample_check(sample_check_t *p_check, float max_delta,
+                          uint16_t enable_median, uint16_t max_holds)
+{
+    if( !(max_delta >= 0.0) || isinf(max_delta) || (enable_median > 1) ||
+        (max_holds < 1) || (max_holds > INTEGRITY_MAX_HOLDS) )
+    {
+        return 1;
+    }
+
+    p_check->max_delta = max_delta;
+    p_check->enable_median = enable_median;
+    p_check->max_holds = max_holds;
+
+    reset_sample_check(p_check);
+
+    return 0;
+}
+
+void reset_sample_check(sample_check_t *p_check)
+{
+    p_check->valid = 1;
+    p_check->holds = 0;
+    p_check->num_samples = 0;
+    p_check->history[0] = 0.0;
+    p_check->history[1] = 0.0;
+    p_check->out = 0.0;
+    p_check->counter_rejects = 0;
+    p_check->counter_resyncs = 0;
+}
+
+/**
+ * Check new sample.
+ *
+ * Median of 3 is computed by clamping new sample between the two previous
+ * ones. Until history and last accepted sample are available, samples are
+ * accepted unchecked, except for NaN.
+ *
+ * @param p_check pointer to sample check struct
+ * @param sample new sample
+ * @return checked sample, which is last accepted one if rejected
+ */
+float run_sample_check(sample_check_t *p_check, float sample)
+{
+    float x, lo, hi;
+
+    x = sample;
+
+    if(p_check->enable_median)
+    {
+        if(p_check->num_samples >= 2)
+        {
+            if(p_check->history[0] < p_check->history[1])
+            {
+                lo = p_check->history[0];
+                hi = p_check->history[1];
+            }
+            else
+            {
+                lo = p_check->history[1];
+                hi = p_check->history[0];
+            }
+
+            if(x < lo)
+            {
+                x = lo;
+            }
+            else if(x > hi)
+            {
+                x = hi;
+            }
+        }
+
+        p_check->history[0] = p_check->history[1];
+        p_check->history[1] = sample;
+    }
+
+    /// NaN can't be a real signal move, so it's always rejected and never
+    /// followed, even with rate-of-change limit disabled
+    if(isnan(x))
+    {
+        p_check->counter_rejects++;
+        p_check->valid = 0;
+        return p_check->out;
+    }
+
+    if( (p_check->max_delta > 0.0) && p_check->num_samples &&
+        (fabs(x - p_check->out) > p_check->max_delta) )
+    {
+        p_check->counter_rejects++;
+
+        if(++p_check->holds <= p_check->max_holds)
+        {
+            p_check->valid = 0;
+            return p_check->out;
+        }
+
+        /// Too many consecutive rejections: signal has really moved
+        p_check->counter_resyncs++;
+    }
+
+    if(p_check->num_samples < 2)
+    {
+        p_check->num_samples++;
+    }
+
+    p_check->holds = 0;
+    p_check->valid = 1;
+    p_check->out = x;
+
+    return x;
+}
+
+void reset_vote(vote_t *p_vote)
+{
+    p_vote->selected = 0x3;
+    p_vote->counter_single[0] = 0;
+    p_vote->counter_single[1] = 0;
+    p_vote->counter_none = 0;
+}
+
+/**
+ * Vote between 2 redundant sensors, after their samples are checked.
+ *
+ * @param p_vote pointer to vote struct
+ * @param p_check_1 pointer to sample check of sensor 1
+ * @param p_check_2 pointer to sample check of sensor 2
+ * @return mean of valid sensors, or mean of held values if none is valid
+ */
+float run_vote(vote_t *p_vote, sample_check_t *p_check_1,
+               sample_check_t *p_check_2)
+{
+    if(p_check_1->valid && p_check_2->valid)
+    {
+        p_vote->selected = 0x3;
+        return 0.5 * (p_check_1->out + p_check_2->out);
+    }
+    else if(p_check_1->valid)
+    {
+        p_vote->selected = 0x1;
+        p_vote->counter_single[0]++;
+        return p_check_1->out;
+    }
+    else if(p_check_2->valid)
+    {
+        p_vote->selected = 0x2;
+        p_vote->counter_single[1]++;
+        return p_check_2->out;
+    }
+
+    p_vote->selected = 0;
+    p_vote->counter_none++;
+    return 0.5 * (p_check_1->out + p_check_2->out);
+}
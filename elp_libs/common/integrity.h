@@ -0,0 +1,90 @@
+/******************************************************************************
+ * Copyright (C) 2026 by LNLS - Brazilian Synchrotron Light Laboratory
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. LNLS and
+ * the Brazilian Center for Research in Energy and Materials (CNPEM) are not
+ * liable for any misuse of this material.
+ *
+ *****************************************************************************/
+
+/**
+ * @file integrity.h
+ * @brief Sample integrity module.
+ *
+ * Cheap plausibility checks for acquired samples, run on control ISR before
+ * they reach control loops, so a single corrupted sample doesn't disturb
+ * them:
+ *
+ *  - Median of 3: optionally, each sample is replaced by the median of itself
+ *    and the two previous ones, which removes isolated spikes at the cost of
+ *    one sample of delay on steps.
+ *  - Rate-of-change limit: a sample deviating more than ```max_delta``` from
+ *    last accepted one is rejected and last accepted value is held. After
+ *    ```max_holds``` consecutive rejections, signal is considered to have
+ *    really moved and is followed again. Holds are limited to
+ *    INTEGRITY_MAX_HOLDS ticks, since a real fault can't be hidden for
+ *    longer. A NaN sample is always rejected and never followed.
+ *
+ * Redundant sensors, such as 2 DCCTs, are combined by a vote: the mean of
+ * valid ones is used, so a faulty sensor is dropped on the same tick its
+ * sample is rejected.
+ *
+ * With default configuration, all checks but NaN rejection are disabled, and
+ * vote is a plain mean of non-NaN samples.
+ *
+ * Interlock thresholds which protect against real faults, such as load
+ * overcurrent, should be evaluated on raw samples rather than checked ones.
+ *
+ * @author gabriel.brunheira
+ * @date 19/10/2026
+ *
+ */
+
+#ifndef INTEGRITY_H_
+#define INTEGRITY_H_
+
+#include <stdint.h>
+
+#define NUM_MAX_INTEGRITY_CHECKS    4       // One per HRADC board
+#define INTEGRITY_MAX_HOLDS         4       // Maximum consecutive rejections
+
+typedef volatile struct
+{
+    float       max_delta;          ///< Rate-of-change limit [signal units]
+    uint16_t    enable_median;
+    uint16_t    max_holds;
+    uint16_t    valid;              ///< Last sample was accepted
+    uint16_t    holds;              ///< Current consecutive rejections
+    uint16_t    num_samples;
+    float       history[2];         ///< Last two samples, for median
+    float       out;                ///< Last accepted sample
+    uint32_t    counter_rejects;
+    uint32_t    counter_resyncs;
+} sample_check_t;
+
+typedef volatile struct
+{
+    uint16_t    selected;           ///< Bitmask of sensors used by last vote
+    uint32_t    counter_single[2];  ///< Votes on which only sensor 1/2 was valid
+    uint32_t    counter_none;       ///< Votes on which no sensor was valid
+} vote_t;
+
+typedef volatile struct
+{
+    sample_check_t  check[NUM_MAX_INTEGRITY_CHECKS];
+    vote_t          vote;
+} integrity_t;
+
+extern volatile integrity_t g_integrity;
+
+extern void init_integrity(integrity_t *p_integrity);
+extern uint16_t cfg_sample_check(sample_check_t *p_check, float max_delta,
+                                 uint16_t enable_median, uint16_t max_holds);
+extern void reset_sample_check(sample_check_t *p_check);
+extern float run_sample_check(sample_check_t *p_check, float sample);
+extern void reset_vote(vote_t *p_vote);
+extern float run_vote(vote_t *p_vote, sample_check_t *p_check_1,
+                      sample_check_t *p_check_2);
+
+#endif /* INTEGRITY_H_ */
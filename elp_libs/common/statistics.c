@@ -0,0 +1,338 @@
+/******************************************************************************
+ * Copyright (C) 2026 by LNLS - Brazilian Synchrotron Light Laboratory
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. LNLS and
+ * the Brazilian Center for Research in Energy and Materials (CNPEM) are not
+ * liable for any misuse of this material.
+ *
+ *****************************************************************************/
+
+/**
+ * @file statistics.c
+ * @brief Streaming statistics module.
+ *
+ * Running minimum, maximum, mean and RMS over a sliding window of the last
+ * samples from a source signal, such as a net signal from control framework.
+ *
+ * @author gabriel.brunheira
+ * @date 19/10/2026
+ *
+ */
+
+#include <math.h>
+#include "common/statistics.h"
+
+#pragma CODE_SECTION(run_stats, "ramfuncs");
+
+/**
+ * Initialization of streaming statistics tracker.
+ *
+ * @param p_stats pointer to statistics struct
+ * @param freq_base frequency of calls to RUN_STATS() [Hz]
+ * @param freq_sampling sampling frequency of source signal [Hz]
+ * @param size window size, in samples [1 - STATS_MAX_WINDOW_SIZE]
+ * @param p_source pointer to source signal
+ */
+void init_stats(stats_t *p_stats, float freq_base, float freq_sampling,
+                uint16_t size, volatile float *p_source)
+{
+    p_stats->p_source = p_source;
+
+    init_timeslicer(&p_stats->timeslicer, freq_base);
+    cfg_timeslicer(&p_stats->timeslicer, freq_sampling);
+
+    cfg_size_stats(p_stats, size);
+}
+
+/**
+ * Configure window size. Window is cleared.
+ *
+ * @param p_stats pointer to statistics struct
+ * @param size window size, in samples [1 - STATS_MAX_WINDOW_SIZE]
+ */
+void cfg_size_stats(stats_t *p_stats, uint16_t size)
+{
+    if(size < 1)
+    {
+        size = 1;
+    }
+    else if(size > STATS_MAX_WINDOW_SIZE)
+    {
+        size = STATS_MAX_WINDOW_SIZE;
+    }
+
+    p_stats->size = size;
+    reset_stats(p_stats);
+}
+
+/**
+ * Configure source signal. Window is cleared.
+ *
+ * @param p_stats pointer to statistics struct
+ * @param p_source pointer to source signal
+ */
+void cfg_source_stats(stats_t *p_stats, volatile float *p_source)
+{
+    p_stats->p_source = p_source;
+    reset_stats(p_stats);
+}
+
+/**
+ * Clear window and accumulators.
+ *
+ * @param p_stats pointer to statistics struct
+ */
+void reset_stats(stats_t *p_stats)
+{
+    uint16_t i;
+
+    p_stats->num_samples = 0;
+    p_stats->pos = 0;
+    p_stats->idx = 0;
+
+    p_stats->sum = 0.0;
+    p_stats->sum_sq = 0.0;
+    p_stats->lap_sum = 0.0;
+    p_stats->lap_sum_sq = 0.0;
+    p_stats->min = 0.0;
+    p_stats->max = 0.0;
+
+    for(i = 0; i < STATS_MAX_WINDOW_SIZE; i++)
+    {
+        p_stats->window[i] = 0.0;
+    }
+
+    for(i = 0; i < STATS_NUM_BLOCKS; i++)
+    {
+        p_stats->block_min[i] = 0.0;
+        p_stats->block_max[i] = 0.0;
+    }
+
+    for(i = 0; i < STATS_BLOCK_SIZE; i++)
+    {
+        p_stats->suffix_min[0][i] = 0.0;
+        p_stats->suffix_min[1][i] = 0.0;
+        p_stats->suffix_max[0][i] = 0.0;
+        p_stats->suffix_max[1][i] = 0.0;
+    }
+
+    reset_timeslicer(&p_stats->timeslicer);
+}
+
+/**
+ * Insert new sample from source signal into the window.
+ *
+ * Running sums are updated by adding the new sample and subtracting the
+ * evicted one. In parallel, the sums for the current lap over the window are
+ * accumulated from zero. When the lap is completed, these contain exactly the
+ * last ```size``` samples and replace the running sums, discarding any
+ * rounding error accumulated during the previous lap.
+ *
+ * Window ```[start, pos]``` spans the suffix of block containing ```start```,
+ * whose extremes must be ready, and the following blocks up to the current
+ * one, whose extremes are kept for its samples so far. On each sample, one
+ * more suffix extreme of the block after ```start``` is computed, backwards,
+ * so it's complete when ```start``` enters that block. Since this block must
+ * be completed by then, it only applies to windows larger than 2 blocks.
+ * Until window is filled, extremes are the ones of all samples so far.
+ *
+ * @param p_stats pointer to statistics struct
+ */
+void run_stats(stats_t *p_stats)
+{
+    uint16_t i, n, start, block, off, parity;
+    float new_sample, old_sample, x, min, max;
+
+    new_sample = *(p_stats->p_source);
+    old_sample = p_stats->window[(uint16_t)(p_stats->pos - p_stats->size) &
+                                 STATS_WINDOW_MASK];
+    p_stats->window[p_stats->pos & STATS_WINDOW_MASK] = new_sample;
+
+    if(p_stats->num_samples < p_stats->size)
+    {
+        p_stats->num_samples++;
+        old_sample = 0.0;
+    }
+
+    p_stats->sum += new_sample - old_sample;
+    p_stats->sum_sq += new_sample*new_sample - old_sample*old_sample;
+    p_stats->lap_sum += new_sample;
+    p_stats->lap_sum_sq += new_sample*new_sample;
+
+    if(++p_stats->idx == p_stats->size)
+    {
+        p_stats->idx = 0;
+
+        p_stats->sum = p_stats->lap_sum;
+        p_stats->sum_sq = p_stats->lap_sum_sq;
+        p_stats->lap_sum = 0.0;
+        p_stats->lap_sum_sq = 0.0;
+    }
+
+    /// Extremes of current block so far
+    block = (p_stats->pos / STATS_BLOCK_SIZE) & STATS_NUM_BLOCKS_MASK;
+
+    if( !(p_stats->pos & STATS_BLOCK_MASK) ||
+        (new_sample < p_stats->block_min[block]) )
+    {
+        p_stats->block_min[block] = new_sample;
+    }
+
+    if( !(p_stats->pos & STATS_BLOCK_MASK) ||
+        (new_sample > p_stats->block_max[block]) )
+    {
+        p_stats->block_max[block] = new_sample;
+    }
+
+    /// Next suffix extremes of block after start, also while window is filled
+    start = p_stats->pos - p_stats->size + 1;
+    off = start & STATS_BLOCK_MASK;
+    parity = (start / STATS_BLOCK_SIZE + 1) & 1;
+    i = STATS_BLOCK_MASK - off;
+    x = p_stats->window[((start | STATS_BLOCK_MASK) + 1 + i) &
+                        STATS_WINDOW_MASK];
+
+    if( (i == STATS_BLOCK_MASK) || (x < p_stats->suffix_min[parity][i+1]) )
+    {
+        p_stats->suffix_min[parity][i] = x;
+    }
+    else
+    {
+        p_stats->suffix_min[parity][i] = p_stats->suffix_min[parity][i+1];
+    }
+
+    if( (i == STATS_BLOCK_MASK) || (x > p_stats->suffix_max[parity][i+1]) )
+    {
+        p_stats->suffix_max[parity][i] = x;
+    }
+    else
+    {
+        p_stats->suffix_max[parity][i] = p_stats->suffix_max[parity][i+1];
+    }
+
+    /// Window extremes
+    if(p_stats->num_samples < p_stats->size)
+    {
+        if( (p_stats->num_samples == 1) || (new_sample < p_stats->min) )
+        {
+            p_stats->min = new_sample;
+        }
+
+        if( (p_stats->num_samples == 1) || (new_sample > p_stats->max) )
+        {
+            p_stats->max = new_sample;
+        }
+    }
+    else if(p_stats->size <= 2 * STATS_BLOCK_SIZE)
+    {
+        min = new_sample;
+        max = new_sample;
+
+        for(i = 1; i < p_stats->size; i++)
+        {
+            x = p_stats->window[(uint16_t)(p_stats->pos - i) & STATS_WINDOW_MASK];
+
+            if(x < min)
+            {
+                min = x;
+            }
+
+            if(x > max)
+            {
+                max = x;
+            }
+        }
+
+        p_stats->min = min;
+        p_stats->max = max;
+    }
+    else
+    {
+        min = p_stats->suffix_min[parity ^ 1][off];
+        max = p_stats->suffix_max[parity ^ 1][off];
+
+        /// Blocks after start one, up to current, counted modulo position wrap
+        n = (uint16_t)(p_stats->pos - (start - off)) / STATS_BLOCK_SIZE;
+        block = start / STATS_BLOCK_SIZE;
+
+        for(i = 0; i < n; i++)
+        {
+            block = (block + 1) & STATS_NUM_BLOCKS_MASK;
+
+            if(p_stats->block_min[block] < min)
+            {
+                min = p_stats->block_min[block];
+            }
+
+            if(p_stats->block_max[block] > max)
+            {
+                max = p_stats->block_max[block];
+            }
+        }
+
+        p_stats->min = min;
+        p_stats->max = max;
+    }
+
+    p_stats->pos++;
+}
+
+float get_min_stats(stats_t *p_stats)
+{
+    return p_stats->min;
+}
+
+float get_max_stats(stats_t *p_stats)
+{
+    return p_stats->max;
+}
+
+float get_mean_stats(stats_t *p_stats)
+{
+    if(p_stats->num_samples)
+    {
+        return p_stats->sum / ((float) p_stats->num_samples);
+    }
+
+    return 0.0;
+}
+
+float get_rms_stats(stats_t *p_stats)
+{
+    float mean_sq;
+
+    if(p_stats->num_samples)
+    {
+        mean_sq = p_stats->sum_sq / ((float) p_stats->num_samples);
+
+        if(mean_sq > 0.0)
+        {
+            return sqrtf(mean_sq);
+        }
+    }
+
+    return 0.0;
+}
+
+/**
+ * Test to indicate whether any sample of a full window is outside the limits
+ * determined by ```value +/- tol```. A window not yet filled is considered out
+ * of limits, since it doesn't guarantee the signal is settled.
+ *
+ * @param p_stats pointer to statistics struct
+ * @param value reference value for test
+ * @param tol tolerance value for test
+ * @return 1 if out of limits, 0 otherwise
+ */
+uint16_t test_stats_limits(stats_t *p_stats, float value, float tol)
+{
+    if( (p_stats->num_samples < p_stats->size) ||
+        (get_min_stats(p_stats) < value - tol) ||
+        (get_max_stats(p_stats) > value + tol) )
+    {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+/******************************************************************************
+ * Copyright (C) 2026 by LNLS - Brazilian Synchrotron Light Laboratory
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. LNLS and
+ * the Brazilian Center for Research in Energy and Materials (CNPEM) are not
+ * liable for any misuse of this material.
+ *
+ *****************************************************************************/
+
+/**
+ * @file statistics.h
+ * @brief Streaming statistics module.
+ *
+ * Running minimum, maximum, mean and RMS over a sliding window of the last
+ * samples from a source signal, such as a net signal from control framework.
+ * Each new sample is processed in bounded time, regardless of signal, so it
+ * can run on control ISR, and settling checks don't need to scan a whole
+ * buffer.
+ *
+ * Minimum and maximum are tracked by block decomposition: window samples are
+ * grouped in blocks of STATS_BLOCK_SIZE, whose minimum and maximum are kept.
+ * Window extremes combine the blocks it covers with the suffix extremes of
+ * its oldest, partially covered block, which are computed one sample at a
+ * time before that block becomes the oldest. Each sample therefore costs at
+ * most about STATS_MAX_WINDOW_SIZE / STATS_BLOCK_SIZE comparisons, or
+ * 2 x STATS_BLOCK_SIZE for windows up to 2 blocks, which are just scanned.
+ *
+ * Sums are restarted from scratch at each window lap, so floating-point
+ * rounding errors don't accumulate over time.
+ *
+ * @author gabriel.brunheira
+ * @date 19/10/2026
+ *
+ */
+
+#ifndef STATISTICS_H_
+#define STATISTICS_H_
+
+#include <stdint.h>
+#include "common/timeslicer.h"
+
+/**
+ * Maximum window size and block size, in samples. Both must be powers of 2,
+ * with window size up to 32768, and may be overridden on build options.
+ * Default fits a 128 ms window sampled at 1 kHz, which covers DC-link
+ * settling and mains ripple. Each tracker takes about
+ * 2 x STATS_MAX_WINDOW_SIZE x (1 + 4 / STATS_BLOCK_SIZE) + 8 x STATS_BLOCK_SIZE
+ * words of RAM, i.e., about 450 words by default.
+ */
+#ifndef STATS_MAX_WINDOW_SIZE
+#define STATS_MAX_WINDOW_SIZE   128
+#endif
+
+#ifndef STATS_BLOCK_SIZE
+#define STATS_BLOCK_SIZE        8
+#endif
+
+#if (STATS_MAX_WINDOW_SIZE < 1) || (STATS_MAX_WINDOW_SIZE > 32768) || \
+    (STATS_MAX_WINDOW_SIZE & (STATS_MAX_WINDOW_SIZE - 1))
+#error "STATS_MAX_WINDOW_SIZE must be a power of 2, up to 32768"
+#endif
+
+#if (STATS_BLOCK_SIZE < 1) || (STATS_BLOCK_SIZE > STATS_MAX_WINDOW_SIZE) || \
+    (STATS_BLOCK_SIZE & (STATS_BLOCK_SIZE - 1))
+#error "STATS_BLOCK_SIZE must be a power of 2, up to STATS_MAX_WINDOW_SIZE"
+#endif
+
+#define STATS_WINDOW_MASK       (STATS_MAX_WINDOW_SIZE - 1)
+#define STATS_BLOCK_MASK        (STATS_BLOCK_SIZE - 1)
+#define STATS_NUM_BLOCKS        (2 * STATS_MAX_WINDOW_SIZE / STATS_BLOCK_SIZE)
+#define STATS_NUM_BLOCKS_MASK   (STATS_NUM_BLOCKS - 1)
+
+#define RUN_STATS(stats)    RUN_TIMESLICER(stats.timeslicer)    \
+                                run_stats(&stats);              \
+                            END_TIMESLICER(stats.timeslicer)
+
+typedef volatile struct
+{
+    uint16_t        size;
+    uint16_t        num_samples;
+    uint16_t        pos;
+    uint16_t        idx;
+    volatile float  *p_source;
+    timeslicer_t    timeslicer;
+    float           sum;
+    float           sum_sq;
+    float           lap_sum;
+    float           lap_sum_sq;
+    float           min;
+    float           max;
+    float           window[STATS_MAX_WINDOW_SIZE];      ///< Indexed by pos
+    float           block_min[STATS_NUM_BLOCKS];
+    float           block_max[STATS_NUM_BLOCKS];
+    float           suffix_min[2][STATS_BLOCK_SIZE];    ///< By block parity
+    float           suffix_max[2][STATS_BLOCK_SIZE];
+} stats_t;
+
+/**
+ * Initialization of streaming statistics tracker.
+ *
+ * @param p_stats pointer to statistics struct
+ * @param freq_base frequency of calls to RUN_STATS() [Hz]
+ * @param freq_sampling sampling frequency of source signal [Hz]
+ * @param size window size, in samples [1 - STATS_MAX_WINDOW_SIZE]
+ * @param p_source pointer to source signal
+ */
+extern void init_stats(stats_t *p_stats, float freq_base, float freq_sampling,
+                       uint16_t size, volatile float *p_source);
+
+/**
+ * Configure window size. Window is cleared.
+ *
+ * @param p_stats pointer to statistics struct
+ * @param size window size, in samples [1 - STATS_MAX_WINDOW_SIZE]
+ */
+extern void cfg_size_stats(stats_t *p_stats, uint16_t size);
+
+/**
+ * Configure source signal. Window is cleared.
+ *
+ * @param p_stats pointer to statistics struct
+ * @param p_source pointer to source signal
+ */
+extern void cfg_source_stats(stats_t *p_stats, volatile float *p_source);
+
+/**
+ * Clear window and accumulators.
+ *
+ * @param p_stats pointer to statistics struct
+ */
+extern void reset_stats(stats_t *p_stats);
+
+/**
+ * Insert new sample from source signal into the window.
+ *
+ * @param p_stats pointer to statistics struct
+ */
+extern void run_stats(stats_t *p_stats);
+
+extern float get_min_stats(stats_t *p_stats);
+extern float get_max_stats(stats_t *p_stats);
+extern float get_mean_stats(stats_t *p_stats);
+extern float get_rms_stats(stats_t *p_stats);
+
+/**
+ * Test to indicate whether any sample of a full window is outside the limits
+ * determined by ```value +/- tol```. A window not yet filled is considered out
+ * of limits, since it doesn't guarantee the signal is settled.
+ *
+ * @param p_stats pointer to statistics struct
+ * @param value reference value for test
+ * @param tol tolerance value for test
+ * @return 1 if out of limits, 0 otherwise
+ */
+extern uint16_t test_stats_limits(stats_t *p_stats, float value, float tol);
+
+#endif /* STATISTICS_H_ */
@@ -162,32 +162,28 @@ uint16_t insert_buffer(buf_t *p_buf, float data)
 
 /**
  * Test to indicate whether the buffer contains any sample outside the limits
- * determined by the
+ * determined by ```value +/- tol```. It scans the whole buffer without
+ * touching its index pointer, so it's safe to use on a buffer being filled.
+ * For settling checks on a signal in real-time, prefer the streaming
+ * statistics from ```common/statistics.h```, which are O(1) per query.
  *
  * @param p_buf pointer to buffer structure
  * @param value reference value for test
  * @param tol tolerance value for test
- * @return
+ * @return 1 if any sample is out of limits, 0 otherwise
  */
 uint16_t test_buffer_limits(buf_t *p_buf, float value, float tol)
 {
-    float samp;
+    volatile float *p_samp;
 
-    p_buf->p_buf_idx = p_buf->p_buf_start;
-
-    while(p_buf->p_buf_idx <= p_buf->p_buf_end)
+    for(p_samp = p_buf->p_buf_start; p_samp <= p_buf->p_buf_end; p_samp++)
     {
-        samp = *(p_buf->p_buf_idx++);
-
-        if( (samp < value - tol) || (samp > value + tol) )
+        if( (*p_samp < value - tol) || (*p_samp > value + tol) )
         {
-            p_buf->p_buf_idx = p_buf->p_buf_start;
             return 1;
         }
-
     }
 
-    p_buf->p_buf_idx = p_buf->p_buf_start;
     return 0;
 }
 
@@ -0,0 +1,103 @@
+/******************************************************************************
+ * Copyright (C) 2026 by LNLS - Brazilian Synchrotron Light Laboratory
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. LNLS and
+ * the Brazilian Center for Research in Energy and Materials (CNPEM) are not
+ * liable for any misuse of this material.
+ *
+ *****************************************************************************/
+
+/**
+ * @file timestamp.c
+ * @brief Free-running timestamp module.
+ *
+ * CPU Timer 2 is used as a free-running 32-bit counter at CPU clock, which
+ * serves as timebase for latency measurements.
+ *
+ * @author gabriel.brunheira
+ * @date 19/10/2026
+ *
+ */
+
+#include "common/timestamp.h"
+
+#pragma CODE_SECTION(get_timestamp64,"ramfuncs");
+#pragma CODE_SECTION(latch_frame_stamp,"ramfuncs");
+
+/**
+ * Stamp of acquisition frame in use by control loop
+ */
+volatile frame_stamp_t g_frame_stamp;
+
+static uint32_t timestamp_high;
+static uint32_t timestamp_low;
+
+/**
+ * Initialization of CPU Timer 2 as free-running counter, with maximum period,
+ * no prescaler and interrupt disabled.
+ */
+void init_timestamp(void)
+{
+    CpuTimer2Regs.TCR.bit.TSS = 1;
+
+    timestamp_high = 0;
+    timestamp_low = 0;
+
+    g_frame_stamp.timestamp = 0;
+    g_frame_stamp.counter = 0;
+    g_frame_stamp.carrier_phase = 0.0;
+    g_frame_stamp.valid = 0;
+
+    CpuTimer2Regs.PRD.all = 0xFFFFFFFF;
+    CpuTimer2Regs.TPR.all = 0;
+    CpuTimer2Regs.TPRH.all = 0;
+    CpuTimer2Regs.TCR.bit.TIE = 0;
+    CpuTimer2Regs.TCR.bit.TRB = 1;
+    CpuTimer2Regs.TCR.bit.TSS = 0;
+}
+
+/**
+ * Get 64-bit timestamp, in CPU cycles. Its high word is incremented whenever
+ * the hardware counter is found to have wrapped around since last call, so it
+ * must be called at least once every 2^32 cycles. It may be called from any
+ * interrupt level.
+ *
+ * @return 64-bit timestamp
+ */
+uint64_t get_timestamp64(void)
+{
+    uint16_t int_status;
+    uint32_t low;
+    uint64_t timestamp;
+
+    int_status = __disable_interrupts();
+
+    low = GET_TIMESTAMP;
+
+    if(low < timestamp_low)
+    {
+        timestamp_high++;
+    }
+
+    timestamp_low = low;
+    timestamp = ((uint64_t) timestamp_high << 32) | low;
+
+    __restore_interrupts(int_status);
+
+    return timestamp;
+}
+
+/**
+ * Copy stamp of acquisition frame in use by control loop. It must be called
+ * from control ISR, which updates it, so copy is coherent.
+ *
+ * @param p_stamp pointer to destination stamp
+ */
+void latch_frame_stamp(frame_stamp_t *p_stamp)
+{
+    p_stamp->timestamp = g_frame_stamp.timestamp;
+    p_stamp->counter = g_frame_stamp.counter;
+    p_stamp->carrier_phase = g_frame_stamp.carrier_phase;
+    p_stamp->valid = g_frame_stamp.valid;
+}
@@ -0,0 +1,69 @@
+/******************************************************************************
+ * Copyright (C) 2026 by LNLS - Brazilian Synchrotron Light Laboratory
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. LNLS and
+ * the Brazilian Center for Research in Energy and Materials (CNPEM) are not
+ * liable for any misuse of this material.
+ *
+ *****************************************************************************/
+
+/**
+ * @file timestamp.h
+ * @brief Free-running timestamp module.
+ *
+ * CPU Timer 2 is used as a free-running 32-bit counter at CPU clock, which
+ * serves as timebase for latency measurements. It wraps around every
+ * 2^32 / (C28_FREQ_MHZ * 1e6) seconds, so differences between two
+ * timestamps are valid as long as they are shorter than that.
+ *
+ * A 64-bit timestamp, which doesn't wrap around in practice, is extended from
+ * it by software, as long as get_timestamp64() is called at least once per
+ * wrap around period.
+ *
+ * Since TI InitCpuTimers() stops CPU Timer 2, init_timestamp() must be called
+ * after it.
+ *
+ * Acquisition drivers stamp each frame of samples with the 64-bit timestamp
+ * and carrier phase of its last conversion, and publish the stamp of the frame
+ * in use by control loop on g_frame_stamp. Consumers, such as scopes and
+ * status snapshot, latch it along with their samples, so they can be related
+ * to each other, to sync pulses (see g_sync.timestamp) or to other power
+ * supplies without assuming constant delays. Drivers mark a stamp as invalid
+ * when they can't determine it, e.g., when its frame was serviced too late.
+ * It remains zero, and invalid, on modules without such acquisition driver.
+ *
+ * @author gabriel.brunheira
+ * @date 19/10/2026
+ *
+ */
+
+#ifndef TIMESTAMP_H_
+#define TIMESTAMP_H_
+
+#include <stdint.h>
+#include "boards/udc_c28.h"
+
+#define TIMESTAMP_FREQ      (C28_FREQ_MHZ * 1000000.0)
+
+/**
+ * Current timestamp, in CPU cycles. CPU Timer 2 counts down, so it's
+ * complemented to result in an up-counter.
+ */
+#define GET_TIMESTAMP       (~CpuTimer2Regs.TIM.all)
+
+typedef volatile struct
+{
+    uint64_t    timestamp;          ///< Last conversion of frame [CPU cycles]
+    uint32_t    counter;            ///< Frame sequence number
+    float       carrier_phase;      ///< Of PWM carrier on last conversion [pu]
+    uint16_t    valid;              ///< Timestamp and carrier phase are valid
+} frame_stamp_t;
+
+extern volatile frame_stamp_t g_frame_stamp;
+
+extern void init_timestamp(void);
+extern uint64_t get_timestamp64(void);
+extern void latch_frame_stamp(frame_stamp_t *p_stamp);
+
+#endif /* TIMESTAMP_H_ */
@@ -33,10 +33,14 @@
  *
  */
 
+#include <math.h>
 #include <stdint.h>
 #include "boards/udc_c28.h"
+#include "common/timestamp.h"
 #include "event_manager/event_manager.h"
 #include "ipc/ipc.h"
+#include "pwm/pwm.h"
+#include "postmortem/postmortem.h"
 
 /**
  * Maximum debouncing parameters
@@ -45,31 +49,54 @@
 #define MAX_RESET_TIME_US       10000000
 
 /**
- * Private variables
+ * Private functions
  */
+static void init_debounce_counters(volatile debounce_counters_t *p_counters,
+                                   float freq_timebase, uint16_t num_events,
+                                   uint32_t *p_debounce_time_us,
+                                   uint32_t *p_reset_time_us);
+static void run_debounce_counters(volatile debounce_counters_t *p_counters,
+                                  uint32_t timebase_counter);
+static uint16_t debounce_event(volatile debounce_counters_t *p_counters,
+                               uint32_t timebase_counter, uint32_t itlk);
+static void latch_hard_interlock(uint16_t id, uint32_t itlk, float value,
+                                 soe_source_t source, uint32_t t_detect);
+static void latch_soft_interlock(uint16_t id, uint32_t itlk, float value,
+                                 soe_source_t source, uint32_t t_detect);
+static void record_itlk_latency(soe_source_t source, uint32_t t_detect,
+                                uint32_t t_turn_off, uint32_t t_pwm_off);
+static void record_soe(uint16_t id, uint32_t itlk, soe_event_t event,
+                       soe_source_t source, uint16_t first_fault, float value);
 
-/// Look-up-table to convert bit-position to bit mask
-const static uint32_t lut_bit_position[32] =
-{
-    0x00000001, 0x00000002, 0x00000004, 0x00000008,
-    0x00000010, 0x00000020, 0x00000040, 0x00000080,
-    0x00000100, 0x00000200, 0x00000400, 0x00000800,
-    0x00001000, 0x00002000, 0x00004000, 0x00008000,
-    0x00010000, 0x00020000, 0x00040000, 0x00080000,
-    0x00100000, 0x00200000, 0x00400000, 0x00800000,
-    0x01000000, 0x02000000, 0x04000000, 0x08000000,
-    0x10000000, 0x20000000, 0x40000000, 0x80000000
-};
+/**
+ * Private variables
+ */
+static trip_zone_itlk_t trip_zone_itlks[NUM_MAX_TRIP_ZONE_ITLKS];
 
 /**
  * Public variables
  */
 volatile event_manager_t g_event_manager[NUM_MAX_PS_MODULES];
 
+#pragma DATA_SECTION(g_soe,"SHARERAMS1_1_EVENTS");
+#pragma DATA_SECTION(g_itlk_latency,"SHARERAMS1_1_EVENTS");
+volatile soe_t g_soe;
+volatile itlk_latency_t g_itlk_latency[NUM_ITLK_LATENCY_PATHS];
+
 #pragma CODE_SECTION(set_hard_interlock, "ramfuncs");
 #pragma CODE_SECTION(set_soft_interlock, "ramfuncs");
+#pragma CODE_SECTION(set_hard_interlocks, "ramfuncs");
+#pragma CODE_SECTION(set_soft_interlocks, "ramfuncs");
+#pragma CODE_SECTION(run_threshold_interlocks, "ramfuncs");
+#pragma CODE_SECTION(debounce_event, "ramfuncs");
+#pragma CODE_SECTION(latch_hard_interlock, "ramfuncs");
+#pragma CODE_SECTION(latch_soft_interlock, "ramfuncs");
+#pragma CODE_SECTION(record_soe, "ramfuncs");
+#pragma CODE_SECTION(record_soe_fault, "ramfuncs");
+#pragma CODE_SECTION(record_itlk_latency, "ramfuncs");
 #pragma CODE_SECTION(isr_hard_interlock, "ramfuncs");
 #pragma CODE_SECTION(isr_soft_interlock, "ramfuncs");
+#pragma CODE_SECTION(isr_trip_zone, "ramfuncs");
 
 /**
  * Initialization of specified event manager. There is a separate event manager
@@ -94,190 +121,230 @@ void init_event_manager(uint16_t id, float freq_timebase,
                         uint32_t *p_soft_itlks_reset_time_us)
 {
     uint16_t i;
-    uint32_t debounce_time_us, reset_time_us, max_reset_counts;
-
-    max_reset_counts = (uint32_t) ((freq_timebase * MAX_RESET_TIME_US) * 1e-6);
 
     g_event_manager[id].timebase_flag = 0;
+    g_event_manager[id].timebase_counter = 0;
     g_event_manager[id].freq_timebase = freq_timebase;
-    g_event_manager[id].hard_interlocks.num_events = num_hard_itlks;
-    g_event_manager[id].soft_interlocks.num_events = num_soft_itlks;
-
-    for(i = 0; i < NUM_MAX_EVENT_COUNTER; i++)
-    {
-        g_event_manager[id].hard_interlocks.event[i].flag = 0;
-        g_event_manager[id].hard_interlocks.event[i].counter = 0;
-
-        /// Initialization of hard interlocks
-        if(i < num_hard_itlks)
-        {
-            debounce_time_us = *(p_hard_itlks_debounce_time_us + i);
-            reset_time_us = *(p_hard_itlks_reset_time_us+i);
-
-            /** Prevents bypassing a interlock by setting a very large debounce
-             * time
-             */
-            SATURATE(debounce_time_us, MAX_DEBOUNCE_TIME_US , 0);
-
-            g_event_manager[id].hard_interlocks.event[i].debounce_count =
-                    (uint32_t) ( (freq_timebase * debounce_time_us) * 1e-6);
-            g_event_manager[id].hard_interlocks.event[i].reset_count =
-                    (uint32_t) ( (freq_timebase * reset_time_us) * 1e-6);
-
-            /**
-             *  Prevents bypassing an interlock by setting a reset time smaller
-             *  than debounce time.
-             */
-            SATURATE(g_event_manager[id].hard_interlocks.event[i].reset_count,
-                     max_reset_counts,
-                     g_event_manager[id].hard_interlocks.event[i].debounce_count+1);
-
-        }
-        else
-        {
-            g_event_manager[id].hard_interlocks.event[i].debounce_count = 0;
-            g_event_manager[id].hard_interlocks.event[i].reset_count = 0;
-        }
-
-        /// Initialization of soft interlocks
-        g_event_manager[id].soft_interlocks.event[i].flag = 0;
-        g_event_manager[id].soft_interlocks.event[i].counter = 0;
 
-        if(i < num_soft_itlks)
-        {
-            debounce_time_us = *(p_soft_itlks_debounce_time_us + i);
-            reset_time_us = *(p_soft_itlks_reset_time_us+i);
-
-            /** Prevents bypassing a interlock by setting a very large debounce
-             * time
-             */
-            SATURATE(debounce_time_us, MAX_DEBOUNCE_TIME_US , 0);
+    init_debounce_counters(&g_event_manager[id].hard_interlocks, freq_timebase,
+                           num_hard_itlks, p_hard_itlks_debounce_time_us,
+                           p_hard_itlks_reset_time_us);
 
-            g_event_manager[id].soft_interlocks.event[i].debounce_count =
-                    (uint32_t) ( (freq_timebase * debounce_time_us) * 1e-6);
-            g_event_manager[id].soft_interlocks.event[i].reset_count =
-                    (uint32_t) ( (freq_timebase * reset_time_us) * 1e-6);
+    init_debounce_counters(&g_event_manager[id].soft_interlocks, freq_timebase,
+                           num_soft_itlks, p_soft_itlks_debounce_time_us,
+                           p_soft_itlks_reset_time_us);
 
-            /**
-             *  Prevents bypassing an interlock by setting a reset time smaller
-             *  than debounce time.
-             */
-            SATURATE(g_event_manager[id].soft_interlocks.event[i].reset_count,
-                     max_reset_counts,
-                     g_event_manager[id].soft_interlocks.event[i].debounce_count+1);
-        }
-        else
+    /// Trip-zone interlocks must be configured again by ps_module
+    for(i = 0; i < NUM_MAX_TRIP_ZONE_ITLKS; i++)
+    {
+        if(trip_zone_itlks[i].id == id)
         {
-            g_event_manager[id].soft_interlocks.event[i].debounce_count = 0;
-            g_event_manager[id].soft_interlocks.event[i].reset_count = 0;
+            trip_zone_itlks[i].enable = 0;
         }
     }
 }
 
 /**
  * Run debounce logic of interlocks for specified power supply/module. It checks
- * whether a time-base period has occured using timebase_flag, than increments
- * debounce counters for flagged interlocks. If a counter exceeds its reset
- * value (reset_time) before the interlock condition remains for sufficient time
+ * whether a time-base period has occured using timebase_flag, than advances
+ * the time-base counter. If a flagged interlock reaches its reset time
+ * (reset_time) before the interlock condition remains for sufficient time
  * (debounce_time), it resets. This function must be called at a higher
  * frequency than the time-base, for example, inside a background while loop.
  *
+ * Pending interlocks are only scanned when the earliest of them expires, so
+ * most time-base periods cost just a couple of word-wide operations.
+ *
  * @param id id of event manager specific of a power supply/module
  */
 void run_interlocks_debouncing(uint16_t id)
 {
-    uint16_t i;
+    uint32_t timebase_counter;
 
     /// Check once per time-base period indicated by this flag
     if(g_event_manager[id].timebase_flag)
     {
-        for(i = 0; i < g_event_manager[id].hard_interlocks.num_events; i++)
-        {
-            if( g_event_manager[id].hard_interlocks.event[i].flag )
-            {
-                if(++g_event_manager[id].hard_interlocks.event[i].counter >=
-                     g_event_manager[id].hard_interlocks.event[i].reset_count)
-                {
-                    g_event_manager[id].hard_interlocks.event[i].flag = 0;
-                    g_event_manager[id].hard_interlocks.event[i].counter = 0;
-                }
-            }
-        }
+        timebase_counter = ++g_event_manager[id].timebase_counter;
 
-        for(i = 0; i < g_event_manager[id].soft_interlocks.num_events; i++)
-        {
-            if( g_event_manager[id].soft_interlocks.event[i].flag )
-            {
-                if(++g_event_manager[id].soft_interlocks.event[i].counter >=
-                     g_event_manager[id].soft_interlocks.event[i].reset_count)
-                {
-                    g_event_manager[id].soft_interlocks.event[i].flag = 0;
-                    g_event_manager[id].soft_interlocks.event[i].counter = 0;
-                }
-            }
-        }
+        run_debounce_counters(&g_event_manager[id].hard_interlocks,
+                              timebase_counter);
+        run_debounce_counters(&g_event_manager[id].soft_interlocks,
+                              timebase_counter);
 
         g_event_manager[id].timebase_flag = 0;
     }
 }
 
 /**
- * Set specified hard interlock for specified module. First, it sets a flag to
- * enable counter (incremented at each time-base period), and if it reaches
- * the debounce count, interlock is setted.
+ * Set specified hard interlock for specified module. First, it flags the
+ * interlock as pending, and if it remains pending for the debounce time,
+ * interlock is setted.
  *
  * @param id id of event manager specific of a power supply/module
  * @param itlk specified hard interlock
  */
 void set_hard_interlock(uint16_t id, uint32_t itlk)
 {
-    g_event_manager[id].hard_interlocks.event[itlk].flag = 1;
+    uint32_t t_detect;
+
+    t_detect = GET_TIMESTAMP;
+
+    if(debounce_event(&g_event_manager[id].hard_interlocks,
+                      g_event_manager[id].timebase_counter, itlk))
+    {
+        latch_hard_interlock(id, itlk, 0.0, SOE_Source_C28, t_detect);
+    }
+}
+
+/**
+ * Set specified soft interlock for specified module. First, it flags the
+ * interlock as pending, and if it remains pending for the debounce time,
+ * interlock is setted.
+ *
+ * @param id id of event manager specific of a power supply/module
+ * @param itlk specified soft interlock
+ */
+void set_soft_interlock(uint16_t id, uint32_t itlk)
+{
+    uint32_t t_detect;
 
-    if(g_event_manager[id].hard_interlocks.event[itlk].counter >=
-       g_event_manager[id].hard_interlocks.event[itlk].debounce_count)
+    t_detect = GET_TIMESTAMP;
+
+    if(debounce_event(&g_event_manager[id].soft_interlocks,
+                      g_event_manager[id].timebase_counter, itlk))
     {
-        if(!(g_ipc_ctom.ps_module[id].ps_hard_interlock & lut_bit_position[itlk]))
+        latch_soft_interlock(id, itlk, 0.0, SOE_Source_C28, t_detect);
+    }
+}
+
+/**
+ * Set hard interlocks indicated by bitmask for specified module, as done by
+ * set_hard_interlock() for each of them.
+ *
+ * @param id id of event manager specific of a power supply/module
+ * @param itlks bitmask of hard interlocks
+ */
+void set_hard_interlocks(uint16_t id, uint32_t itlks)
+{
+    uint16_t itlk;
+
+    for(itlk = 0; itlks; itlk++, itlks >>= 1)
+    {
+        if(itlks & 1)
         {
-            #ifdef USE_ITLK
-            g_ipc_ctom.ps_module[id].turn_off(id);
-            g_ipc_ctom.ps_module[id].ps_status.bit.state = Interlock;
-            #endif
+            set_hard_interlock(id, itlk);
+        }
+    }
+}
 
-            g_ipc_ctom.ps_module[id].ps_hard_interlock |= lut_bit_position[itlk];
+/**
+ * Set soft interlocks indicated by bitmask for specified module, as done by
+ * set_soft_interlock() for each of them.
+ *
+ * @param id id of event manager specific of a power supply/module
+ * @param itlks bitmask of soft interlocks
+ */
+void set_soft_interlocks(uint16_t id, uint32_t itlks)
+{
+    uint16_t itlk;
+
+    for(itlk = 0; itlks; itlk++, itlks >>= 1)
+    {
+        if(itlks & 1)
+        {
+            set_soft_interlock(id, itlk);
         }
+    }
+}
 
-        g_event_manager[id].hard_interlocks.event[itlk].flag = 0;
-        g_event_manager[id].hard_interlocks.event[itlk].counter = 0;
+/**
+ * Initialization of threshold interlocks table.
+ *
+ * @param p_table pointer to threshold interlocks table
+ * @param p_entries pointer to array of entries declared by ps_module
+ * @param num_entries number of entries [0 - 32]
+ */
+void init_threshold_interlocks(threshold_itlks_t *p_table,
+                               threshold_itlk_t *p_entries,
+                               uint16_t num_entries)
+{
+    if(num_entries > 32)
+    {
+        num_entries = 32;
     }
+
+    p_table->num_entries = num_entries;
+    p_table->violation = 0;
+    p_table->p_entries = p_entries;
 }
 
 /**
- * Set specified soft interlock for specified module. First, it sets a flag to
- * enable counter (incremented at each time-base period), and if it reaches
- * the debounce count, interlock is setted.
+ * Evaluate all entries from threshold interlocks table in a single pass,
+ * producing violation bitmasks of hard and soft interlocks, which are then
+ * set for specified module.
  *
  * @param id id of event manager specific of a power supply/module
- * @param itlk specified soft interlock
+ * @param p_table pointer to threshold interlocks table
  */
-void set_soft_interlock(uint16_t id, uint32_t itlk)
+void run_threshold_interlocks(uint16_t id, threshold_itlks_t *p_table)
 {
-    g_event_manager[id].soft_interlocks.event[itlk].flag = 1;
+    uint16_t i;
+    uint32_t entry_bit, violation, t_detect;
+    float value, hysteresis;
+    threshold_itlk_t *p_entry;
+
+    t_detect = GET_TIMESTAMP;
+    violation = 0;
+
+    p_entry = p_table->p_entries;
+    entry_bit = 1;
 
-    if(g_event_manager[id].soft_interlocks.event[itlk].counter >=
-       g_event_manager[id].soft_interlocks.event[itlk].debounce_count)
+    for(i = 0; i < p_table->num_entries; i++, p_entry++, entry_bit <<= 1)
     {
-        if(!(g_ipc_ctom.ps_module[id].ps_soft_interlock & lut_bit_position[itlk]))
+        value = *(p_entry->p_signal);
+
+        if(p_entry->use_abs)
         {
-            #ifdef USE_ITLK
-            g_ipc_ctom.ps_module[id].turn_off(id);
-            g_ipc_ctom.ps_module[id].ps_status.bit.state = Interlock;
-            #endif
+            value = fabs(value);
+        }
+
+        hysteresis = (p_table->violation & entry_bit) ? p_entry->hysteresis : 0.0;
 
-            g_ipc_ctom.ps_module[id].ps_soft_interlock |= lut_bit_position[itlk];
+        if( ((p_entry->p_max != 0) && (value > *(p_entry->p_max) - hysteresis)) ||
+            ((p_entry->p_min != 0) && (value < *(p_entry->p_min) + hysteresis)) )
+        {
+            violation |= entry_bit;
         }
+    }
+
+    p_table->violation = violation;
 
-        g_event_manager[id].soft_interlocks.event[itlk].flag = 0;
-        g_event_manager[id].soft_interlocks.event[itlk].counter = 0;
+    /// Only violated entries are visited, providing triggering value to SOE
+    for(i = 0, p_entry = p_table->p_entries; violation; i++, p_entry++, violation >>= 1)
+    {
+        if(violation & 1)
+        {
+            if(p_entry->type == Threshold_Hard_Itlk)
+            {
+                if(debounce_event(&g_event_manager[id].hard_interlocks,
+                                  g_event_manager[id].timebase_counter,
+                                  p_entry->itlk))
+                {
+                    latch_hard_interlock(id, p_entry->itlk, *(p_entry->p_signal),
+                                         SOE_Source_C28_Threshold, t_detect);
+                }
+            }
+            else
+            {
+                if(debounce_event(&g_event_manager[id].soft_interlocks,
+                                  g_event_manager[id].timebase_counter,
+                                  p_entry->itlk))
+                {
+                    latch_soft_interlock(id, p_entry->itlk, *(p_entry->p_signal),
+                                         SOE_Source_C28_Threshold, t_detect);
+                }
+            }
+        }
     }
 }
 
@@ -287,6 +354,11 @@ void set_soft_interlock(uint16_t id, uint32_t itlk)
  */
 interrupt void isr_hard_interlock(void)
 {
+    uint16_t itlk, first_fault;
+    uint32_t itlks, t_detect, t_turn_off, t_pwm_off;
+
+    t_detect = GET_TIMESTAMP;
+
     //if(!(g_ipc_ctom.ps_module[g_ipc_mtoc.msg_id].ps_hard_interlock &
     //     g_ipc_mtoc.ps_module[g_ipc_mtoc.msg_id].ps_hard_interlock))
     if( (g_ipc_ctom.ps_module[g_ipc_mtoc.msg_id].ps_hard_interlock &
@@ -294,12 +366,36 @@ interrupt void isr_hard_interlock(void)
          g_ipc_mtoc.ps_module[g_ipc_mtoc.msg_id].ps_hard_interlock )
     {
         #ifdef USE_ITLK
+        t_turn_off = GET_TIMESTAMP;
         g_ipc_ctom.ps_module[g_ipc_mtoc.msg_id].turn_off(g_ipc_mtoc.msg_id);
+        t_pwm_off = GET_TIMESTAMP;
         g_ipc_ctom.ps_module[g_ipc_mtoc.msg_id].ps_status.bit.state = Interlock;
         #endif
 
+        itlks = g_ipc_mtoc.ps_module[g_ipc_mtoc.msg_id].ps_hard_interlock &
+                ~g_ipc_ctom.ps_module[g_ipc_mtoc.msg_id].ps_hard_interlock;
+        first_fault =
+            !(g_ipc_ctom.ps_module[g_ipc_mtoc.msg_id].ps_hard_interlock ||
+              g_ipc_ctom.ps_module[g_ipc_mtoc.msg_id].ps_soft_interlock);
+
         g_ipc_ctom.ps_module[g_ipc_mtoc.msg_id].ps_hard_interlock |=
         g_ipc_mtoc.ps_module[g_ipc_mtoc.msg_id].ps_hard_interlock;
+
+        trigger_postmortem(&g_postmortem, g_ipc_mtoc.msg_id);
+
+        for(itlk = 0; itlks; itlk++, itlks >>= 1)
+        {
+            if(itlks & 1)
+            {
+                record_soe(g_ipc_mtoc.msg_id, itlk, SOE_Hard_Itlk_Set,
+                           SOE_Source_ARM, first_fault, 0.0);
+                first_fault = 0;
+            }
+        }
+
+        #ifdef USE_ITLK
+        record_itlk_latency(SOE_Source_ARM, t_detect, t_turn_off, t_pwm_off);
+        #endif
     }
 
     CtoMIpcRegs.MTOCIPCACK.all = HARD_INTERLOCK;
@@ -312,6 +408,11 @@ interrupt void isr_hard_interlock(void)
  */
 interrupt void isr_soft_interlock(void)
 {
+    uint16_t itlk, first_fault;
+    uint32_t itlks, t_detect, t_turn_off, t_pwm_off;
+
+    t_detect = GET_TIMESTAMP;
+
     //if(!(g_ipc_ctom.ps_module[g_ipc_mtoc.msg_id].ps_soft_interlock &
     //     g_ipc_mtoc.ps_module[g_ipc_mtoc.msg_id].ps_soft_interlock))
     if( (g_ipc_ctom.ps_module[g_ipc_mtoc.msg_id].ps_soft_interlock &
@@ -319,12 +420,34 @@ interrupt void isr_soft_interlock(void)
          g_ipc_mtoc.ps_module[g_ipc_mtoc.msg_id].ps_soft_interlock )
     {
         #ifdef USE_ITLK
+        t_turn_off = GET_TIMESTAMP;
         g_ipc_ctom.ps_module[g_ipc_mtoc.msg_id].turn_off(g_ipc_mtoc.msg_id);
+        t_pwm_off = GET_TIMESTAMP;
         g_ipc_ctom.ps_module[g_ipc_mtoc.msg_id].ps_status.bit.state = Interlock;
         #endif
 
+        itlks = g_ipc_mtoc.ps_module[g_ipc_mtoc.msg_id].ps_soft_interlock &
+                ~g_ipc_ctom.ps_module[g_ipc_mtoc.msg_id].ps_soft_interlock;
+        first_fault =
+            !(g_ipc_ctom.ps_module[g_ipc_mtoc.msg_id].ps_hard_interlock ||
+              g_ipc_ctom.ps_module[g_ipc_mtoc.msg_id].ps_soft_interlock);
+
         g_ipc_ctom.ps_module[g_ipc_mtoc.msg_id].ps_soft_interlock |=
         g_ipc_mtoc.ps_module[g_ipc_mtoc.msg_id].ps_soft_interlock;
+
+        for(itlk = 0; itlks; itlk++, itlks >>= 1)
+        {
+            if(itlks & 1)
+            {
+                record_soe(g_ipc_mtoc.msg_id, itlk, SOE_Soft_Itlk_Set,
+                           SOE_Source_ARM, first_fault, 0.0);
+                first_fault = 0;
+            }
+        }
+
+        #ifdef USE_ITLK
+        record_itlk_latency(SOE_Source_ARM, t_detect, t_turn_off, t_pwm_off);
+        #endif
     }
 
     CtoMIpcRegs.MTOCIPCACK.all = SOFT_INTERLOCK;
@@ -338,5 +461,575 @@ interrupt void isr_interlocks_timebase(void)
     SET_INTERLOCKS_TIMEBASE_FLAG(2);
     SET_INTERLOCKS_TIMEBASE_FLAG(3);
 
+    /// Keep 64-bit timestamp extension up to date
+    get_timestamp64();
+
     PieCtrlRegs.PIEACK.all |= PIEACK_GROUP1;
 }
+
+/**
+ * Configure trip-zone fast path for specified hard interlock. The specified
+ * GPIO is mapped to trip-zone input, which is enabled as one-shot trip source
+ * of specified PWM modules, and their trip-zone interrupts are routed to
+ * isr_trip_zone(). It must be called after PWM modules initialization and
+ * with global interrupts disabled.
+ *
+ * @param id id of event manager specific of a power supply/module
+ * @param itlk specified hard interlock
+ * @param tz trip-zone input [2 - 3]
+ * @param gpio C28 GPIO wired to interlock signal (active-low) [0 - 63]
+ * @param pwm_modules bitmask of PWM modules (from g_pwm_modules) to trip
+ * @return 1 if arguments are invalid, 0 otherwise
+ */
+uint16_t cfg_trip_zone_interlock(uint16_t id, uint32_t itlk, uint16_t tz,
+                                 uint16_t gpio, uint16_t pwm_modules)
+{
+    uint16_t i, n;
+
+    if( (id >= NUM_MAX_PS_MODULES) || (itlk >= NUM_MAX_HARD_INTERLOCKS) ||
+        (pwm_modules == 0) ||
+        (pwm_modules >> g_pwm_modules.num_modules) ||
+        cfg_pwm_trip_zone_input(tz, gpio) )
+    {
+        return 1;
+    }
+
+    trip_zone_itlks[tz - 2].id = id;
+    trip_zone_itlks[tz - 2].itlk = itlk;
+    trip_zone_itlks[tz - 2].gpio = gpio;
+    trip_zone_itlks[tz - 2].pwm_modules = pwm_modules;
+    trip_zone_itlks[tz - 2].enable = 1;
+
+    for(i = 0; i < g_pwm_modules.num_modules; i++)
+    {
+        if(pwm_modules & (1 << i))
+        {
+            enable_pwm_trip_zone(g_pwm_modules.pwm_regs[i], tz);
+
+            /// Find ePWM number, whose TZ interrupt is INTx<n> on PIE group 2
+            for(n = 1; n < 9; n++)
+            {
+                if(ePWM[n] == g_pwm_modules.pwm_regs[i])
+                {
+                    EALLOW;
+                    (&PieVectTable.EPWM1_TZINT)[n - 1] = &isr_trip_zone;
+                    EDIS;
+
+                    PieCtrlRegs.PIEIER2.all |= (1 << (n - 1));
+                    break;
+                }
+            }
+        }
+    }
+
+    IER |= M_INT2;
+
+    return 0;
+}
+
+/**
+ * ISR for trip-zone interrupt from PWM modules. Outputs were already forced
+ * off by hardware, so this only latches and records trip-zone interlocks.
+ *
+ * Software disabling of outputs also uses one-shot trip, but it marks PWM
+ * modules as disabled before forcing the trip, with interrupts disabled (see
+ * disable_pwm_output()), so only PWM modules tripped while enabled, i.e., by
+ * hardware, are considered. Software-requested trips are never latched.
+ *
+ * When several trip-zone interlocks share a tripped PWM module, the one with
+ * its input still active is taken. If none is, because input pulse was
+ * already gone, all of them are latched, so a hardware trip is never left
+ * unrecorded.
+ */
+interrupt void isr_trip_zone(void)
+{
+    uint16_t i, tripped, claimed, gpio_active;
+    uint32_t t_detect, gpio_data;
+
+    t_detect = GET_TIMESTAMP;
+
+    tripped = 0;
+
+    for(i = 0; i < g_pwm_modules.num_modules; i++)
+    {
+        if( g_pwm_modules.pwm_regs[i]->TZFLG.bit.OST &&
+            (g_pwm_modules.pwm_state[i] == PWM_ENABLED) )
+        {
+            tripped |= (1 << i);
+        }
+    }
+
+    claimed = 0;
+
+    for(i = 0; i < NUM_MAX_TRIP_ZONE_ITLKS; i++)
+    {
+        if( trip_zone_itlks[i].enable &&
+            (trip_zone_itlks[i].pwm_modules & tripped) )
+        {
+            if(trip_zone_itlks[i].gpio < 32)
+            {
+                gpio_data = GpioDataRegs.GPADAT.all >> trip_zone_itlks[i].gpio;
+            }
+            else
+            {
+                gpio_data = GpioDataRegs.GPBDAT.all >> (trip_zone_itlks[i].gpio - 32);
+            }
+
+            gpio_active = !(gpio_data & 1);
+
+            if(gpio_active)
+            {
+                claimed |= trip_zone_itlks[i].pwm_modules;
+                latch_hard_interlock(trip_zone_itlks[i].id,
+                                     trip_zone_itlks[i].itlk, 0.0,
+                                     SOE_Source_Trip_Zone, t_detect);
+            }
+        }
+    }
+
+    /// Hardware trips not claimed by any active input
+    for(i = 0; i < NUM_MAX_TRIP_ZONE_ITLKS; i++)
+    {
+        if( trip_zone_itlks[i].enable &&
+            (trip_zone_itlks[i].pwm_modules & tripped & ~claimed) )
+        {
+            latch_hard_interlock(trip_zone_itlks[i].id,
+                                 trip_zone_itlks[i].itlk, 0.0,
+                                 SOE_Source_Trip_Zone, t_detect);
+        }
+    }
+
+    EALLOW;
+    for(i = 0; i < g_pwm_modules.num_modules; i++)
+    {
+        g_pwm_modules.pwm_regs[i]->TZCLR.bit.INT = 1;
+    }
+    EDIS;
+
+    PieCtrlRegs.PIEACK.all |= M_INT2;
+}
+
+/**
+ * Initialization of debounce parameters for a set of interlocks.
+ *
+ * @param p_counters pointer to set of debounce counters
+ * @param freq_timebase time-base frequecy [Hz]
+ * @param num_events number of interlocks specified by a ps_module
+ * @param p_debounce_time_us pointer to array of debounce time [us]
+ * @param p_reset_time_us pointer to array of reset time [us]
+ */
+static void init_debounce_counters(volatile debounce_counters_t *p_counters,
+                                   float freq_timebase, uint16_t num_events,
+                                   uint32_t *p_debounce_time_us,
+                                   uint32_t *p_reset_time_us)
+{
+    uint16_t i;
+    uint32_t debounce_time_us, reset_time_us, max_reset_counts;
+
+    max_reset_counts = (uint32_t) ((freq_timebase * MAX_RESET_TIME_US) * 1e-6);
+
+    p_counters->num_events = num_events;
+    p_counters->pending = 0;
+    p_counters->bypass = 0;
+    p_counters->next_reset = 0;
+
+    for(i = 0; i < NUM_MAX_EVENT_COUNTER; i++)
+    {
+        p_counters->start[i] = 0;
+
+        if(i < num_events)
+        {
+            debounce_time_us = *(p_debounce_time_us + i);
+            reset_time_us = *(p_reset_time_us + i);
+
+            /** Prevents bypassing a interlock by setting a very large debounce
+             * time
+             */
+            SATURATE(debounce_time_us, MAX_DEBOUNCE_TIME_US , 0);
+
+            p_counters->debounce_count[i] =
+                    (uint32_t) ( (freq_timebase * debounce_time_us) * 1e-6);
+            p_counters->reset_count[i] =
+                    (uint32_t) ( (freq_timebase * reset_time_us) * 1e-6);
+
+            /**
+             *  Prevents bypassing an interlock by setting a reset time smaller
+             *  than debounce time.
+             */
+            SATURATE(p_counters->reset_count[i], max_reset_counts,
+                     p_counters->debounce_count[i] + 1);
+        }
+        else
+        {
+            p_counters->debounce_count[i] = 0;
+            p_counters->reset_count[i] = 0;
+        }
+    }
+}
+
+/**
+ * Clear pending interlocks which reached their reset time. Nothing is done
+ * until the earliest pending interlock expires, when only pending bits are
+ * scanned to clear expired ones and find the next expiration. This runs with
+ * interrupts disabled, since pending mask is also modified by interlock checks
+ * inside ISRs.
+ *
+ * @param p_counters pointer to set of debounce counters
+ * @param timebase_counter current time-base counter
+ */
+static void run_debounce_counters(volatile debounce_counters_t *p_counters,
+                                  uint32_t timebase_counter)
+{
+    uint16_t i, int_status;
+    uint32_t pending, expired, remaining, next_remaining;
+
+    if( !p_counters->pending ||
+        ((int32_t) (timebase_counter - p_counters->next_reset) < 0) )
+    {
+        return;
+    }
+
+    int_status = __disable_interrupts();
+
+    pending = p_counters->pending;
+    expired = 0;
+    next_remaining = 0xFFFFFFFF;
+
+    for(i = 0; pending; i++, pending >>= 1)
+    {
+        if(pending & 1)
+        {
+            remaining = p_counters->start[i] + p_counters->reset_count[i] -
+                        timebase_counter;
+
+            if((int32_t) remaining <= 0)
+            {
+                expired |= ITLK_BIT(i);
+            }
+            else if(remaining < next_remaining)
+            {
+                next_remaining = remaining;
+            }
+        }
+    }
+
+    p_counters->pending &= ~expired;
+    p_counters->bypass &= ~expired;
+    p_counters->next_reset = timebase_counter + next_remaining;
+
+    __restore_interrupts(int_status);
+}
+
+/**
+ * Flag specified interlock as pending and check whether it has been pending
+ * for its debounce time, or if its debounce was bypassed. When debounced,
+ * interlock is no longer pending.
+ *
+ * @param p_counters pointer to set of debounce counters
+ * @param timebase_counter current time-base counter
+ * @param itlk specified interlock
+ * @return 1 if interlock is debounced, 0 otherwise
+ */
+static uint16_t debounce_event(volatile debounce_counters_t *p_counters,
+                               uint32_t timebase_counter, uint32_t itlk)
+{
+    uint16_t int_status;
+    uint32_t itlk_bit, reset;
+
+    itlk_bit = ITLK_BIT(itlk);
+
+    int_status = __disable_interrupts();
+
+    if(!(p_counters->pending & itlk_bit))
+    {
+        p_counters->start[itlk] = timebase_counter;
+        reset = timebase_counter + p_counters->reset_count[itlk];
+
+        if( !p_counters->pending ||
+            ((int32_t) (reset - p_counters->next_reset) < 0) )
+        {
+            p_counters->next_reset = reset;
+        }
+
+        p_counters->pending |= itlk_bit;
+    }
+
+    if( (p_counters->bypass & itlk_bit) ||
+        ((timebase_counter - p_counters->start[itlk]) >=
+          p_counters->debounce_count[itlk]) )
+    {
+        p_counters->pending &= ~itlk_bit;
+        p_counters->bypass &= ~itlk_bit;
+
+        __restore_interrupts(int_status);
+        return 1;
+    }
+
+    __restore_interrupts(int_status);
+    return 0;
+}
+
+/**
+ * Latch specified hard interlock for specified module, if not yet latched,
+ * turning it off and recording this event on SOE.
+ *
+ * @param id id of event manager specific of a power supply/module
+ * @param itlk specified hard interlock
+ * @param value signal value which triggered interlock, if available
+ * @param source source of interlock
+ * @param t_detect timestamp of interlock detection
+ */
+static void latch_hard_interlock(uint16_t id, uint32_t itlk, float value,
+                                 soe_source_t source, uint32_t t_detect)
+{
+    uint16_t first_fault;
+    uint32_t itlk_bit, t_turn_off, t_pwm_off;
+
+    itlk_bit = ITLK_BIT(itlk);
+
+    if(!(g_ipc_ctom.ps_module[id].ps_hard_interlock & itlk_bit))
+    {
+        first_fault = !(g_ipc_ctom.ps_module[id].ps_hard_interlock ||
+                        g_ipc_ctom.ps_module[id].ps_soft_interlock);
+
+        #ifdef USE_ITLK
+        t_turn_off = GET_TIMESTAMP;
+        g_ipc_ctom.ps_module[id].turn_off(id);
+        t_pwm_off = GET_TIMESTAMP;
+        g_ipc_ctom.ps_module[id].ps_status.bit.state = Interlock;
+        #endif
+
+        g_ipc_ctom.ps_module[id].ps_hard_interlock |= itlk_bit;
+
+        record_soe(id, itlk, SOE_Hard_Itlk_Set, source, first_fault, value);
+
+        trigger_postmortem(&g_postmortem, id);
+
+        #ifdef USE_ITLK
+        record_itlk_latency(source, t_detect, t_turn_off, t_pwm_off);
+        #endif
+    }
+}
+
+/**
+ * Latch specified soft interlock for specified module, if not yet latched,
+ * turning it off and recording this event on SOE.
+ *
+ * @param id id of event manager specific of a power supply/module
+ * @param itlk specified soft interlock
+ * @param value signal value which triggered interlock, if available
+ * @param source source of interlock
+ * @param t_detect timestamp of interlock detection
+ */
+static void latch_soft_interlock(uint16_t id, uint32_t itlk, float value,
+                                 soe_source_t source, uint32_t t_detect)
+{
+    uint16_t first_fault;
+    uint32_t itlk_bit, t_turn_off, t_pwm_off;
+
+    itlk_bit = ITLK_BIT(itlk);
+
+    if(!(g_ipc_ctom.ps_module[id].ps_soft_interlock & itlk_bit))
+    {
+        first_fault = !(g_ipc_ctom.ps_module[id].ps_hard_interlock ||
+                        g_ipc_ctom.ps_module[id].ps_soft_interlock);
+
+        #ifdef USE_ITLK
+        t_turn_off = GET_TIMESTAMP;
+        g_ipc_ctom.ps_module[id].turn_off(id);
+        t_pwm_off = GET_TIMESTAMP;
+        g_ipc_ctom.ps_module[id].ps_status.bit.state = Interlock;
+        #endif
+
+        g_ipc_ctom.ps_module[id].ps_soft_interlock |= itlk_bit;
+
+        record_soe(id, itlk, SOE_Soft_Itlk_Set, source, first_fault, value);
+
+        #ifdef USE_ITLK
+        record_itlk_latency(source, t_detect, t_turn_off, t_pwm_off);
+        #endif
+    }
+}
+
+/**
+ * Initialization of interlocks sequence-of-events recorder
+ */
+void init_soe(void)
+{
+    uint16_t i;
+
+    g_soe.head = 0;
+
+    for(i = 0; i < SOE_RING_SIZE; i++)
+    {
+        g_soe.entry[i].timestamp = 0;
+        g_soe.entry[i].seq = 0xFFFFFFFF;
+        g_soe.entry[i].id = 0;
+        g_soe.entry[i].itlk = 0;
+        g_soe.entry[i].event = SOE_Hard_Itlk_Set;
+        g_soe.entry[i].source = SOE_Source_C28;
+        g_soe.entry[i].first_fault = 0;
+        g_soe.entry[i].value = 0.0;
+    }
+
+    for(i = 0; i < NUM_MAX_PS_MODULES; i++)
+    {
+        g_soe.first_fault[i].timestamp = 0;
+        g_soe.first_fault[i].seq = 0xFFFFFFFF;
+        g_soe.first_fault[i].id = i;
+        g_soe.first_fault[i].itlk = 0;
+        g_soe.first_fault[i].event = SOE_Hard_Itlk_Set;
+        g_soe.first_fault[i].source = SOE_Source_C28;
+        g_soe.first_fault[i].first_fault = 0;
+        g_soe.first_fault[i].value = 0.0;
+    }
+}
+
+/**
+ * Record reset of interlocks from specified module on SOE. It must be called
+ * with the interlocks actually cleared by module reset procedure.
+ *
+ * @param id id of event manager specific of a power supply/module
+ * @param hard_itlks bitmask of hard interlocks which were reset
+ * @param soft_itlks bitmask of soft interlocks which were reset
+ */
+void record_soe_reset(uint16_t id, uint32_t hard_itlks, uint32_t soft_itlks)
+{
+    uint16_t itlk;
+
+    for(itlk = 0; hard_itlks; itlk++, hard_itlks >>= 1)
+    {
+        if(hard_itlks & 1)
+        {
+            record_soe(id, itlk, SOE_Hard_Itlk_Reset, SOE_Source_C28, 0, 0.0);
+        }
+    }
+
+    for(itlk = 0; soft_itlks; itlk++, soft_itlks >>= 1)
+    {
+        if(soft_itlks & 1)
+        {
+            record_soe(id, itlk, SOE_Soft_Itlk_Reset, SOE_Source_C28, 0, 0.0);
+        }
+    }
+}
+
+/**
+ * Record on SOE a fault which turned off specified module outside interlock
+ * tables, such as loss of feedback. It's first fault if module had no
+ * interlock latched.
+ *
+ * @param id id of event manager specific of a power supply/module
+ * @param fault fault bits defined by source
+ * @param source source of fault
+ * @param value signal value related to fault, if available
+ */
+void record_soe_fault(uint16_t id, uint16_t fault, soe_source_t source,
+                      float value)
+{
+    uint16_t first_fault;
+
+    first_fault = !(g_ipc_ctom.ps_module[id].ps_hard_interlock ||
+                    g_ipc_ctom.ps_module[id].ps_soft_interlock);
+
+    record_soe(id, fault, SOE_Fault, source, first_fault, value);
+}
+
+/**
+ * Append new entry to SOE ring. It runs with interrupts disabled, since
+ * interlocks are recorded from ISRs and background loop.
+ *
+ * @param id id of event manager specific of a power supply/module
+ * @param itlk specified interlock
+ * @param event type of event
+ * @param source source of event
+ * @param first_fault 1 if first interlock of this module since last reset
+ * @param value signal value which triggered interlock, if available
+ */
+static void record_soe(uint16_t id, uint32_t itlk, soe_event_t event,
+                       soe_source_t source, uint16_t first_fault, float value)
+{
+    uint16_t int_status;
+    uint32_t seq;
+    soe_entry_t *p_entry;
+
+    int_status = __disable_interrupts();
+
+    seq = g_soe.head;
+    p_entry = &g_soe.entry[seq & SOE_RING_MASK];
+
+    /// Invalidate entry while it's being overwritten
+    p_entry->seq = 0xFFFFFFFF;
+    p_entry->timestamp = get_timestamp64();
+    p_entry->id = id;
+    p_entry->itlk = itlk;
+    p_entry->event = event;
+    p_entry->source = source;
+    p_entry->first_fault = first_fault;
+    p_entry->value = value;
+    p_entry->seq = seq;
+
+    if(first_fault)
+    {
+        g_soe.first_fault[id] = *p_entry;
+    }
+
+    g_soe.head = seq + 1;
+
+    __restore_interrupts(int_status);
+}
+
+/**
+ * Clear interlock reaction latency statistics of all paths.
+ */
+void reset_itlk_latency(void)
+{
+    uint16_t i, j;
+
+    for(i = 0; i < NUM_ITLK_LATENCY_PATHS; i++)
+    {
+        g_itlk_latency[i].counter = 0;
+        g_itlk_latency[i].last_turn_off = 0;
+        g_itlk_latency[i].last = 0;
+        g_itlk_latency[i].max = 0;
+
+        for(j = 0; j < ITLK_LATENCY_HIST_SIZE; j++)
+        {
+            g_itlk_latency[i].hist[j] = 0;
+        }
+    }
+}
+
+/**
+ * Update interlock reaction latency statistics of specified path.
+ *
+ * @param source interlock path
+ * @param t_detect timestamp of interlock detection
+ * @param t_turn_off timestamp of turn_off() call
+ * @param t_pwm_off timestamp after turn_off() returned
+ */
+static void record_itlk_latency(soe_source_t source, uint32_t t_detect,
+                                uint32_t t_turn_off, uint32_t t_pwm_off)
+{
+    uint32_t latency, bin;
+
+    latency = t_pwm_off - t_detect;
+
+    g_itlk_latency[source].counter++;
+    g_itlk_latency[source].last_turn_off = t_turn_off - t_detect;
+    g_itlk_latency[source].last = latency;
+
+    if(latency > g_itlk_latency[source].max)
+    {
+        g_itlk_latency[source].max = latency;
+    }
+
+    bin = latency / ITLK_LATENCY_BIN_WIDTH;
+
+    if(bin >= ITLK_LATENCY_HIST_SIZE)
+    {
+        bin = ITLK_LATENCY_HIST_SIZE - 1;
+    }
+
+    g_itlk_latency[source].hist[bin]++;
+}
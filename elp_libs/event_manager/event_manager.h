@@ -58,34 +58,170 @@
 #define SET_INTERLOCKS_TIMEBASE_FLAG(id)    g_event_manager[id].timebase_flag = 1;
 
 /**
- * Calling this defines allows immediate set of hard/soft interlocks
+ * Bit mask of specified interlock on interlock registers
  */
-#define BYPASS_HARD_INTERLOCK_DEBOUNCE(id,itlk) g_event_manager[id].hard_interlocks.event[itlk].counter = g_event_manager[id].hard_interlocks.event[itlk].debounce_count;
-#define BYPASS_SOFT_INTERLOCK_DEBOUNCE(id,itlk) g_event_manager[id].soft_interlocks.event[itlk].counter = g_event_manager[id].soft_interlocks.event[itlk].debounce_count;
+#define ITLK_BIT(itlk)  (1UL << (itlk))
 
-typedef struct
-{
-    uint16_t flag;
-    uint32_t counter;
-    uint32_t debounce_count;
-    uint32_t reset_count;
-} debounce_counter_t;
+/**
+ * Calling this defines allows immediate set of hard/soft interlocks
+ */
+#define BYPASS_HARD_INTERLOCK_DEBOUNCE(id,itlk) g_event_manager[id].hard_interlocks.bypass |= ITLK_BIT(itlk);
+#define BYPASS_SOFT_INTERLOCK_DEBOUNCE(id,itlk) g_event_manager[id].soft_interlocks.bypass |= ITLK_BIT(itlk);
 
+/**
+ * Debouncing state of a set of interlocks, stored bit-parallel: bit i of each
+ * mask refers to interlock i. Instead of a counter per event, the time-base
+ * tick when an event was first flagged is kept in start[], so only pending
+ * events have meaningful state and nothing needs to be incremented per tick.
+ * next_reset holds the earliest tick when any pending event expires.
+ */
 typedef struct
 {
     uint16_t num_events;
-    debounce_counter_t event[NUM_MAX_EVENT_COUNTER];
+    uint32_t pending;
+    uint32_t bypass;
+    uint32_t next_reset;
+    uint32_t start[NUM_MAX_EVENT_COUNTER];
+    uint32_t debounce_count[NUM_MAX_EVENT_COUNTER];
+    uint32_t reset_count[NUM_MAX_EVENT_COUNTER];
 } debounce_counters_t;
 
 typedef struct
 {
     uint16_t timebase_flag;
+    uint32_t timebase_counter;
     float freq_timebase;
     debounce_counters_t hard_interlocks;
     debounce_counters_t soft_interlocks;
 } event_manager_t;
 
+/**
+ * Threshold interlock, declared as an entry of a module table. Interlock is
+ * flagged while signal is above max or below min (a NULL pointer disables
+ * that limit). Once flagged, it remains flagged until signal gets back into
+ * limits by more than hysteresis.
+ */
+typedef enum
+{
+    Threshold_Hard_Itlk,
+    Threshold_Soft_Itlk
+} threshold_itlk_type_t;
+
+typedef struct
+{
+    volatile float *p_signal;
+    volatile float *p_min;
+    volatile float *p_max;
+    float hysteresis;
+    uint16_t use_abs;
+    uint16_t itlk;
+    threshold_itlk_type_t type;
+} threshold_itlk_t;
+
+/**
+ * Table of threshold interlocks from a power supply/module, with up to 32
+ * entries. Bit i of violation indicates whether entry i is flagged.
+ */
+typedef struct
+{
+    uint16_t num_entries;
+    uint32_t violation;
+    threshold_itlk_t *p_entries;
+} threshold_itlks_t;
+
+/**
+ * Sequence-of-events (SOE) recorder of interlocks. Each interlock set or reset
+ * is appended to a ring on shared RAM, stamped with 64-bit timestamp. Ring is
+ * written only by C28: an entry is completely written before incrementing
+ * ```head```, which is free-running and equals the sequence number of next
+ * entry, so a reader may check ```seq``` of each entry to detect it was
+ * overwritten. First interlock of each module since the last reset is also
+ * kept apart, so it's preserved even if ring wraps.
+ */
+#define SOE_RING_SIZE       32      // must be a power of 2
+#define SOE_RING_MASK       (SOE_RING_SIZE - 1)
+
+typedef enum
+{
+    SOE_Hard_Itlk_Set,
+    SOE_Soft_Itlk_Set,
+    SOE_Hard_Itlk_Reset,
+    SOE_Soft_Itlk_Reset,
+    SOE_Fault                       // itlk holds fault bits of its source
+} soe_event_t;
+
+typedef enum
+{
+    SOE_Source_C28,
+    SOE_Source_C28_Threshold,       // value holds triggering signal
+    SOE_Source_ARM,
+    SOE_Source_Trip_Zone,
+    SOE_Source_HRADC                // value holds consecutive stale frames
+} soe_source_t;
+
+typedef volatile struct
+{
+    uint64_t        timestamp;
+    uint32_t        seq;
+    uint16_t        id;
+    uint16_t        itlk;
+    soe_event_t     event;
+    soe_source_t    source;
+    uint16_t        first_fault;
+    float           value;
+} soe_entry_t;
+
+typedef volatile struct
+{
+    uint32_t    head;
+    soe_entry_t entry[SOE_RING_SIZE];
+    soe_entry_t first_fault[NUM_MAX_PS_MODULES];
+} soe_t;
+
+/**
+ * Interlock reaction latency, measured on each interlock latch for each path
+ * (source), from detection to PWM outputs disabled by module turn_off().
+ * Detection is the entry of set_hard/soft_interlock() for C28 interlocks,
+ * the evaluation of threshold interlocks table or the entry of
+ * isr_hard/soft_interlock() for ARM interlocks. For trip-zone interlocks,
+ * outputs were already forced off by hardware, and detection is the entry of
+ * isr_trip_zone(). Latencies are in CPU cycles, and last histogram bin also
+ * counts all latencies beyond it.
+ */
+#define NUM_ITLK_LATENCY_PATHS      (SOE_Source_Trip_Zone + 1)
+#define ITLK_LATENCY_HIST_SIZE      16
+#define ITLK_LATENCY_BIN_WIDTH      64      // [cycles]
+
+typedef volatile struct
+{
+    uint32_t    counter;
+    uint32_t    last_turn_off;          // detection to turn_off() call
+    uint32_t    last;                   // detection to PWM disabled
+    uint32_t    max;
+    uint32_t    hist[ITLK_LATENCY_HIST_SIZE];
+} itlk_latency_t;
+
+/**
+ * Trip-zone fast path: a critical hard interlock signal, wired to a C28 GPIO,
+ * is mapped to a trip-zone input of the PWM modules of a power supply, so its
+ * outputs are forced off by hardware within a few system clocks. Software is
+ * notified by trip-zone interrupt, and just latches and records the
+ * interlock. Trip-zone inputs are active-low.
+ */
+#define NUM_MAX_TRIP_ZONE_ITLKS     2       // TZ2 and TZ3
+
+typedef struct
+{
+    uint16_t    enable;
+    uint16_t    id;
+    uint16_t    itlk;
+    uint16_t    gpio;
+    uint16_t    pwm_modules;                // bitmask of g_pwm_modules
+} trip_zone_itlk_t;
+
 extern volatile event_manager_t g_event_manager[NUM_MAX_PS_MODULES];
+extern volatile soe_t g_soe;
+extern volatile itlk_latency_t g_itlk_latency[NUM_ITLK_LATENCY_PATHS];
 
 extern void init_event_manager(uint16_t id, float freq_timebase,
                                uint16_t num_hard_itlks, uint16_t num_soft_itlks,
@@ -96,10 +232,27 @@ extern void init_event_manager(uint16_t id, float freq_timebase,
 
 extern void run_interlocks_debouncing(uint16_t id);
 
+extern void init_soe(void);
+extern void record_soe_reset(uint16_t id, uint32_t hard_itlks,
+                             uint32_t soft_itlks);
+extern void record_soe_fault(uint16_t id, uint16_t fault, soe_source_t source,
+                             float value);
+extern void reset_itlk_latency(void);
+
 extern void set_hard_interlock(uint16_t id, uint32_t itlk);
 extern void set_soft_interlock(uint16_t id, uint32_t itlk);
+extern void set_hard_interlocks(uint16_t id, uint32_t itlks);
+extern void set_soft_interlocks(uint16_t id, uint32_t itlks);
+extern void init_threshold_interlocks(threshold_itlks_t *p_table,
+                                      threshold_itlk_t *p_entries,
+                                      uint16_t num_entries);
+extern void run_threshold_interlocks(uint16_t id, threshold_itlks_t *p_table);
 extern interrupt void isr_hard_interlock(void);
 extern interrupt void isr_soft_interlock(void);
 extern interrupt void isr_interlocks_timebase(void);
 
+extern uint16_t cfg_trip_zone_interlock(uint16_t id, uint32_t itlk, uint16_t tz,
+                                        uint16_t gpio, uint16_t pwm_modules);
+extern interrupt void isr_trip_zone(void);
+
 #endif /* EVENT_MANAGER_H_ */
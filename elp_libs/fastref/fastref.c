@@ -0,0 +1,269 @@
+/******************************************************************************
+ * Copyright (C) 2026 by LNLS - Brazilian Synchrotron Light Laboratory
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. LNLS and
+ * the Brazilian Center for Research in Energy and Materials (CNPEM) are not
+ * liable for any misuse of this material.
+ *
+ *****************************************************************************/
+
+/**
+ * @file fastref.c
+ * @brief Fast references module
+ *
+ * This module implements FastRef operation mode, in which setpoints are
+ * streamed at high rates through a ring of timestamped samples on shared RAM.
+ *
+ * @author gabriel.brunheira
+ * @date 19/10/2026
+ *
+ */
+
+#include <float.h>
+#include <math.h>
+#include "fastref.h"
+
+#pragma DATA_SECTION(g_fastref_ring,"SHARERAMS0_0_FASTREF");
+volatile fastref_ring_t g_fastref_ring;
+
+#pragma DATA_SECTION(g_fastref,"SHARERAMS1_1_FASTREF");
+volatile fastref_t g_fastref;
+
+#pragma CODE_SECTION(run_fastref,"ramfuncs");
+
+/// Set by init_fastref(), on modules which run FastRef
+static uint16_t fastref_supported = 0;
+
+/// False for NaN as well
+#define IS_VALID_SETPOINT(x)    (fabs(x) <= FLT_MAX)
+
+/**
+ * Initialization of FastRef module. All outputs are set to zero.
+ *
+ * @param p_fastref pointer to FastRef status
+ * @param p_ring pointer to samples ring
+ * @param latency delay from sample timestamp until its application [ticks]
+ * @param interpolation interpolation between samples
+ */
+void init_fastref(fastref_t *p_fastref, fastref_ring_t *p_ring,
+                  uint16_t latency, fastref_interpolation_t interpolation)
+{
+    uint16_t i;
+
+    fastref_supported = 1;
+
+    p_fastref->tick = 0;
+
+    for(i = 0; i < NUM_MAX_PS_MODULES; i++)
+    {
+        p_fastref->sample_prev.setpoint[i] = 0.0;
+        p_fastref->out[i] = 0.0;
+    }
+
+    cfg_fastref(p_fastref, latency, interpolation);
+    reset_fastref(p_fastref, p_ring);
+}
+
+/**
+ * Configure latency and interpolation.
+ *
+ * @param p_fastref pointer to FastRef status
+ * @param latency delay from sample timestamp until its application [ticks]
+ * @param interpolation interpolation between samples
+ * @return 1 if arguments are invalid, 0 otherwise
+ */
+uint16_t cfg_fastref(fastref_t *p_fastref, uint16_t latency,
+                     fastref_interpolation_t interpolation)
+{
+    if(interpolation > FastRef_Linear)
+    {
+        return 1;
+    }
+
+    p_fastref->latency = latency;
+    p_fastref->interpolation = interpolation;
+
+    return 0;
+}
+
+/**
+ * Get default latency for a producer of given nominal rate: one producer
+ * period, rounded up, plus FASTREF_LATENCY_MARGIN.
+ *
+ * @param freq_tick frequency of calls to run_fastref() [Hz]
+ * @param freq_producer nominal frequency of producer samples [Hz]
+ * @return latency [ticks]
+ */
+uint16_t get_fastref_latency(float freq_tick, float freq_producer)
+{
+    float ratio;
+    uint16_t period;
+
+    if( !(freq_tick > 0.0) || !(freq_producer > 0.0) )
+    {
+        return FASTREF_LATENCY_MARGIN;
+    }
+
+    ratio = freq_tick / freq_producer;
+
+    if(!(ratio < (float) (0xFFFF - FASTREF_LATENCY_MARGIN)))
+    {
+        return 0xFFFF;
+    }
+
+    period = (uint16_t) ratio;
+
+    if((float) period < ratio)
+    {
+        period++;
+    }
+
+    return period + FASTREF_LATENCY_MARGIN;
+}
+
+/**
+ * Discard pending samples and clear counters. Outputs keep their last values,
+ * so the ring may be refilled without discontinuities.
+ *
+ * @param p_fastref pointer to FastRef status
+ * @param p_ring pointer to samples ring
+ */
+void reset_fastref(fastref_t *p_fastref, fastref_ring_t *p_ring)
+{
+    uint16_t i;
+
+    p_fastref->tail = p_ring->head;
+    p_fastref->underrun = 0;
+    p_fastref->period = 0;
+    p_fastref->counter_samples = 0;
+    p_fastref->counter_underrun = 0;
+    p_fastref->counter_late = 0;
+    p_fastref->counter_invalid = 0;
+
+    p_fastref->sample_prev.tick = p_fastref->tick - p_fastref->latency;
+
+    for(i = 0; i < NUM_MAX_PS_MODULES; i++)
+    {
+        p_fastref->sample_prev.setpoint[i] = p_fastref->out[i];
+    }
+}
+
+/**
+ * Run FastRef once per control tick. Every sample which is due (its timestamp
+ * plus latency has been reached) is consumed, and outputs are either held on
+ * last consumed sample or interpolated towards the next pending one. While no
+ * sample is pending, outputs are held, which is an underrun only once next
+ * sample is overdue.
+ *
+ * @param p_fastref pointer to FastRef status
+ * @param p_ring pointer to samples ring
+ */
+void run_fastref(fastref_t *p_fastref, fastref_ring_t *p_ring)
+{
+    uint16_t i, tail;
+    uint32_t tick_apply;
+    float fraction;
+    fastref_sample_t *p_next;
+
+    tick_apply = ++p_fastref->tick - p_fastref->latency;
+    tail = p_fastref->tail;
+
+    /// Consume due samples. Only a sample due exactly now is on time.
+    while( (tail != p_ring->head) &&
+           ((int32_t) (tick_apply - p_ring->sample[tail & FASTREF_RING_MASK].tick) >= 0) )
+    {
+        p_next = &p_ring->sample[tail & FASTREF_RING_MASK];
+
+        if(p_next->tick != tick_apply)
+        {
+            p_fastref->counter_late++;
+        }
+
+        /// First sample after reset has no previous one to measure period
+        if(p_fastref->counter_samples++)
+        {
+            p_fastref->period = p_next->tick - p_fastref->sample_prev.tick;
+        }
+
+        p_fastref->sample_prev.tick = p_next->tick;
+
+        /// Invalid setpoints are dropped, holding last valid one
+        for(i = 0; i < NUM_MAX_PS_MODULES; i++)
+        {
+            if(IS_VALID_SETPOINT(p_next->setpoint[i]))
+            {
+                p_fastref->sample_prev.setpoint[i] = p_next->setpoint[i];
+            }
+            else
+            {
+                p_fastref->counter_invalid++;
+            }
+        }
+
+        tail++;
+    }
+
+    p_fastref->tail = tail;
+
+    /// Next sample should be pending, since latency covers producer period
+    if(tail == p_ring->head)
+    {
+        if( p_fastref->period && !p_fastref->underrun &&
+            ((int32_t) (tick_apply - p_fastref->sample_prev.tick -
+                        p_fastref->period) >= 0) )
+        {
+            p_fastref->underrun = 1;
+            p_fastref->counter_underrun++;
+        }
+
+        for(i = 0; i < NUM_MAX_PS_MODULES; i++)
+        {
+            p_fastref->out[i] = p_fastref->sample_prev.setpoint[i];
+        }
+
+        return;
+    }
+
+    p_fastref->underrun = 0;
+
+    if(p_fastref->interpolation == FastRef_Linear)
+    {
+        p_next = &p_ring->sample[tail & FASTREF_RING_MASK];
+
+        fraction = ((float) (tick_apply - p_fastref->sample_prev.tick)) /
+                   ((float) (p_next->tick - p_fastref->sample_prev.tick));
+
+        for(i = 0; i < NUM_MAX_PS_MODULES; i++)
+        {
+            if(IS_VALID_SETPOINT(p_next->setpoint[i]))
+            {
+                p_fastref->out[i] = p_fastref->sample_prev.setpoint[i] +
+                                    fraction * (p_next->setpoint[i] -
+                                                p_fastref->sample_prev.setpoint[i]);
+            }
+            else
+            {
+                p_fastref->out[i] = p_fastref->sample_prev.setpoint[i];
+            }
+        }
+    }
+    else
+    {
+        for(i = 0; i < NUM_MAX_PS_MODULES; i++)
+        {
+            p_fastref->out[i] = p_fastref->sample_prev.setpoint[i];
+        }
+    }
+}
+
+/**
+ * Check whether FastRef is supported by running power supply module, i.e.,
+ * whether it has initialized this module.
+ *
+ * @return 1 if supported, 0 otherwise
+ */
+uint16_t is_fastref_supported(void)
+{
+    return fastref_supported;
+}
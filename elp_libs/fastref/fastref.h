@@ -0,0 +1,106 @@
+/******************************************************************************
+ * Copyright (C) 2026 by LNLS - Brazilian Synchrotron Light Laboratory
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. LNLS and
+ * the Brazilian Center for Research in Energy and Materials (CNPEM) are not
+ * liable for any misuse of this material.
+ *
+ *****************************************************************************/
+
+/**
+ * @file fastref.h
+ * @brief Fast references module
+ *
+ * This module implements FastRef operation mode, in which setpoints are
+ * streamed at high rates (e.g., from fast orbit feedback) through a ring of
+ * timestamped samples on shared RAM, instead of one IPC message per setpoint.
+ *
+ * The ring is written only by the producer (ARM or a future fast link) and
+ * its status only by C28. Timestamps are in control ticks: producer stamps
+ * each sample with current ```tick``` from fastref status, and C28 applies it
+ * ```latency``` ticks later, holding or linearly interpolating between
+ * samples. Interpolation needs the next sample to be pending, so latency must
+ * cover one producer period, plus a margin for its jitter (see
+ * get_fastref_latency()). Samples applied after their due tick are counted as
+ * late. Producer period is measured between consumed samples, and an underrun
+ * is counted when the next sample wasn't received by its expected due tick,
+ * i.e., one period after last one. Non-finite setpoints
+ * (NaN or infinite) are counted as invalid and don't change output of
+ * their power supply, which holds its last valid setpoint.
+ *
+ * FastRef mode is only accepted by power supply modules which initialize and
+ * run this module (see is_fastref_supported()).
+ *
+ * @author gabriel.brunheira
+ * @date 19/10/2026
+ *
+ */
+
+#ifndef FASTREF_H_
+#define FASTREF_H_
+
+#include <stdint.h>
+#include "ps_modules/ps_modules.h"
+
+#define FASTREF_RING_SIZE       32      // must be a power of 2
+#define FASTREF_RING_MASK       (FASTREF_RING_SIZE - 1)
+
+#define FASTREF_LATENCY_MARGIN  2       // Producer jitter [ticks]
+
+typedef enum
+{
+    FastRef_Hold,
+    FastRef_Linear
+} fastref_interpolation_t;
+
+typedef volatile struct
+{
+    uint32_t    tick;
+    float       setpoint[NUM_MAX_PS_MODULES];
+} fastref_sample_t;
+
+/**
+ * Samples ring, written by producer. Sample is filled before incrementing
+ * ```head```, which is free-running, and producer must not get more than
+ * FASTREF_RING_SIZE samples ahead of ```tail``` from fastref status.
+ */
+typedef volatile struct
+{
+    uint16_t            head;
+    fastref_sample_t    sample[FASTREF_RING_SIZE];
+} fastref_ring_t;
+
+/**
+ * FastRef status, written by C28
+ */
+typedef volatile struct
+{
+    uint32_t                tick;
+    uint16_t                tail;
+    uint16_t                latency;
+    fastref_interpolation_t interpolation;
+    uint16_t                underrun;
+    uint32_t                period;         // Producer period [ticks, 0: unknown]
+    uint32_t                counter_samples;
+    uint32_t                counter_underrun;
+    uint32_t                counter_late;
+    uint32_t                counter_invalid;
+    fastref_sample_t        sample_prev;
+    float                   out[NUM_MAX_PS_MODULES];
+} fastref_t;
+
+extern volatile fastref_ring_t g_fastref_ring;
+extern volatile fastref_t g_fastref;
+
+extern void init_fastref(fastref_t *p_fastref, fastref_ring_t *p_ring,
+                         uint16_t latency,
+                         fastref_interpolation_t interpolation);
+extern uint16_t cfg_fastref(fastref_t *p_fastref, uint16_t latency,
+                            fastref_interpolation_t interpolation);
+extern uint16_t get_fastref_latency(float freq_tick, float freq_producer);
+extern void reset_fastref(fastref_t *p_fastref, fastref_ring_t *p_ring);
+extern void run_fastref(fastref_t *p_fastref, fastref_ring_t *p_ring);
+extern uint16_t is_fastref_supported(void);
+
+#endif /* FASTREF_H_ */
@@ -22,20 +22,43 @@
 
 #include <stdint.h>
 #include "boards/udc_c28.h"
+#include "common/integrity.h"
 #include "common/structs.h"
 #include "common/timeslicer.h"
+#include "common/timestamp.h"
 #include "control/control.h"
+#include "event_manager/event_manager.h"
+#include "fastref/fastref.h"
+#include "HRADC_board/DMA_SPI_Interface.h"
+#include "HRADC_board/HRADC_Boards.h"
 #include "ipc/ipc.h"
+#include "postmortem/postmortem.h"
+#include "pwm/pwm.h"
+#include "sync/sync.h"
 
 #pragma DATA_SECTION(g_buf_samples_ctom,"SHARERAMS67")
 volatile float g_buf_samples_ctom[SIZE_BUF_SAMPLES_CTOM];
 
+/**
+ * Scopes buffers are allocated from g_buf_samples_ctom by this arena
+ */
+scope_arena_t g_scope_arena_ctom;
+
+#pragma DATA_SECTION(g_ipc_lowpriority_stats,"SHARERAMS1_1_IPC");
+volatile ipc_lowpriority_stats_t g_ipc_lowpriority_stats;
+
+#pragma DATA_SECTION(g_ipc_snapshot_ctom,"SHARERAMS1_1_IPC");
+volatile ipc_snapshot_t g_ipc_snapshot_ctom;
+
+static uint16_t counter_snapshot;
+
 #pragma DATA_SECTION(g_ipc_ctom,"CTOM_MSG_RAM");
 #pragma DATA_SECTION(g_ipc_mtoc,"MTOC_MSG_RAM");
 volatile ipc_ctom_t g_ipc_ctom;
 volatile ipc_mtoc_t g_ipc_mtoc;
 
 #pragma CODE_SECTION(isr_ipc_sync_pulse,"ramfuncs");
+#pragma CODE_SECTION(run_ipc_snapshot,"ramfuncs");
 
 /**
  * Interrupt service routine for handling Low Priority MtoC IPC messages
@@ -47,6 +70,143 @@ interrupt void isr_ipc_lowpriority_msg(void);
  */
 interrupt void isr_ipc_sync_pulse(void);
 
+static error_mtoc_t process_ipc_lowpriority_msg(ipc_queue_slot_t *p_msg);
+static uint16_t is_frame_complete(uint16_t tail, uint16_t head);
+static uint16_t is_fastref_active(void);
+
+typedef error_mtoc_t (*ipc_lowpriority_msg_handler_t)(uint16_t msg_id,
+                                                      ipc_queue_slot_t *p_msg);
+
+static error_mtoc_t ipc_msg_turn_on(uint16_t msg_id, ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_turn_off(uint16_t msg_id, ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_open_loop(uint16_t msg_id, ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_close_loop(uint16_t msg_id, ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_operating_mode(uint16_t msg_id,
+                                           ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_reset_interlocks(uint16_t msg_id,
+                                             ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_unlock_udc(uint16_t msg_id, ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_lock_udc(uint16_t msg_id, ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_cfg_source_scope(uint16_t msg_id,
+                                             ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_cfg_freq_scope(uint16_t msg_id,
+                                           ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_cfg_duration_scope(uint16_t msg_id,
+                                               ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_enable_scope(uint16_t msg_id,
+                                         ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_disable_scope(uint16_t msg_id,
+                                          ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_reset_scope(uint16_t msg_id,
+                                        ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_set_slowref(uint16_t msg_id,
+                                        ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_set_slowref_all_ps(uint16_t msg_id,
+                                               ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_cfg_wfmref(uint16_t msg_id, ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_update_wfmref(uint16_t msg_id,
+                                          ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_reset_wfmref(uint16_t msg_id,
+                                         ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_cfg_siggen(uint16_t msg_id, ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_set_siggen(uint16_t msg_id, ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_enable_siggen(uint16_t msg_id,
+                                          ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_disable_siggen(uint16_t msg_id,
+                                           ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_reset_counters(uint16_t msg_id,
+                                           ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_set_param(uint16_t msg_id, ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_set_dsp_coeffs(uint16_t msg_id,
+                                           ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_set_command_interface(uint16_t msg_id,
+                                                  ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_ctom_message_error(uint16_t msg_id,
+                                               ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_cfg_size_scope(uint16_t msg_id,
+                                           ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_cfg_compression_scope(uint16_t msg_id,
+                                                  ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_cfg_snapshot(uint16_t msg_id,
+                                         ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_cfg_fastref(uint16_t msg_id,
+                                        ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_cfg_sync(uint16_t msg_id, ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_cfg_sync_pll(uint16_t msg_id,
+                                         ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_cfg_postmortem(uint16_t msg_id,
+                                           ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_cfg_hradc_decimation(uint16_t msg_id,
+                                                 ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_cfg_hradc_offline_calib(uint16_t msg_id,
+                                                    ipc_queue_slot_t *p_msg);
+static error_mtoc_t ipc_msg_cfg_integrity(uint16_t msg_id,
+                                          ipc_queue_slot_t *p_msg);
+
+/**
+ * Handlers table, indexed by ipc_mtoc_lowpriority_msg_t. Null entries are
+ * not supported messages.
+ */
+static const ipc_lowpriority_msg_handler_t
+ipc_lowpriority_msg_handlers[NUM_IPC_MTOC_LOWPRIORITY_MSG] =
+{
+    0,                                  // 0
+    &ipc_msg_turn_on,                   // Turn_On
+    &ipc_msg_turn_off,                  // Turn_Off
+    &ipc_msg_open_loop,                 // Open_Loop
+    &ipc_msg_close_loop,                // Close_Loop
+    &ipc_msg_operating_mode,            // Operating_Mode
+    &ipc_msg_reset_interlocks,          // Reset_Interlocks
+    &ipc_msg_unlock_udc,                // Unlock_UDC
+    &ipc_msg_lock_udc,                  // Lock_UDC
+    &ipc_msg_cfg_source_scope,          // Cfg_Source_Scope
+    &ipc_msg_cfg_freq_scope,            // Cfg_Freq_Scope
+    &ipc_msg_cfg_duration_scope,        // Cfg_Duration_Scope
+    &ipc_msg_enable_scope,              // Enable_Scope
+    &ipc_msg_disable_scope,             // Disable_Scope
+    &ipc_msg_reset_scope,               // Reset_Scope
+    &ipc_msg_set_slowref,               // Set_SlowRef
+    &ipc_msg_set_slowref_all_ps,        // Set_SlowRef_All_PS
+    &ipc_msg_cfg_wfmref,                // Cfg_WfmRef
+    &ipc_msg_update_wfmref,             // Update_WfmRef
+    &ipc_msg_reset_wfmref,              // Reset_WfmRef
+    &ipc_msg_cfg_siggen,                // Cfg_SigGen
+    &ipc_msg_set_siggen,                // Set_SigGen
+    &ipc_msg_enable_siggen,             // Enable_SigGen
+    &ipc_msg_disable_siggen,            // Disable_SigGen
+    &ipc_msg_reset_counters,            // Reset_Counters
+    &ipc_msg_set_param,                 // Set_Param
+    &ipc_msg_set_dsp_coeffs,            // Set_DSP_Coeffs
+    0,                                  // Cfg_TimeSlicer
+    &ipc_msg_set_command_interface,     // Set_Command_Interface
+    &ipc_msg_ctom_message_error,        // CtoM_Message_Error
+    &ipc_msg_cfg_size_scope,            // Cfg_Size_Scope
+    &ipc_msg_cfg_compression_scope,     // Cfg_Compression_Scope
+    &ipc_msg_cfg_snapshot,              // Cfg_Snapshot
+    &ipc_msg_cfg_fastref,               // Cfg_FastRef
+    &ipc_msg_cfg_sync,                  // Cfg_Sync
+    &ipc_msg_cfg_sync_pll,              // Cfg_Sync_PLL
+    &ipc_msg_cfg_postmortem,            // Cfg_PostMortem
+    &ipc_msg_cfg_hradc_decimation,      // Cfg_HRADC_Decimation
+    &ipc_msg_cfg_hradc_offline_calib,   // Cfg_HRADC_Offline_Calib
+    &ipc_msg_cfg_integrity              // Cfg_Integrity
+};
+
+/**
+ * Number of DSP modules of each class, indexed by dsp_class_t
+ */
+static const uint16_t num_max_dsp_modules[DSP_Vect_Product + 1] =
+{
+    NUM_MAX_DSP_ERROR,
+    NUM_MAX_DSP_SRLIM,
+    NUM_MAX_DSP_LPF,
+    NUM_MAX_DSP_PI,
+    NUM_MAX_DSP_IIR_2P2Z,
+    NUM_MAX_DSP_IIR_3P3Z,
+    NUM_MAX_DSP_VDCLINK_FF,
+    NUM_MAX_DSP_VECT_PRODUCT
+};
+
 /**
  * Initialization of interprocessor communication (IPC)
  *
@@ -67,6 +227,28 @@ void init_ipc(void)
     g_ipc_ctom.counter_set_slowref =  0;
     g_ipc_ctom.counter_sync_pulse =  0;
 
+    /// Queues indexes are synchronized to the other side, which may not be
+    /// reinitialized along with C28
+    g_ipc_ctom.queue_ctom.head = g_ipc_mtoc.tail_queue_ctom;
+    g_ipc_ctom.queue_ctom.num_dropped = 0;
+    g_ipc_ctom.tail_queue_mtoc = g_ipc_mtoc.queue_mtoc.head;
+
+    for(i = 0; i < NUM_IPC_MTOC_LOWPRIORITY_MSG; i++)
+    {
+        g_ipc_lowpriority_stats.counter[i] = 0;
+        g_ipc_lowpriority_stats.max_cycles[i] = 0;
+    }
+
+    g_ipc_lowpriority_stats.counter_invalid = 0;
+    g_ipc_lowpriority_stats.isr_last_cycles = 0;
+    g_ipc_lowpriority_stats.isr_max_cycles = 0;
+
+    g_ipc_snapshot_ctom.seq = 0;
+    cfg_ipc_snapshot(IPC_SNAPSHOT_DECIMATION);
+
+    init_sync(&g_sync, 0.0, 0.0);
+    init_sync_pll(&g_sync_pll);
+
     EALLOW;
 
     /**
@@ -149,15 +331,16 @@ void init_ipc(void)
 
 /**
  * Send IPC CtoM message. This function must be used with care, because it
- * directly sets CTOMIPC register bits according to the argument 'msg' when
- * there's no pending messages.
+ * directly sets CTOMIPC register bits according to the argument 'msg'. Only
+ * the requested bits are checked, so a pending message on other IPC flags
+ * (like the low priority doorbell) doesn't block it.
  *
  * @param msg_id specified IPC module
  * @param msg specified message
  */
 void send_ipc_msg(uint16_t msg_id, uint32_t msg)
 {
-    if(CtoMIpcRegs.CTOMIPCFLG.all == 0x00000000)
+    if( (CtoMIpcRegs.CTOMIPCFLG.all & msg) == 0x00000000 )
     {
         g_ipc_ctom.msg_id = msg_id;
         CtoMIpcRegs.CTOMIPCSET.all = msg;
@@ -165,341 +348,695 @@ void send_ipc_msg(uint16_t msg_id, uint32_t msg)
 }
 
 /**
- * Send IPC CtoM Low Priority message. It ignores attempts to set high priority
- * bits or to subscribe pending low priority messages.
+ * Send IPC CtoM Low Priority message. Message is pushed into CtoM queue and
+ * IPC1 flag is set as doorbell, if not pending yet. In case of
+ * MtoC_Message_Error, current error code is sent as payload. If queue is full,
+ * message is dropped and counted.
  *
  * @param msg_id specified IPC module
  * @param msg specified message
  */
 void send_ipc_lowpriority_msg(uint16_t msg_id, ipc_ctom_lowpriority_msg_t msg)
 {
-    if(CtoMIpcRegs.CTOMIPCFLG.all == 0x00000000)
+    uint16_t i, int_status;
+    ipc_queue_slot_t *p_slot;
+
+    /// Interrupts are disabled since messages may be sent from any context
+    int_status = __disable_interrupts();
+
+    if( (uint16_t) (g_ipc_ctom.queue_ctom.head - g_ipc_mtoc.tail_queue_ctom) >=
+        IPC_QUEUE_SIZE )
     {
-        g_ipc_ctom.msg_id = msg_id;
-        CtoMIpcRegs.CTOMIPCSET.all = (uint32_t) ( ( (uint16_t) msg << 4 ) &
-                                     0x000FFFF0 | IPC_CTOM_LOWPRIORITY_MSG);
+        g_ipc_ctom.queue_ctom.num_dropped++;
     }
+    else
+    {
+        p_slot = &g_ipc_ctom.queue_ctom.slot[g_ipc_ctom.queue_ctom.head &
+                                             IPC_QUEUE_MASK];
+
+        p_slot->msg = msg;
+        p_slot->msg_id = msg_id;
+        p_slot->flags = 0;
+
+        for(i = 0; i < IPC_QUEUE_PAYLOAD_SIZE; i++)
+        {
+            p_slot->payload[i].u32 = 0;
+        }
+
+        if(msg == MtoC_Message_Error)
+        {
+            p_slot->payload[0].u32 = g_ipc_ctom.error_mtoc;
+        }
+
+        /// Slot must be complete before it's published by head update
+        g_ipc_ctom.queue_ctom.head++;
+
+        if( !(CtoMIpcRegs.CTOMIPCFLG.all & IPC_CTOM_LOWPRIORITY_MSG) )
+        {
+            CtoMIpcRegs.CTOMIPCSET.all = IPC_CTOM_LOWPRIORITY_MSG;
+        }
+    }
+
+    __restore_interrupts(int_status);
 }
 
 /**
- * Interrupt Service Routine for IPC MtoC Low Priority Messages.
+ * Interrupt Service Routine for IPC MtoC Low Priority Messages. IPC1 flag is
+ * just a doorbell: it's acknowledged before draining the MtoC queue, so any
+ * message pushed meanwhile rings it again and is not lost.
+ *
+ * Messages are processed in order, and status of each one is written to
+ * ```status_queue_mtoc``` before its slot is released. A batch frame (slots
+ * flagged with IPC_MSG_FLAG_BATCH, terminated by an unflagged slot) is only
+ * started when it's completely published, so all its operations run within
+ * this same interrupt, between two control ISRs. If an operation of a batch
+ * fails, the remaining ones are skipped with Batch_Aborted status. A frame
+ * which fills the whole queue without a terminator can never complete, so
+ * it's malformed (e.g., ARM was reset in the middle of it): all its slots are
+ * released with Batch_Aborted status, so the queue doesn't stall.
+ *
+ * ARM head index is not trusted: if it's further than IPC_QUEUE_SIZE slots
+ * from tail, queue is corrupt and its contents are discarded by synchronizing
+ * tail to head, instead of processing stale slots.
+ *
+ * Errors are reported only through message status and ```error_mtoc```, so
+ * no CtoM message is sent from this ISR. Processing time, from ISR entry to
+ * acknowledge, is measured and its worst case is kept.
  */
 interrupt void isr_ipc_lowpriority_msg(void)
 {
-    static uint16_t i, msg_id;
+    static uint16_t tail, head, in_frame, aborted;
+    static uint32_t timestamp;
+    static error_mtoc_t status;
+    static ipc_queue_slot_t *p_slot;
+
+    timestamp = GET_TIMESTAMP;
 
     g_ipc_ctom.msg_mtoc = CtoMIpcRegs.MTOCIPCSTS.all;
-    CtoMIpcRegs.MTOCIPCACK.all = g_ipc_ctom.msg_mtoc;
+    CtoMIpcRegs.MTOCIPCACK.all = IPC_MTOC_LOWPRIORITY_MSG;
 
-    msg_id = g_ipc_mtoc.msg_id;
+    tail = g_ipc_ctom.tail_queue_mtoc;
+    head = g_ipc_mtoc.queue_mtoc.head;
+    in_frame = 0;
+    aborted = 0;
 
-    if(g_ipc_ctom.ps_module[msg_id].ps_status.bit.active)
+    if( (uint16_t) (head - tail) > IPC_QUEUE_SIZE )
     {
-        switch(GET_IPC_MTOC_LOWPRIORITY_MSG)
+        g_ipc_lowpriority_stats.counter_invalid++;
+        g_ipc_ctom.error_mtoc = Invalid_Message;
+        g_ipc_ctom.tail_queue_mtoc = head;
+        tail = head;
+    }
+
+    while(tail != head)
+    {
+        p_slot = &g_ipc_mtoc.queue_mtoc.slot[tail & IPC_QUEUE_MASK];
+
+        if(!in_frame && (p_slot->flags & IPC_MSG_FLAG_BATCH))
         {
-            case Turn_On:
+            if(!is_frame_complete(tail, head))
             {
-                /**
-                 * TODO: where should disable siggen + reset wfmref be?
-                 */
-                g_ipc_ctom.ps_module[msg_id].turn_on(msg_id);
-                break;
-            }
+                if( (uint16_t) (head - tail) < IPC_QUEUE_SIZE )
+                {
+                    break;
+                }
 
-            case Turn_Off:
-            {
-                /**
-                 * TODO: where should disable siggen + reset wfmref be?
-                 */
-                g_ipc_ctom.ps_module[msg_id].turn_off(msg_id);
-                break;
+                aborted = 1;
+                g_ipc_ctom.error_mtoc = Batch_Aborted;
             }
 
-            case Open_Loop:
-            {
-                open_loop(&g_ipc_ctom.ps_module[msg_id]);
-                break;
-            }
+            in_frame = 1;
+        }
+
+        if(aborted)
+        {
+            status = Batch_Aborted;
+        }
+        else
+        {
+            status = process_ipc_lowpriority_msg(p_slot);
 
-            case Close_Loop:
+            if(status != No_Error_MtoC)
             {
-                close_loop(&g_ipc_ctom.ps_module[msg_id]);
-                break;
+                aborted = in_frame;
+                g_ipc_ctom.error_mtoc = status;
             }
+        }
 
-            case Operating_Mode:
-            {
-                /**
-                 * Check whether power supply is on and in case of WfmRef, check
-                 * whether it's at the end of the waveform to avoid
-                 * discontinuities
-                 */
-                if( (g_ipc_ctom.ps_module[msg_id].ps_status.bit.state >= SlowRef) &&
-                    (WFMREF_CTOM[msg_id].wfmref_data[WFMREF_CTOM[msg_id].wfmref_selected].p_buf_idx >=
-                     WFMREF_CTOM[msg_id].wfmref_data[WFMREF_CTOM[msg_id].wfmref_selected].p_buf_end) )
-                {
-                    switch(g_ipc_mtoc.ps_module[msg_id].ps_status.bit.state)
-                    {
-                        case SlowRef:
-                        case SlowRefSync:
-                        {
-                            g_ipc_ctom.ps_module[msg_id].ps_setpoint =
-                                      g_ipc_ctom.ps_module[msg_id].ps_reference;
-                        }
-
-                        case Cycle:
-                        {
-                            disable_siggen(&SIGGEN_CTOM[msg_id]);
-                        }
-
-                        case RmpWfm:
-                        case MigWfm:
-                        {
-                            if( g_ipc_ctom.ps_module[msg_id].ps_status.bit.state != RmpWfm  &&
-                                g_ipc_ctom.ps_module[msg_id].ps_status.bit.state != MigWfm )
-                            {
-                                update_wfmref(&WFMREF_CTOM[msg_id],&WFMREF_MTOC[msg_id]);
-                                reset_wfmref(&WFMREF_CTOM[msg_id]);
-                            }
-                            break;
-                        }
-
-                        default:
-                        {
-                            break;
-                        }
-                    }
-
-                    cfg_ps_operation_mode(&g_ipc_ctom.ps_module[msg_id],
-                                          g_ipc_mtoc.ps_module[msg_id].ps_status.bit.state);
-                }
+        if(!(p_slot->flags & IPC_MSG_FLAG_BATCH))
+        {
+            in_frame = 0;
+            aborted = 0;
+        }
 
-                break;
-            }
+        g_ipc_ctom.status_queue_mtoc[tail & IPC_QUEUE_MASK] = status;
+        g_ipc_ctom.tail_queue_mtoc = ++tail;
+    }
 
-            case Reset_Interlocks:
-            {
-                g_ipc_ctom.ps_module[msg_id].reset_interlocks(msg_id);
-                break;
-            }
+    timestamp = GET_TIMESTAMP - timestamp;
+    g_ipc_lowpriority_stats.isr_last_cycles = timestamp;
 
-            case Unlock_UDC:
-            {
-                unlock_ps_module(&g_ipc_ctom.ps_module[msg_id]);
-                break;
-            }
+    if(timestamp > g_ipc_lowpriority_stats.isr_max_cycles)
+    {
+        g_ipc_lowpriority_stats.isr_max_cycles = timestamp;
+    }
 
-            case Lock_UDC:
-            {
-                lock_ps_module(&g_ipc_ctom.ps_module[msg_id]);
-                break;
-            }
+    PieCtrlRegs.PIEACK.all |= M_INT11;
+}
 
-            case Cfg_Source_Scope:
-            {
-                cfg_source_scope(&SCOPE_CTOM[msg_id],
-                                 SCOPE_MTOC[msg_id].p_source);
-                break;
-            }
+/**
+ * Check whether the batch frame starting at ```tail``` is completely
+ * published on MtoC queue, i.e., whether its last slot is before head.
+ *
+ * @param tail index of first slot of frame
+ * @param head index of MtoC queue head
+ * @return 1 if frame is complete, 0 otherwise
+ */
+static uint16_t is_frame_complete(uint16_t tail, uint16_t head)
+{
+    while(tail != head)
+    {
+        if(!(g_ipc_mtoc.queue_mtoc.slot[tail & IPC_QUEUE_MASK].flags &
+             IPC_MSG_FLAG_BATCH))
+        {
+            return 1;
+        }
 
-            case Cfg_Freq_Scope:
-            {
-                cfg_freq_scope(&SCOPE_CTOM[msg_id],
-                               SCOPE_MTOC[msg_id].timeslicer.freq_sampling);
-                break;
-            }
+        tail++;
+    }
 
-            case Cfg_Duration_Scope:
-            {
-                cfg_duration_scope(&SCOPE_CTOM[msg_id],
-                                   SCOPE_MTOC[msg_id].duration);
-                break;
-            }
+    return 0;
+}
 
+/**
+ * Dispatch low priority message from MtoC queue to its handler. Messages to
+ * inactive power supply modules are ignored.
+ *
+ * @param p_msg pointer to message slot
+ * @return status of operation
+ */
+static error_mtoc_t process_ipc_lowpriority_msg(ipc_queue_slot_t *p_msg)
+{
+    uint16_t msg;
+    uint32_t timestamp;
+    error_mtoc_t status;
 
-            case Enable_Scope:
-            {
-                enable_scope(&SCOPE_CTOM[msg_id]);
-                //enable_buffer(&g_ipc_ctom.buf_samples[msg_id]);
-                /*enable_buffer(&g_ipc_ctom.buf_samples[0]);
-                enable_buffer(&g_ipc_ctom.buf_samples[1]);
-                enable_buffer(&g_ipc_ctom.buf_samples[2]);
-                enable_buffer(&g_ipc_ctom.buf_samples[3]);*/
-                break;
-            }
+    msg = p_msg->msg;
 
-            case Disable_Scope:
-            {
-                /**
-                 * TODO: It sets as Postmortem to wait buffer complete. Maybe
-                 * it's better to create a postmortem BSMP function
-                 */
-                disable_scope(&SCOPE_CTOM[msg_id]);
-                //postmortem_buffer(&g_ipc_ctom.buf_samples[msg_id]);
-                /*postmortem_buffer(&g_ipc_ctom.buf_samples[0]);
-                postmortem_buffer(&g_ipc_ctom.buf_samples[1]);
-                postmortem_buffer(&g_ipc_ctom.buf_samples[2]);
-                postmortem_buffer(&g_ipc_ctom.buf_samples[3]);*/
-                //disable_buffer(&g_ipc_ctom.buf_samples[msg_id]);
-                break;
-            }
+    if( (msg >= NUM_IPC_MTOC_LOWPRIORITY_MSG) ||
+        (ipc_lowpriority_msg_handlers[msg] == 0) )
+    {
+        g_ipc_lowpriority_stats.counter_invalid++;
+        return Invalid_Message;
+    }
 
-            case Reset_Scope:
-            {
-                reset_scope(&SCOPE_CTOM[msg_id]);
-                break;
-            }
+    if(p_msg->msg_id >= NUM_MAX_PS_MODULES)
+    {
+        g_ipc_lowpriority_stats.counter_invalid++;
+        return Invalid_Argument;
+    }
 
-            case Set_SlowRef:
-            {
-                SET_DEBUG_GPIO1;
+    if(!g_ipc_ctom.ps_module[p_msg->msg_id].ps_status.bit.active)
+    {
+        return No_Error_MtoC;
+    }
 
-                if(g_ipc_ctom.ps_module[msg_id].ps_status.bit.state == SlowRef)
-                {
-                    g_ipc_ctom.ps_module[msg_id].ps_setpoint =
-                    g_ipc_mtoc.ps_module[msg_id].ps_setpoint;
-                }
+    timestamp = GET_TIMESTAMP;
 
-                else if(g_ipc_ctom.ps_module[msg_id].ps_status.bit.state != SlowRefSync)
-                {
-                    g_ipc_ctom.error_mtoc = Invalid_OpMode;
-                    send_ipc_lowpriority_msg(msg_id, MtoC_Message_Error);
-                }
+    status = ipc_lowpriority_msg_handlers[msg](p_msg->msg_id, p_msg);
 
-                g_ipc_ctom.counter_set_slowref++;
+    timestamp = GET_TIMESTAMP - timestamp;
 
-                break;
-            }
+    g_ipc_lowpriority_stats.counter[msg]++;
 
-            case Set_SlowRef_All_PS:
-            {
-                SET_DEBUG_GPIO1;
+    if(timestamp > g_ipc_lowpriority_stats.max_cycles[msg])
+    {
+        g_ipc_lowpriority_stats.max_cycles[msg] = timestamp;
+    }
 
-                for(i = 0; i < NUM_MAX_PS_MODULES; i++)
-                {
-                    if(g_ipc_ctom.ps_module[i].ps_status.bit.active)
-                    {
-                        if(g_ipc_ctom.ps_module[i].ps_status.bit.state == SlowRef)
-                        {
-                            g_ipc_ctom.ps_module[i].ps_setpoint =
-                            g_ipc_mtoc.ps_module[i].ps_setpoint;
-                        }
-                        else if(g_ipc_ctom.ps_module[i].ps_status.bit.state != SlowRefSync)
-                        {
-                            g_ipc_ctom.error_mtoc = Invalid_OpMode;
-                            send_ipc_lowpriority_msg(msg_id, MtoC_Message_Error);
-                        }
-                    }
-                }
+    return status;
+}
 
-                g_ipc_ctom.counter_set_slowref++;
+/**
+ * Low priority messages handlers. Each one validates its own arguments
+ * before taking any action.
+ */
+static error_mtoc_t ipc_msg_turn_on(uint16_t msg_id, ipc_queue_slot_t *p_msg)
+{
+    /**
+     * TODO: where should disable siggen + reset wfmref be?
+     */
 
-                break;
-            }
+    /// HRADC references are being measured instead of feedback signals
+    if(Is_HRADC_Offline_Calibration_Busy())
+    {
+        return Invalid_OpMode;
+    }
 
-            case Cfg_WfmRef:
-            {
-                cfg_wfmref(&WFMREF_CTOM[msg_id],&WFMREF_MTOC[msg_id]);
-                break;
-            }
+    /// HRADC feedback was lost, or a board it uses failed bring-up
+    if(Is_HRADC_Fault(msg_id))
+    {
+        return Invalid_OpMode;
+    }
 
-            case Update_WfmRef:
-            {
-                update_wfmref(&WFMREF_CTOM[msg_id],&WFMREF_MTOC[msg_id]);
-                break;
-            }
+    g_ipc_ctom.ps_module[msg_id].turn_on(msg_id);
+    return No_Error_MtoC;
+}
 
-            case Reset_WfmRef:
-            {
-                reset_wfmref(&WFMREF_CTOM[msg_id]);
-                break;
-            }
+static error_mtoc_t ipc_msg_turn_off(uint16_t msg_id, ipc_queue_slot_t *p_msg)
+{
+    /**
+     * TODO: where should disable siggen + reset wfmref be?
+     */
+    g_ipc_ctom.ps_module[msg_id].turn_off(msg_id);
+    return No_Error_MtoC;
+}
 
-            case Cfg_SigGen:
-            {
-                cfg_siggen(&SIGGEN_CTOM[msg_id],
-                           SIGGEN_MTOC[msg_id].type,
-                           SIGGEN_MTOC[msg_id].num_cycles,
-                           SIGGEN_MTOC[msg_id].freq,
-                           SIGGEN_MTOC[msg_id].amplitude,
-                           SIGGEN_MTOC[msg_id].offset,
-                           SIGGEN_MTOC[msg_id].aux_param);
-                break;
-            }
+static error_mtoc_t ipc_msg_open_loop(uint16_t msg_id, ipc_queue_slot_t *p_msg)
+{
+    open_loop(&g_ipc_ctom.ps_module[msg_id]);
+    return No_Error_MtoC;
+}
 
-            case Set_SigGen:
-            {
-                set_siggen_freq(&SIGGEN_CTOM[msg_id], SIGGEN_MTOC[msg_id].freq);
-                break;
-            }
+static error_mtoc_t ipc_msg_close_loop(uint16_t msg_id, ipc_queue_slot_t *p_msg)
+{
+    close_loop(&g_ipc_ctom.ps_module[msg_id]);
+    return No_Error_MtoC;
+}
 
-            case Enable_SigGen:
-            {
-                enable_siggen(&SIGGEN_CTOM[msg_id]);
-                break;
-            }
+static error_mtoc_t ipc_msg_operating_mode(uint16_t msg_id,
+                                           ipc_queue_slot_t *p_msg)
+{
+    ps_state_t op_mode;
 
-            case Disable_SigGen:
-            {
-                disable_siggen(&SIGGEN_CTOM[msg_id]);
-                break;
-            }
+    if( (p_msg->payload[0].u32 < SlowRef) || (p_msg->payload[0].u32 > FastRef) )
+    {
+        return Invalid_Argument;
+    }
 
-            case Reset_Counters:
-            {
-                g_ipc_ctom.counter_set_slowref =  0;
-                g_ipc_ctom.counter_sync_pulse =  0;
-                break;
-            }
+    op_mode = (ps_state_t) p_msg->payload[0].u32;
 
-            case Set_Param:
-            {
-                break;
-            }
+    if( (op_mode == FastRef) && !is_fastref_supported() )
+    {
+        return Invalid_OpMode;
+    }
 
-            case Set_DSP_Coeffs:
-            {
-                set_dsp_coeffs(g_ipc_mtoc.dsp_module.dsp_class,
-                               g_ipc_mtoc.dsp_module.id);
-                break;
-            }
+    /**
+     * Check whether power supply is on and in case of WfmRef, check
+     * whether it's at the end of the waveform to avoid
+     * discontinuities
+     */
+    if( (g_ipc_ctom.ps_module[msg_id].ps_status.bit.state >= SlowRef) &&
+        (WFMREF_CTOM[msg_id].wfmref_data[WFMREF_CTOM[msg_id].wfmref_selected].p_buf_idx >=
+         WFMREF_CTOM[msg_id].wfmref_data[WFMREF_CTOM[msg_id].wfmref_selected].p_buf_end) )
+    {
+        if( (op_mode == SlowRef) || (op_mode == SlowRefSync) )
+        {
+            g_ipc_ctom.ps_module[msg_id].ps_setpoint =
+                      g_ipc_ctom.ps_module[msg_id].ps_reference;
+        }
+
+        if( (op_mode == SlowRef) || (op_mode == SlowRefSync) ||
+            (op_mode == Cycle) )
+        {
+            disable_siggen(&SIGGEN_CTOM[msg_id]);
+        }
+
+        if( (op_mode >= SlowRef) && (op_mode <= MigWfm) &&
+            (g_ipc_ctom.ps_module[msg_id].ps_status.bit.state != RmpWfm) &&
+            (g_ipc_ctom.ps_module[msg_id].ps_status.bit.state != MigWfm) )
+        {
+            update_wfmref(&WFMREF_CTOM[msg_id],&WFMREF_MTOC[msg_id]);
+            reset_wfmref(&WFMREF_CTOM[msg_id]);
+        }
+
+        /**
+         * Streamed setpoints start from current reference. Pending samples
+         * are discarded only if no other module is already on FastRef.
+         */
+        if( (op_mode == FastRef) &&
+            (g_ipc_ctom.ps_module[msg_id].ps_status.bit.state != FastRef) )
+        {
+            g_fastref.out[msg_id] = g_ipc_ctom.ps_module[msg_id].ps_reference;
+            g_fastref.sample_prev.setpoint[msg_id] = g_fastref.out[msg_id];
 
-            case Set_Command_Interface:
+            if(!is_fastref_active())
             {
-                g_ipc_ctom.ps_module[msg_id].ps_status.bit.interface =
-                        g_ipc_mtoc.ps_module[msg_id].ps_status.bit.interface;
-                break;
+                reset_fastref(&g_fastref, &g_fastref_ring);
             }
+        }
+
+        cfg_ps_operation_mode(&g_ipc_ctom.ps_module[msg_id], op_mode);
+    }
+
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_reset_interlocks(uint16_t msg_id,
+                                             ipc_queue_slot_t *p_msg)
+{
+    uint32_t hard_itlks, soft_itlks;
+
+    hard_itlks = g_ipc_ctom.ps_module[msg_id].ps_hard_interlock;
+    soft_itlks = g_ipc_ctom.ps_module[msg_id].ps_soft_interlock;
+
+    g_ipc_ctom.ps_module[msg_id].reset_interlocks(msg_id);
+    Reset_HRADC_Fault();
+
+    record_soe_reset(msg_id,
+                     hard_itlks & ~g_ipc_ctom.ps_module[msg_id].ps_hard_interlock,
+                     soft_itlks & ~g_ipc_ctom.ps_module[msg_id].ps_soft_interlock);
+
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_unlock_udc(uint16_t msg_id, ipc_queue_slot_t *p_msg)
+{
+    unlock_ps_module(&g_ipc_ctom.ps_module[msg_id]);
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_lock_udc(uint16_t msg_id, ipc_queue_slot_t *p_msg)
+{
+    lock_ps_module(&g_ipc_ctom.ps_module[msg_id]);
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_cfg_source_scope(uint16_t msg_id,
+                                             ipc_queue_slot_t *p_msg)
+{
+    if(p_msg->payload[0].u32 == 0)
+    {
+        return Invalid_Argument;
+    }
+
+    cfg_source_scope(&SCOPE_CTOM[msg_id], (float *) p_msg->payload[0].u32);
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_cfg_freq_scope(uint16_t msg_id,
+                                           ipc_queue_slot_t *p_msg)
+{
+    if( !(p_msg->payload[0].f > 0.0) ||
+        (p_msg->payload[0].f > SCOPE_CTOM[msg_id].timeslicer.freq_base) )
+    {
+        return Invalid_Argument;
+    }
+
+    cfg_freq_scope(&SCOPE_CTOM[msg_id], p_msg->payload[0].f);
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_cfg_duration_scope(uint16_t msg_id,
+                                               ipc_queue_slot_t *p_msg)
+{
+    if( !(p_msg->payload[0].f > 0.0) || (SCOPE_CTOM[msg_id].size == 0) )
+    {
+        return Invalid_Argument;
+    }
+
+    cfg_duration_scope(&SCOPE_CTOM[msg_id], p_msg->payload[0].f);
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_enable_scope(uint16_t msg_id,
+                                         ipc_queue_slot_t *p_msg)
+{
+    enable_scope(&SCOPE_CTOM[msg_id]);
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_disable_scope(uint16_t msg_id,
+                                          ipc_queue_slot_t *p_msg)
+{
+    /**
+     * TODO: It sets as Postmortem to wait buffer complete. Maybe
+     * it's better to create a postmortem BSMP function
+     */
+    disable_scope(&SCOPE_CTOM[msg_id]);
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_reset_scope(uint16_t msg_id,
+                                        ipc_queue_slot_t *p_msg)
+{
+    reset_scope(&SCOPE_CTOM[msg_id]);
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_set_slowref(uint16_t msg_id,
+                                        ipc_queue_slot_t *p_msg)
+{
+    error_mtoc_t status;
 
-            case CtoM_Message_Error:
+    SET_DEBUG_GPIO1;
+
+    /// NaN is the only value which is different from itself
+    if(p_msg->payload[0].f != p_msg->payload[0].f)
+    {
+        return Invalid_Argument;
+    }
+
+    status = No_Error_MtoC;
+
+    if(g_ipc_ctom.ps_module[msg_id].ps_status.bit.state == SlowRef)
+    {
+        g_ipc_ctom.ps_module[msg_id].ps_setpoint = p_msg->payload[0].f;
+    }
+
+    else if(g_ipc_ctom.ps_module[msg_id].ps_status.bit.state != SlowRefSync)
+    {
+        status = Invalid_OpMode;
+    }
+
+    g_ipc_ctom.counter_set_slowref++;
+
+    return status;
+}
+
+static error_mtoc_t ipc_msg_set_slowref_all_ps(uint16_t msg_id,
+                                               ipc_queue_slot_t *p_msg)
+{
+    uint16_t i;
+    error_mtoc_t status;
+
+    SET_DEBUG_GPIO1;
+
+    for(i = 0; i < NUM_MAX_PS_MODULES; i++)
+    {
+        if(p_msg->payload[i].f != p_msg->payload[i].f)
+        {
+            return Invalid_Argument;
+        }
+    }
+
+    status = No_Error_MtoC;
+
+    for(i = 0; i < NUM_MAX_PS_MODULES; i++)
+    {
+        if(g_ipc_ctom.ps_module[i].ps_status.bit.active)
+        {
+            if(g_ipc_ctom.ps_module[i].ps_status.bit.state == SlowRef)
             {
-                /**
-                 * TODO: take action when receiving error
-                 */
-                break;
+                g_ipc_ctom.ps_module[i].ps_setpoint = p_msg->payload[i].f;
             }
-
-            default:
+            else if(g_ipc_ctom.ps_module[i].ps_status.bit.state != SlowRefSync)
             {
-                /**
-                 * TODO: check
-                 */
-                g_ipc_ctom.error_mtoc = IPC_LowPriority_Full;
-                send_ipc_lowpriority_msg(msg_id, MtoC_Message_Error);
-                break;
+                status = Invalid_OpMode;
             }
         }
     }
 
-    PieCtrlRegs.PIEACK.all |= M_INT11;
+    g_ipc_ctom.counter_set_slowref++;
+
+    return status;
 }
 
-interrupt void isr_ipc_sync_pulse(void)
+static error_mtoc_t ipc_msg_cfg_wfmref(uint16_t msg_id, ipc_queue_slot_t *p_msg)
+{
+    cfg_wfmref(&WFMREF_CTOM[msg_id],&WFMREF_MTOC[msg_id]);
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_update_wfmref(uint16_t msg_id,
+                                          ipc_queue_slot_t *p_msg)
+{
+    update_wfmref(&WFMREF_CTOM[msg_id],&WFMREF_MTOC[msg_id]);
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_reset_wfmref(uint16_t msg_id,
+                                         ipc_queue_slot_t *p_msg)
+{
+    reset_wfmref(&WFMREF_CTOM[msg_id]);
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_cfg_siggen(uint16_t msg_id, ipc_queue_slot_t *p_msg)
+{
+    if( (SIGGEN_MTOC[msg_id].type > Square) ||
+        (SIGGEN_MTOC[msg_id].freq < 0.0) )
+    {
+        return Invalid_Argument;
+    }
+
+    cfg_siggen(&SIGGEN_CTOM[msg_id],
+               SIGGEN_MTOC[msg_id].type,
+               SIGGEN_MTOC[msg_id].num_cycles,
+               SIGGEN_MTOC[msg_id].freq,
+               SIGGEN_MTOC[msg_id].amplitude,
+               SIGGEN_MTOC[msg_id].offset,
+               SIGGEN_MTOC[msg_id].aux_param);
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_set_siggen(uint16_t msg_id, ipc_queue_slot_t *p_msg)
+{
+    if( !(p_msg->payload[0].f >= 0.0) )
+    {
+        return Invalid_Argument;
+    }
+
+    set_siggen_freq(&SIGGEN_CTOM[msg_id], p_msg->payload[0].f);
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_enable_siggen(uint16_t msg_id,
+                                          ipc_queue_slot_t *p_msg)
+{
+    enable_siggen(&SIGGEN_CTOM[msg_id]);
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_disable_siggen(uint16_t msg_id,
+                                           ipc_queue_slot_t *p_msg)
+{
+    disable_siggen(&SIGGEN_CTOM[msg_id]);
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_reset_counters(uint16_t msg_id,
+                                           ipc_queue_slot_t *p_msg)
 {
     uint16_t i;
 
+    g_ipc_ctom.counter_set_slowref =  0;
+    g_ipc_ctom.counter_sync_pulse =  0;
+
+    for(i = 0; i < NUM_IPC_MTOC_LOWPRIORITY_MSG; i++)
+    {
+        g_ipc_lowpriority_stats.counter[i] = 0;
+        g_ipc_lowpriority_stats.max_cycles[i] = 0;
+    }
+
+    g_ipc_lowpriority_stats.counter_invalid = 0;
+    g_ipc_lowpriority_stats.isr_last_cycles = 0;
+    g_ipc_lowpriority_stats.isr_max_cycles = 0;
+
+    reset_sync(&g_sync);
+    reset_itlk_latency();
+
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_set_param(uint16_t msg_id, ipc_queue_slot_t *p_msg)
+{
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_set_dsp_coeffs(uint16_t msg_id,
+                                           ipc_queue_slot_t *p_msg)
+{
+    if( (p_msg->payload[0].u32 > DSP_Vect_Product) ||
+        (p_msg->payload[1].u32 >=
+         num_max_dsp_modules[(uint16_t) p_msg->payload[0].u32]) )
+    {
+        return Invalid_Argument;
+    }
+
+    set_dsp_coeffs((dsp_class_t) p_msg->payload[0].u32,
+                   (uint16_t) p_msg->payload[1].u32);
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_set_command_interface(uint16_t msg_id,
+                                                  ipc_queue_slot_t *p_msg)
+{
+    if(p_msg->payload[0].u32 > PCHost)
+    {
+        return Invalid_Argument;
+    }
+
+    g_ipc_ctom.ps_module[msg_id].ps_status.bit.interface =
+            (ps_interface_t) p_msg->payload[0].u32;
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_ctom_message_error(uint16_t msg_id,
+                                               ipc_queue_slot_t *p_msg)
+{
+    /**
+     * TODO: take action when receiving error
+     */
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_cfg_size_scope(uint16_t msg_id,
+                                           ipc_queue_slot_t *p_msg)
+{
+    if( (p_msg->payload[0].u32 > 0xFFFF) ||
+        cfg_size_scope(&g_scope_arena_ctom, &SCOPE_CTOM[msg_id],
+                       (uint16_t) p_msg->payload[0].u32) )
+    {
+        return Invalid_Argument;
+    }
+
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_cfg_compression_scope(uint16_t msg_id,
+                                                  ipc_queue_slot_t *p_msg)
+{
+    if(cfg_compression_scope(&SCOPE_CTOM[msg_id], p_msg->payload[0].f,
+                             p_msg->payload[1].f))
+    {
+        return Invalid_Argument;
+    }
+
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_cfg_snapshot(uint16_t msg_id,
+                                         ipc_queue_slot_t *p_msg)
+{
+    if(p_msg->payload[0].u32 > 0xFFFF)
+    {
+        return Invalid_Argument;
+    }
+
+    cfg_ipc_snapshot((uint16_t) p_msg->payload[0].u32);
+    return No_Error_MtoC;
+}
+
+interrupt void isr_ipc_sync_pulse(void)
+{
+    uint16_t i, counter;
+    uint64_t timestamp;
+    float delay;
+
+    counter = SYNC_PWM_MASTER.TBCTR;
+    timestamp = get_timestamp64();
+
+    /// Time until next control ISR, for fractional alignment of WfmRef
+    delay = 1.0 - get_pwm_elapsed_fraction(&SYNC_PWM_MASTER);
+
     SET_DEBUG_GPIO1;
 
+    /// Pulse source is distinguished by pending IPC flag, before acknowledge
+    run_sync(&g_sync, timestamp,
+             (CtoMIpcRegs.MTOCIPCSTS.all & SYNC_PULSE) != 0);
+    run_sync_pll(&g_sync_pll, &g_sync, counter);
+
     for(i = 0; i < NUM_MAX_PS_MODULES; i++)
     {
         if(g_ipc_ctom.ps_module[i].ps_status.bit.active)
@@ -523,7 +1060,7 @@ interrupt void isr_ipc_sync_pulse(void)
                 case RmpWfm:
                 case MigWfm:
                 {
-                    sync_wfmref(&WFMREF_CTOM[i], &WFMREF_MTOC[i]);
+                    sync_wfmref(&WFMREF_CTOM[i], &WFMREF_MTOC[i], delay);
                     break;
                 }
 
@@ -559,3 +1096,242 @@ interrupt void isr_ipc_sync_pulse(void)
 
     //CLEAR_DEBUG_GPIO1;
 }
+
+static error_mtoc_t ipc_msg_cfg_fastref(uint16_t msg_id,
+                                        ipc_queue_slot_t *p_msg)
+{
+    if( (p_msg->payload[0].u32 > 0xFFFF) ||
+        (p_msg->payload[1].u32 > FastRef_Linear) )
+    {
+        return Invalid_Argument;
+    }
+
+    cfg_fastref(&g_fastref, (uint16_t) p_msg->payload[0].u32,
+                (fastref_interpolation_t) p_msg->payload[1].u32);
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_cfg_sync(uint16_t msg_id, ipc_queue_slot_t *p_msg)
+{
+    if( !(p_msg->payload[0].f >= 0.0) || !(p_msg->payload[1].f >= 0.0) )
+    {
+        return Invalid_Argument;
+    }
+
+    cfg_sync(&g_sync, p_msg->payload[0].f, p_msg->payload[1].f);
+    return No_Error_MtoC;
+}
+
+static error_mtoc_t ipc_msg_cfg_sync_pll(uint16_t msg_id,
+                                         ipc_queue_slot_t *p_msg)
+{
+    if( (p_msg->payload[0].u32 > 1) ||
+        !(p_msg->payload[1].f >= 0.0) || !(p_msg->payload[2].f >= 0.0) ||
+        (p_msg->payload[3].u32 > SYNC_PWM_MASTER.TBPRD) )
+    {
+        return Invalid_Argument;
+    }
+
+    cfg_sync_pll(&g_sync_pll, p_msg->payload[1].f, p_msg->payload[2].f,
+                 (uint16_t) p_msg->payload[3].u32);
+
+    if(p_msg->payload[0].u32)
+    {
+        enable_sync_pll(&g_sync_pll);
+    }
+    else
+    {
+        disable_sync_pll(&g_sync_pll);
+    }
+
+    return No_Error_MtoC;
+}
+
+/**
+ * Payload 0: decimation
+ * Payload 1: number of frames stored after trigger
+ * Payload 2: number of frames of history, carved from scope arena
+ */
+static error_mtoc_t ipc_msg_cfg_postmortem(uint16_t msg_id,
+                                           ipc_queue_slot_t *p_msg)
+{
+    if( (p_msg->payload[0].u32 > 0xFFFF) ||
+        (p_msg->payload[1].u32 > 0xFFFF) ||
+        (p_msg->payload[2].u32 > 0xFFFF) ||
+        cfg_postmortem(&g_postmortem, &g_scope_arena_ctom,
+                       (uint16_t) p_msg->payload[0].u32,
+                       (uint16_t) p_msg->payload[1].u32,
+                       (uint16_t) p_msg->payload[2].u32) )
+    {
+        return Invalid_Argument;
+    }
+
+    return No_Error_MtoC;
+}
+
+/**
+ * Payload 0: CIC order
+ * Payload 1: enable droop compensation FIR
+ */
+static error_mtoc_t ipc_msg_cfg_hradc_decimation(uint16_t msg_id,
+                                                 ipc_queue_slot_t *p_msg)
+{
+    /// Decimator reset transients would disturb feedback signals
+    if(!Is_PS_Off())
+    {
+        return Invalid_OpMode;
+    }
+
+    if( (p_msg->payload[0].u32 > DECIMATOR_MAX_ORDER) ||
+        (p_msg->payload[1].u32 > 1) ||
+        cfg_decimation_HRADC((uint16_t) p_msg->payload[0].u32,
+                             (uint16_t) p_msg->payload[1].u32) )
+    {
+        return Invalid_Argument;
+    }
+
+    return No_Error_MtoC;
+}
+
+/**
+ * Payload 0: enable [0/1]
+ * Payload 1: period between calibration slots, taken while all PS are off [s]
+ */
+static error_mtoc_t ipc_msg_cfg_hradc_offline_calib(uint16_t msg_id,
+                                                    ipc_queue_slot_t *p_msg)
+{
+    if( (p_msg->payload[0].u32 > 1) ||
+        Config_HRADC_Offline_Calibration((uint16_t) p_msg->payload[0].u32,
+                                         p_msg->payload[1].f) )
+    {
+        return Invalid_Argument;
+    }
+
+    return No_Error_MtoC;
+}
+
+/**
+ * Payload 0: sample check [0 - NUM_MAX_INTEGRITY_CHECKS-1]
+ * Payload 1: rate-of-change limit, per sample [0: disabled]
+ * Payload 2: enable median of 3 [0/1]
+ * Payload 3: maximum consecutive rejections before following signal
+ *            [1 - INTEGRITY_MAX_HOLDS]
+ */
+static error_mtoc_t ipc_msg_cfg_integrity(uint16_t msg_id,
+                                          ipc_queue_slot_t *p_msg)
+{
+    uint16_t int_status, error;
+
+    if( (p_msg->payload[0].u32 >= NUM_MAX_INTEGRITY_CHECKS) ||
+        (p_msg->payload[2].u32 > 1) ||
+        (p_msg->payload[3].u32 > 0xFFFF) )
+    {
+        return Invalid_Argument;
+    }
+
+    /// Check is reset, so it can't be interrupted by control ISR
+    int_status = __disable_interrupts();
+
+    error = cfg_sample_check(&g_integrity.check[p_msg->payload[0].u32],
+                             p_msg->payload[1].f,
+                             (uint16_t) p_msg->payload[2].u32,
+                             (uint16_t) p_msg->payload[3].u32);
+
+    if(!error)
+    {
+        reset_vote(&g_integrity.vote);
+    }
+
+    __restore_interrupts(int_status);
+
+    if(error)
+    {
+        return Invalid_Argument;
+    }
+
+    return No_Error_MtoC;
+}
+
+/**
+ * Check whether any active power supply module is on FastRef mode.
+ *
+ * @return 1 if so, 0 otherwise
+ */
+static uint16_t is_fastref_active(void)
+{
+    uint16_t i;
+
+    for(i = 0; i < NUM_MAX_PS_MODULES; i++)
+    {
+        if( g_ipc_ctom.ps_module[i].ps_status.bit.active &&
+            (g_ipc_ctom.ps_module[i].ps_status.bit.state == FastRef) )
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Configure status snapshot publishing rate.
+ *
+ * @param decimation number of control ticks between snapshots (0 disables it)
+ */
+void cfg_ipc_snapshot(uint16_t decimation)
+{
+    g_ipc_snapshot_ctom.decimation = decimation;
+    counter_snapshot = 0;
+}
+
+/**
+ * Publish status snapshot every ```decimation``` calls. It must be called once
+ * per control tick, after all status and signals have been updated, from a
+ * context which is never preempted by another call to it.
+ */
+void run_ipc_snapshot(void)
+{
+    uint16_t i;
+
+    if( (g_ipc_snapshot_ctom.decimation == 0) ||
+        (++counter_snapshot < g_ipc_snapshot_ctom.decimation) )
+    {
+        return;
+    }
+
+    counter_snapshot = 0;
+
+    /// Odd sequence number indicates snapshot under update
+    g_ipc_snapshot_ctom.seq++;
+
+    g_ipc_snapshot_ctom.timestamp = GET_TIMESTAMP;
+    g_ipc_snapshot_ctom.counter_sync_pulse = g_ipc_ctom.counter_sync_pulse;
+    latch_frame_stamp(&g_ipc_snapshot_ctom.frame_stamp);
+
+    for(i = 0; i < NUM_MAX_PS_MODULES; i++)
+    {
+        g_ipc_snapshot_ctom.ps_module[i].ps_status.all =
+                g_ipc_ctom.ps_module[i].ps_status.all;
+        g_ipc_snapshot_ctom.ps_module[i].ps_setpoint =
+                g_ipc_ctom.ps_module[i].ps_setpoint;
+        g_ipc_snapshot_ctom.ps_module[i].ps_reference =
+                g_ipc_ctom.ps_module[i].ps_reference;
+        g_ipc_snapshot_ctom.ps_module[i].ps_hard_interlock =
+                g_ipc_ctom.ps_module[i].ps_hard_interlock;
+        g_ipc_snapshot_ctom.ps_module[i].ps_soft_interlock =
+                g_ipc_ctom.ps_module[i].ps_soft_interlock;
+    }
+
+    for(i = 0; i < NUM_MAX_NET_SIGNALS; i++)
+    {
+        g_ipc_snapshot_ctom.net_signals[i] = g_controller_ctom.net_signals[i].u32;
+    }
+
+    for(i = 0; i < NUM_MAX_OUTPUT_SIGNALS; i++)
+    {
+        g_ipc_snapshot_ctom.output_signals[i] =
+                g_controller_ctom.output_signals[i].u32;
+    }
+
+    g_ipc_snapshot_ctom.seq++;
+}
@@ -26,6 +26,7 @@
 #include <stdint.h>
 #include "boards/version.h"
 #include "common/structs.h"
+#include "common/timestamp.h"
 #include "ps_modules/ps_modules.h"
 #include "siggen/siggen.h"
 #include "wfmref/wfmref.h"
@@ -59,6 +60,28 @@
 #define HARD_INTERLOCK              0x00000004  // IPC3
 #define SOFT_INTERLOCK              0x00000008  // IPC4
 
+/**
+ * Low priority messages queues
+ *
+ * Each direction has a single-producer single-consumer queue. Slots and head
+ * index are stored on producer message RAM, while tail index is stored on
+ * consumer message RAM, so each index is written by a single core. Indexes
+ * are free-running, and queue is full when head - tail == IPC_QUEUE_SIZE.
+ * Producer fills slot before incrementing head, and then sets IPC1 flag as
+ * doorbell. Consumer increments tail after processing slot.
+ */
+#define IPC_QUEUE_SIZE              8   // must be a power of 2
+#define IPC_QUEUE_MASK              (IPC_QUEUE_SIZE - 1)
+#define IPC_QUEUE_PAYLOAD_SIZE      4
+
+/**
+ * Message flags. A batch frame is a sequence of slots flagged with
+ * IPC_MSG_FLAG_BATCH, terminated by an unflagged slot. It must not be longer
+ * than IPC_QUEUE_SIZE, and its status is returned per slot on
+ * ```status_queue_mtoc```.
+ */
+#define IPC_MSG_FLAG_BATCH          0x0001
+
 typedef enum
 {
     Turn_On = 1,
@@ -89,13 +112,27 @@ typedef enum
     Set_DSP_Coeffs,
     Cfg_TimeSlicer,
     Set_Command_Interface,
-    CtoM_Message_Error
+    CtoM_Message_Error,
+    Cfg_Size_Scope,
+    Cfg_Compression_Scope,
+    Cfg_Snapshot,
+    Cfg_FastRef,
+    Cfg_Sync,
+    Cfg_Sync_PLL,
+    Cfg_PostMortem,
+    Cfg_HRADC_Decimation,
+    Cfg_HRADC_Offline_Calib,
+    Cfg_Integrity
 } ipc_mtoc_lowpriority_msg_t;
 
+#define NUM_IPC_MTOC_LOWPRIORITY_MSG    (Cfg_Integrity + 1)
+
 typedef enum
 {   Enable_HRADC_Boards,
     Disable_HRADC_Boards,
-    MtoC_Message_Error
+    MtoC_Message_Error,
+    HRADC_Board_Failure,    // msg_id holds HRADC board ID
+    HRADC_Config_Error      // msg_id holds unsupported decimation factor
 } ipc_ctom_lowpriority_msg_t;
 
 #define GET_IPC_MTOC_LOWPRIORITY_MSG  (ipc_mtoc_lowpriority_msg_t) (g_ipc_ctom.msg_mtoc >> 4 ) & 0x0000FFFF
@@ -115,12 +152,35 @@ typedef enum
     Invalid_Argument,
     Invalid_OpMode,
     IPC_LowPriority_Full,
-    HRADC_Config_Error
+    HRADC_Config_Error,
+    Batch_Aborted,
+    Invalid_Message
 } error_mtoc_t;
 
 /**
  * IPC structures definitions
  */
+typedef union
+{
+    uint32_t    u32;
+    float       f;
+} u_ipc_payload_t;
+
+typedef volatile struct
+{
+    uint16_t        msg;
+    uint16_t        msg_id;
+    uint16_t        flags;
+    u_ipc_payload_t payload[IPC_QUEUE_PAYLOAD_SIZE];
+} ipc_queue_slot_t;
+
+typedef volatile struct
+{
+    uint16_t            head;
+    uint16_t            num_dropped;
+    ipc_queue_slot_t    slot[IPC_QUEUE_SIZE];
+} ipc_queue_t;
+
 typedef struct
 {
     char            udc_c28_version[SIZE_VERSION]; // C28 char = 2 bytes
@@ -133,6 +193,9 @@ typedef struct
     siggen_t        siggen[NUM_MAX_PS_MODULES];
     wfmref_t        wfmref[NUM_MAX_PS_MODULES];
     scope_t         scope[NUM_MAX_SCOPES];
+    ipc_queue_t     queue_ctom;
+    uint16_t        tail_queue_mtoc;
+    uint16_t        status_queue_mtoc[IPC_QUEUE_SIZE];
 } ipc_ctom_t;
 
 typedef struct
@@ -148,6 +211,8 @@ typedef struct
     wfmref_t                wfmref[NUM_MAX_PS_MODULES];
     scope_t                 scope[NUM_MAX_SCOPES];
     dsp_module_t            dsp_module;
+    ipc_queue_t             queue_mtoc;
+    uint16_t                tail_queue_ctom;
     //param_control_t         control;
     //param_pwm_t             pwm;
     //param_hradc_t           hradc;
@@ -156,15 +221,74 @@ typedef struct
     //param_interlocks_t      interlocks;
 } ipc_mtoc_t;
 
+/**
+ * Low priority messages statistics: number of processed messages and worst
+ * case handler execution time per opcode, and worst case ISR processing time,
+ * from entry to acknowledge. Times are in CPU cycles.
+ */
+typedef volatile struct
+{
+    uint32_t    counter[NUM_IPC_MTOC_LOWPRIORITY_MSG];
+    uint32_t    max_cycles[NUM_IPC_MTOC_LOWPRIORITY_MSG];
+    uint32_t    counter_invalid;
+    uint32_t    isr_last_cycles;
+    uint32_t    isr_max_cycles;
+} ipc_lowpriority_stats_t;
+
+/**
+ * Status snapshot
+ *
+ * Coherent copy of power supplies status and control framework signals,
+ * published by C28 every ```decimation``` control ticks (0 disables it). ARM
+ * must read it instead of the live variables, which may be torn while the ISR
+ * updates them.
+ *
+ * Consistency is guaranteed by a sequence counter (seqlock): C28 increments
+ * ```seq``` before and after updating the snapshot, so it's odd during update.
+ * ARM reads ```seq```, retries while it's odd, copies the snapshot and reads
+ * ```seq``` again, retrying if it has changed.
+ *
+ * ```frame_stamp``` identifies the acquisition frame from which net signals
+ * were computed.
+ */
+#define IPC_SNAPSHOT_DECIMATION     10
+
+typedef volatile struct
+{
+    ps_status_t     ps_status;
+    float           ps_setpoint;
+    float           ps_reference;
+    uint32_t        ps_hard_interlock;
+    uint32_t        ps_soft_interlock;
+} ipc_snapshot_ps_module_t;
+
+typedef volatile struct
+{
+    uint16_t                    seq;
+    uint16_t                    decimation;
+    uint32_t                    timestamp;
+    uint32_t                    counter_sync_pulse;
+    frame_stamp_t               frame_stamp;
+    ipc_snapshot_ps_module_t    ps_module[NUM_MAX_PS_MODULES];
+    uint32_t                    net_signals[NUM_MAX_NET_SIGNALS];
+    uint32_t                    output_signals[NUM_MAX_OUTPUT_SIGNALS];
+} ipc_snapshot_t;
+
 extern volatile float g_buf_samples_ctom[SIZE_BUF_SAMPLES_CTOM];
 extern volatile float g_buf_samples_mtoc[SIZE_BUF_SAMPLES_MTOC];
 
+extern scope_arena_t g_scope_arena_ctom;
+
 extern volatile ipc_ctom_t g_ipc_ctom;
 extern volatile ipc_mtoc_t g_ipc_mtoc;
+extern volatile ipc_lowpriority_stats_t g_ipc_lowpriority_stats;
+extern volatile ipc_snapshot_t g_ipc_snapshot_ctom;
 
 extern void init_ipc(void);
 extern void send_ipc_msg(uint16_t msg_id, uint32_t msg);
 extern void send_ipc_lowpriority_msg(uint16_t msg_id,
                                      ipc_ctom_lowpriority_msg_t msg);
+extern void cfg_ipc_snapshot(uint16_t decimation);
+extern void run_ipc_snapshot(void);
 
 #endif /* IPC_H_ */
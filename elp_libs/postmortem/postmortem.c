@@ -0,0 +1,242 @@
+/******************************************************************************
+ * Copyright (C) 2026 by LNLS - Brazilian Synchrotron Light Laboratory
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. LNLS and
+ * the Brazilian Center for Research in Energy and Materials (CNPEM) are not
+ * liable for any misuse of this material.
+ *
+ *****************************************************************************/
+
+/**
+ * @file postmortem.c
+ * @brief Post-mortem capture module
+ *
+ * This module keeps a circular history of control signals, which is frozen
+ * when a hard interlock occurs.
+ *
+ * @author gabriel.brunheira
+ * @date 19/10/2026
+ *
+ */
+
+#include "boards/udc_c28.h"
+#include "common/timestamp.h"
+#include "ipc/ipc.h"
+#include "postmortem.h"
+
+#pragma DATA_SECTION(g_postmortem,"SHARERAMS1_1_POSTMORTEM");
+volatile postmortem_t g_postmortem;
+
+#pragma CODE_SECTION(trigger_postmortem,"ramfuncs");
+#pragma CODE_SECTION(run_postmortem,"ramfuncs");
+
+/**
+ * Initialization of post-mortem capture. It starts armed, with no frames,
+ * which must be carved from scope arena with cfg_postmortem().
+ *
+ * @param p_pm pointer to post-mortem struct
+ * @param decimation number of control ticks per stored frame
+ * @param post_trigger number of frames stored after trigger
+ */
+void init_postmortem(postmortem_t *p_pm, uint16_t decimation,
+                     uint16_t post_trigger)
+{
+    p_pm->state = PostMortem_Frozen;
+    p_pm->p_frames = 0;
+    p_pm->num_frames = 0;
+    p_pm->decimation = decimation;
+    p_pm->post_trigger = post_trigger;
+    p_pm->counter_triggers = 0;
+
+    reset_postmortem(p_pm);
+}
+
+/**
+ * Configure post-mortem capture and re-arm it. Frames are reserved at the end
+ * of specified scope arena, replacing previous ones, so there must be enough
+ * space not allocated to scopes.
+ *
+ * @param p_pm pointer to post-mortem struct
+ * @param p_arena pointer to scope arena
+ * @param decimation number of control ticks per stored frame [1 - 65535]
+ * @param post_trigger number of frames stored after trigger
+ *                     [0 - num_frames-1]
+ * @param num_frames number of frames of history [0: trigger info only]
+ * @return 1 if arguments are invalid or if there is not enough space on
+ *         arena, 0 otherwise
+ */
+uint16_t cfg_postmortem(postmortem_t *p_pm, scope_arena_t *p_arena,
+                        uint16_t decimation, uint16_t post_trigger,
+                        uint16_t num_frames)
+{
+    uint16_t int_status;
+    uint32_t size;
+
+    size = (uint32_t) num_frames * POSTMORTEM_FRAME_SIZE;
+
+    if( (decimation == 0) || (num_frames && (post_trigger >= num_frames)) ||
+        (size > (uint32_t) size_free_scope_arena(p_arena) +
+                p_arena->size_reserved) )
+    {
+        return 1;
+    }
+
+    /// Frames are released before arena space is handed over
+    int_status = __disable_interrupts();
+
+    p_pm->state = PostMortem_Frozen;
+    p_pm->p_frames = 0;
+    p_pm->num_frames = 0;
+
+    __restore_interrupts(int_status);
+
+    reserve_scope_arena(p_arena, (uint16_t) size);
+
+    p_pm->p_frames = (postmortem_frame_t *) (p_arena->p_start + p_arena->size -
+                                             p_arena->size_reserved);
+    p_pm->num_frames = num_frames;
+    p_pm->decimation = decimation;
+    p_pm->post_trigger = post_trigger;
+
+    reset_postmortem(p_pm);
+
+    return 0;
+}
+
+/**
+ * Clear history and re-arm post-mortem capture.
+ *
+ * @param p_pm pointer to post-mortem struct
+ */
+void reset_postmortem(postmortem_t *p_pm)
+{
+    uint16_t i, j;
+
+    p_pm->state = PostMortem_Frozen;
+
+    for(i = 0; i < p_pm->num_frames; i++)
+    {
+        p_pm->p_frames[i].tick = 0;
+
+        for(j = 0; j < NUM_MAX_NET_SIGNALS; j++)
+        {
+            p_pm->p_frames[i].net_signals[j] = 0;
+        }
+
+        for(j = 0; j < NUM_MAX_OUTPUT_SIGNALS; j++)
+        {
+            p_pm->p_frames[i].output_signals[j] = 0;
+        }
+
+        for(j = 0; j < NUM_MAX_PS_MODULES; j++)
+        {
+            p_pm->p_frames[i].ps_reference[j] = 0.0;
+        }
+    }
+
+    p_pm->counter_decimation = 0;
+    p_pm->counter_post_trigger = 0;
+    p_pm->head = 0;
+    p_pm->trigger_frame = 0;
+    p_pm->trigger_id = 0;
+    p_pm->tick = 0;
+    p_pm->trigger_timestamp = 0;
+
+    p_pm->state = PostMortem_Armed;
+}
+
+/**
+ * Trigger post-mortem capture, if armed. It must be called when a hard
+ * interlock is latched.
+ *
+ * @param p_pm pointer to post-mortem struct
+ * @param id id of power supply/module which triggered capture
+ */
+void trigger_postmortem(postmortem_t *p_pm, uint16_t id)
+{
+    uint16_t int_status;
+
+    int_status = __disable_interrupts();
+
+    if(p_pm->state == PostMortem_Armed)
+    {
+        p_pm->trigger_timestamp = get_timestamp64();
+        p_pm->trigger_id = id;
+
+        if(p_pm->head)
+        {
+            p_pm->trigger_frame = p_pm->head - 1;
+        }
+        else if(p_pm->num_frames)
+        {
+            p_pm->trigger_frame = p_pm->num_frames - 1;
+        }
+
+        p_pm->counter_post_trigger = p_pm->post_trigger;
+        p_pm->counter_triggers++;
+
+        if(p_pm->post_trigger && p_pm->num_frames)
+        {
+            p_pm->state = PostMortem_Triggered;
+        }
+        else
+        {
+            p_pm->state = PostMortem_Frozen;
+        }
+    }
+
+    __restore_interrupts(int_status);
+}
+
+/**
+ * Store new frame of control signals every ```decimation``` calls, unless
+ * history is frozen. It must be called once per control tick.
+ *
+ * @param p_pm pointer to post-mortem struct
+ */
+void run_postmortem(postmortem_t *p_pm)
+{
+    uint16_t i;
+    postmortem_frame_t *p_frame;
+
+    p_pm->tick++;
+
+    if( (p_pm->state == PostMortem_Frozen) || (p_pm->num_frames == 0) ||
+        (++p_pm->counter_decimation < p_pm->decimation) )
+    {
+        return;
+    }
+
+    p_pm->counter_decimation = 0;
+
+    p_frame = &p_pm->p_frames[p_pm->head];
+
+    p_frame->tick = p_pm->tick;
+
+    for(i = 0; i < NUM_MAX_NET_SIGNALS; i++)
+    {
+        p_frame->net_signals[i] = g_controller_ctom.net_signals[i].u32;
+    }
+
+    for(i = 0; i < NUM_MAX_OUTPUT_SIGNALS; i++)
+    {
+        p_frame->output_signals[i] = g_controller_ctom.output_signals[i].u32;
+    }
+
+    for(i = 0; i < NUM_MAX_PS_MODULES; i++)
+    {
+        p_frame->ps_reference[i] = g_ipc_ctom.ps_module[i].ps_reference;
+    }
+
+    if(++p_pm->head >= p_pm->num_frames)
+    {
+        p_pm->head = 0;
+    }
+
+    if( (p_pm->state == PostMortem_Triggered) &&
+        (--p_pm->counter_post_trigger == 0) )
+    {
+        p_pm->state = PostMortem_Frozen;
+    }
+}
@@ -0,0 +1,93 @@
+/******************************************************************************
+ * Copyright (C) 2026 by LNLS - Brazilian Synchrotron Light Laboratory
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. LNLS and
+ * the Brazilian Center for Research in Energy and Materials (CNPEM) are not
+ * liable for any misuse of this material.
+ *
+ *****************************************************************************/
+
+/**
+ * @file postmortem.h
+ * @brief Post-mortem capture module
+ *
+ * This module keeps a circular history of all net and output signals from
+ * C28 control framework, plus references of all power supplies, so every
+ * hard interlock ships with its own pre-fault data, without any scope armed
+ * beforehand.
+ *
+ * While armed, a frame is stored every ```decimation``` control ticks. When
+ * a hard interlock is latched, ```post_trigger``` more frames are stored and
+ * history is frozen until ARM re-arms it. ```head``` is the index of the
+ * next frame, so after freezing the oldest frame is at ```head``` and the
+ * last frame stored before trigger is at ```trigger_frame```.
+ *
+ * Frames are carved at runtime from the end of scope arena on shared RAM, so
+ * history length is traded against scope depth only when requested. It
+ * starts with no frames, when only trigger timestamp and id are recorded,
+ * and up to the whole arena may be given to it once scopes are shrunk.
+ *
+ * @author gabriel.brunheira
+ * @date 19/10/2026
+ *
+ */
+
+#ifndef POSTMORTEM_H_
+#define POSTMORTEM_H_
+
+#include <stdint.h>
+#include "control/control.h"
+#include "ps_modules/ps_modules.h"
+#include "scope/scope.h"
+
+#define POSTMORTEM_DECIMATION       1
+#define POSTMORTEM_POST_TRIGGER     4       // [frames]
+
+typedef enum
+{
+    PostMortem_Armed,
+    PostMortem_Triggered,
+    PostMortem_Frozen
+} postmortem_state_t;
+
+typedef volatile struct
+{
+    uint32_t    tick;
+    uint32_t    net_signals[NUM_MAX_NET_SIGNALS];
+    uint32_t    output_signals[NUM_MAX_OUTPUT_SIGNALS];
+    float       ps_reference[NUM_MAX_PS_MODULES];
+} postmortem_frame_t;
+
+/// Number of arena samples per frame
+#define POSTMORTEM_FRAME_SIZE       (sizeof(postmortem_frame_t) / sizeof(float))
+
+typedef volatile struct
+{
+    postmortem_state_t  state;
+    postmortem_frame_t  *p_frames;
+    uint16_t            num_frames;
+    uint16_t            decimation;
+    uint16_t            counter_decimation;
+    uint16_t            post_trigger;
+    uint16_t            counter_post_trigger;
+    uint16_t            head;
+    uint16_t            trigger_frame;
+    uint16_t            trigger_id;
+    uint32_t            tick;
+    uint64_t            trigger_timestamp;
+    uint32_t            counter_triggers;
+} postmortem_t;
+
+extern volatile postmortem_t g_postmortem;
+
+extern void init_postmortem(postmortem_t *p_pm, uint16_t decimation,
+                            uint16_t post_trigger);
+extern uint16_t cfg_postmortem(postmortem_t *p_pm, scope_arena_t *p_arena,
+                               uint16_t decimation, uint16_t post_trigger,
+                               uint16_t num_frames);
+extern void reset_postmortem(postmortem_t *p_pm);
+extern void trigger_postmortem(postmortem_t *p_pm, uint16_t id);
+extern void run_postmortem(postmortem_t *p_pm);
+
+#endif /* POSTMORTEM_H_ */
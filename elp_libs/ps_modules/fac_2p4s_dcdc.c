@@ -48,13 +48,16 @@
 #include <float.h>
 
 #include "boards/udc_c28.h"
+#include "common/integrity.h"
 #include "common/structs.h"
 #include "common/timeslicer.h"
+#include "common/timestamp.h"
 #include "control/control.h"
 #include "event_manager/event_manager.h"
 #include "HRADC_board/HRADC_Boards.h"
 #include "ipc/ipc.h"
 #include "parameters/parameters.h"
+#include "postmortem/postmortem.h"
 #include "pwm/pwm.h"
 #include "wfmref/wfmref.h"
 
@@ -261,11 +264,59 @@ typedef enum
 #define NUM_HARD_INTERLOCKS     IIB_Mod_8_Itlk + 1
 #define NUM_SOFT_INTERLOCKS     Complementary_PS_Itlk + 1
 
+/**
+ * Threshold interlocks tables:
+ *
+ *  {signal, min, max, hysteresis, use_abs, interlock, type}
+ */
+#define NUM_THRESHOLD_ITLKS             13
+#define NUM_CAPBANK_UNDERVOLTAGE_ITLKS  8
+
+#define CAPBANK_OVERVOLTAGE_ITLK(v_capbank, itlk)   \
+    {&v_capbank, 0, &MAX_V_CAPBANK, 0.0, 0, itlk, Threshold_Hard_Itlk}
+
+#define CAPBANK_UNDERVOLTAGE_ITLK(v_capbank, itlk)  \
+    {&v_capbank, &MIN_V_CAPBANK, 0, 0.0, 0, itlk, Threshold_Hard_Itlk}
+
 /**
  *  Private variables
  */
 static uint16_t decimation_factor;
-static float decimation_coeff;
+
+/// Load current from raw samples, for overcurrent protection
+static volatile float i_load_mean_raw;
+
+static threshold_itlk_t threshold_itlks_entries[NUM_THRESHOLD_ITLKS] =
+{
+    {&i_load_mean_raw, 0, &MAX_ILOAD, 0.0, 1, Load_Overcurrent, Threshold_Hard_Itlk},
+    CAPBANK_OVERVOLTAGE_ITLK(V_CAPBANK_MOD_1, Module_1_CapBank_Overvoltage),
+    CAPBANK_OVERVOLTAGE_ITLK(V_CAPBANK_MOD_2, Module_2_CapBank_Overvoltage),
+    CAPBANK_OVERVOLTAGE_ITLK(V_CAPBANK_MOD_3, Module_3_CapBank_Overvoltage),
+    CAPBANK_OVERVOLTAGE_ITLK(V_CAPBANK_MOD_4, Module_4_CapBank_Overvoltage),
+    CAPBANK_OVERVOLTAGE_ITLK(V_CAPBANK_MOD_5, Module_5_CapBank_Overvoltage),
+    CAPBANK_OVERVOLTAGE_ITLK(V_CAPBANK_MOD_6, Module_6_CapBank_Overvoltage),
+    CAPBANK_OVERVOLTAGE_ITLK(V_CAPBANK_MOD_7, Module_7_CapBank_Overvoltage),
+    CAPBANK_OVERVOLTAGE_ITLK(V_CAPBANK_MOD_8, Module_8_CapBank_Overvoltage),
+    {&I_LOAD_DIFF, 0, &MAX_DCCTS_DIFF, 0.0, 1, DCCT_High_Difference, Threshold_Soft_Itlk},
+    {&I_ARM_1, 0, &MAX_I_ARM, 0.0, 1, ARM_1_Overcurrent, Threshold_Soft_Itlk},
+    {&I_ARM_2, 0, &MAX_I_ARM, 0.0, 1, ARM_2_Overcurrent, Threshold_Soft_Itlk},
+    {&I_ARMS_DIFF, 0, &MAX_I_ARMS_DIFF, 0.0, 1, Arms_High_Difference, Threshold_Soft_Itlk}
+};
+
+static threshold_itlk_t capbank_undervoltage_itlks_entries[NUM_CAPBANK_UNDERVOLTAGE_ITLKS] =
+{
+    CAPBANK_UNDERVOLTAGE_ITLK(V_CAPBANK_MOD_1, Module_1_CapBank_Undervoltage),
+    CAPBANK_UNDERVOLTAGE_ITLK(V_CAPBANK_MOD_2, Module_2_CapBank_Undervoltage),
+    CAPBANK_UNDERVOLTAGE_ITLK(V_CAPBANK_MOD_3, Module_3_CapBank_Undervoltage),
+    CAPBANK_UNDERVOLTAGE_ITLK(V_CAPBANK_MOD_4, Module_4_CapBank_Undervoltage),
+    CAPBANK_UNDERVOLTAGE_ITLK(V_CAPBANK_MOD_5, Module_5_CapBank_Undervoltage),
+    CAPBANK_UNDERVOLTAGE_ITLK(V_CAPBANK_MOD_6, Module_6_CapBank_Undervoltage),
+    CAPBANK_UNDERVOLTAGE_ITLK(V_CAPBANK_MOD_7, Module_7_CapBank_Undervoltage),
+    CAPBANK_UNDERVOLTAGE_ITLK(V_CAPBANK_MOD_8, Module_8_CapBank_Undervoltage)
+};
+
+static threshold_itlks_t threshold_itlks;
+static threshold_itlks_t capbank_undervoltage_itlks;
 
 /**
  * Private functions
@@ -292,8 +343,6 @@ static void turn_off(uint16_t dummy);
 
 static void reset_interlocks(uint16_t dummy);
 static inline void check_interlocks(void);
-static inline void check_capbank_undervoltage(void);
-static inline void check_capbank_overvoltage(void);
 
 static void cfg_pwm_module_h_brigde_q2(volatile struct EPWM_REGS *p_pwm_module);
 static void set_pwm_duty_hbridge_chB(volatile struct EPWM_REGS *p_pwm_module, float duty_pu);
@@ -325,6 +374,7 @@ void main_fac_2p4s_dcdc(void)
     while(1)
     {
         check_interlocks();
+        Run_HRADC_Offline_Calibration();
     }
 
     turn_off(0);
@@ -343,7 +393,6 @@ static void init_peripherals_drivers(void)
     stop_DMA();
 
     decimation_factor = (uint16_t) roundf(HRADC_FREQ_SAMP / ISR_CONTROL_FREQ);
-    decimation_coeff = 1.0 / (float) decimation_factor;
 
 
     HRADCs_Info.enable_Sampling = 0;
@@ -355,19 +404,17 @@ static void init_peripherals_drivers(void)
     Init_SPIMaster_Gpio();
     InitMcbspa20bit();
 
-    DELAY_US(500000);
-    send_ipc_lowpriority_msg(0,Enable_HRADC_Boards);
-    DELAY_US(2000000);
-
     for(i = 0; i < NUM_HRADC_BOARDS; i++)
     {
-        Init_HRADC_Info(&HRADCs_Info.HRADC_boards[i], i, decimation_factor,
-                        buffers_HRADC[i], TRANSDUCER_GAIN[i]);
-        Config_HRADC_board(&HRADCs_Info.HRADC_boards[i], TRANSDUCER_OUTPUT_TYPE[i],
-                           HRADC_HEATER_ENABLE[i], HRADC_MONITOR_ENABLE[i]);
+        Request_HRADC_board(i, decimation_factor, buffers_HRADC[0][i], TRANSDUCER_GAIN[i],
+                            TRANSDUCER_OUTPUT_TYPE[i], HRADC_HEATER_ENABLE[i],
+                            HRADC_MONITOR_ENABLE[i]);
     }
 
+    Bringup_HRADC_boards(NUM_HRADC_BOARDS);
+
     Config_HRADC_SoC(HRADC_FREQ_SAMP);
+    Update_HRADC_Calibration();
 
     /**
      *
@@ -445,6 +492,7 @@ static void init_peripherals_drivers(void)
 
     /// Initialization of timers
     InitCpuTimers();
+    init_timestamp();
     ConfigCpuTimer(&CpuTimer0, C28_FREQ_MHZ, 1000000);
     CpuTimer0Regs.TCR.bit.TIE = 0;
 
@@ -468,6 +516,12 @@ static void init_controller(void)
     g_ipc_ctom.ps_module[2].ps_status.all = 0;
     g_ipc_ctom.ps_module[3].ps_status.all = 0;
 
+    init_soe();
+    reset_itlk_latency();
+    init_postmortem(&g_postmortem, POSTMORTEM_DECIMATION,
+                    POSTMORTEM_POST_TRIGGER);
+    init_integrity(&g_integrity);
+
     init_event_manager(0, ISR_CONTROL_FREQ,
                        NUM_HARD_INTERLOCKS, NUM_SOFT_INTERLOCKS,
                        &HARD_INTERLOCKS_DEBOUNCE_TIME,
@@ -475,6 +529,12 @@ static void init_controller(void)
                        &SOFT_INTERLOCKS_DEBOUNCE_TIME,
                        &SOFT_INTERLOCKS_RESET_TIME);
 
+    init_threshold_interlocks(&threshold_itlks, threshold_itlks_entries,
+                              NUM_THRESHOLD_ITLKS);
+    init_threshold_interlocks(&capbank_undervoltage_itlks,
+                              capbank_undervoltage_itlks_entries,
+                              NUM_CAPBANK_UNDERVOLTAGE_ITLKS);
+
     init_control_framework(&g_controller_ctom);
 
     init_ipc();
@@ -658,9 +718,12 @@ static void init_controller(void)
     /** INITIALIZATION OF SCOPES **/
     /******************************/
 
-    init_scope(&SCOPE, ISR_CONTROL_FREQ, SCOPE_FREQ_SAMPLING_PARAM[0],
-               &g_buf_samples_ctom[0], SIZE_BUF_SAMPLES_CTOM,
-               SCOPE_SOURCE_PARAM[0], &run_scope_shared_ram);
+    init_scope_arena(&g_scope_arena_ctom, g_buf_samples_ctom,
+                     SIZE_BUF_SAMPLES_CTOM);
+
+    alloc_scope(&g_scope_arena_ctom, &SCOPE, ISR_CONTROL_FREQ,
+                SCOPE_FREQ_SAMPLING_PARAM[0], SIZE_BUF_SAMPLES_CTOM,
+                SCOPE_SOURCE_PARAM[0], &run_scope_shared_ram);
 
     /**
      * Reset all internal variables
@@ -799,63 +862,36 @@ static interrupt void isr_init_controller(void)
 static interrupt void isr_controller(void)
 {
     static float temp[4];
-    static uint16_t i;
 
     //CLEAR_DEBUG_GPIO1;
     SET_DEBUG_GPIO0;
     SET_DEBUG_GPIO1;
 
-    temp[0] = 0.0;
-    temp[1] = 0.0;
-    temp[2] = 0.0;
-    temp[3] = 0.0;
-
-    /// Get HRADC samples
-    for(i = 0; i < decimation_factor; i++)
-    {
-        temp[0] += (float) *(HRADCs_Info.HRADC_boards[0].SamplesBuffer++);
-        temp[1] += (float) *(HRADCs_Info.HRADC_boards[1].SamplesBuffer++);
-        temp[2] += (float) *(HRADCs_Info.HRADC_boards[2].SamplesBuffer++);
-        temp[3] += (float) *(HRADCs_Info.HRADC_boards[3].SamplesBuffer++);
-    }
-
-    //CLEAR_DEBUG_GPIO1;
-
-    HRADCs_Info.HRADC_boards[0].SamplesBuffer = buffers_HRADC[0];
-    HRADCs_Info.HRADC_boards[1].SamplesBuffer = buffers_HRADC[1];
-    HRADCs_Info.HRADC_boards[2].SamplesBuffer = buffers_HRADC[2];
-    HRADCs_Info.HRADC_boards[3].SamplesBuffer = buffers_HRADC[3];
-
-    temp[0] *= HRADCs_Info.HRADC_boards[0].gain * decimation_coeff;
-    temp[0] += HRADCs_Info.HRADC_boards[0].offset;
-
-    temp[1] *= HRADCs_Info.HRADC_boards[1].gain * decimation_coeff;
-    temp[1] += HRADCs_Info.HRADC_boards[1].offset;
-
-    temp[2] *= HRADCs_Info.HRADC_boards[2].gain * decimation_coeff;
-    temp[2] += HRADCs_Info.HRADC_boards[2].offset;
-
-    temp[3] *= HRADCs_Info.HRADC_boards[3].gain * decimation_coeff;
-    temp[3] += HRADCs_Info.HRADC_boards[3].offset;
+    /// Get calibrated HRADC samples
+    Get_HRADC_Samples(temp);
 
     if(NUM_DCCTs)
     {
-        I_LOAD_1 = temp[0];
-        I_LOAD_2 = temp[1];
+        I_LOAD_1 = run_sample_check(&g_integrity.check[0], temp[0]);
+        I_LOAD_2 = run_sample_check(&g_integrity.check[1], temp[1]);
         I_ARM_1 = temp[2];
         I_ARM_2 = temp[3];
 
-        I_LOAD_MEAN = 0.5*(I_LOAD_1 + I_LOAD_2);
+        /// Falls back to healthy DCCT while the other one is rejected
+        I_LOAD_MEAN = run_vote(&g_integrity.vote, &g_integrity.check[0],
+                               &g_integrity.check[1]);
         I_LOAD_DIFF = I_LOAD_1 - I_LOAD_2;
+        i_load_mean_raw = 0.5 * (temp[0] + temp[1]);
     }
     else
     {
-        I_LOAD_1 = temp[0];
+        I_LOAD_1 = run_sample_check(&g_integrity.check[0], temp[0]);
         I_ARM_1 = temp[1];
         I_ARM_2 = temp[2];
 
         I_LOAD_MEAN = I_LOAD_1;
         I_LOAD_DIFF = 0;
+        i_load_mean_raw = temp[0];
     }
 
     run_dsp_iir_2p2z(IIR_2P2Z_LPF_V_CAPBANK_ARM_1);
@@ -959,6 +995,9 @@ static interrupt void isr_controller(void)
                           WFMREF.wfmref_data[WFMREF.wfmref_selected].p_buf_start);
 
     RUN_SCOPE(SCOPE);
+
+    run_ipc_snapshot();
+    run_postmortem(&g_postmortem);
     //CLEAR_DEBUG_GPIO1;
 
     SET_INTERLOCKS_TIMEBASE_FLAG(0);
@@ -1024,7 +1063,7 @@ static void turn_on(uint16_t dummy)
         {
         #endif
 
-            check_capbank_undervoltage();
+            run_threshold_interlocks(0, &capbank_undervoltage_itlks);
 
             #ifdef USE_ITLK
             if(g_ipc_ctom.ps_module[0].ps_status.bit.state == Initializing)
@@ -1102,30 +1141,7 @@ static void reset_interlocks(uint16_t dummy)
  */
 static inline void check_interlocks(void)
 {
-    if(fabs(I_LOAD_MEAN) > MAX_ILOAD)
-    {
-        set_hard_interlock(0, Load_Overcurrent);
-    }
-
-    if(fabs(I_LOAD_DIFF) > MAX_DCCTS_DIFF)
-    {
-        set_soft_interlock(0, DCCT_High_Difference);
-    }
-
-    if(fabs(I_ARM_1) > MAX_I_ARM)
-    {
-        set_soft_interlock(0, ARM_1_Overcurrent);
-    }
-
-    if(fabs(I_ARM_2) > MAX_I_ARM)
-    {
-        set_soft_interlock(0, ARM_2_Overcurrent);
-    }
-
-    if(fabs(I_ARMS_DIFF) > MAX_I_ARMS_DIFF)
-    {
-        set_soft_interlock(0, Arms_High_Difference);
-    }
+    run_threshold_interlocks(0, &threshold_itlks);
 
     if(!PIN_STATUS_DCCT_1_STATUS)
     {
@@ -1170,13 +1186,11 @@ static inline void check_interlocks(void)
         }
     }
 
-    check_capbank_overvoltage();
-
     DINT;
 
     if(g_ipc_ctom.ps_module[0].ps_status.bit.state > Interlock)
     {
-        check_capbank_undervoltage();
+        run_threshold_interlocks(0, &capbank_undervoltage_itlks);
 
         if(PIN_STATUS_COMPLEMENTARY_PS_INTERLOCK)
         {
@@ -1209,92 +1223,6 @@ static inline void check_interlocks(void)
     }
 }
 
-static inline void check_capbank_undervoltage(void)
-{
-    if(V_CAPBANK_MOD_1 < MIN_V_CAPBANK)
-    {
-        set_hard_interlock(0, Module_1_CapBank_Undervoltage);
-    }
-
-    if(V_CAPBANK_MOD_2 < MIN_V_CAPBANK)
-    {
-        set_hard_interlock(0, Module_2_CapBank_Undervoltage);
-    }
-
-    if(V_CAPBANK_MOD_3 < MIN_V_CAPBANK)
-    {
-        set_hard_interlock(0, Module_3_CapBank_Undervoltage);
-    }
-
-    if(V_CAPBANK_MOD_4 < MIN_V_CAPBANK)
-    {
-        set_hard_interlock(0, Module_4_CapBank_Undervoltage);
-    }
-
-    if(V_CAPBANK_MOD_5 < MIN_V_CAPBANK)
-    {
-        set_hard_interlock(0, Module_5_CapBank_Undervoltage);
-    }
-
-    if(V_CAPBANK_MOD_6 < MIN_V_CAPBANK)
-    {
-        set_hard_interlock(0, Module_6_CapBank_Undervoltage);
-    }
-
-    if(V_CAPBANK_MOD_7 < MIN_V_CAPBANK)
-    {
-        set_hard_interlock(0, Module_7_CapBank_Undervoltage);
-    }
-
-    if(V_CAPBANK_MOD_8 < MIN_V_CAPBANK)
-    {
-        set_hard_interlock(0, Module_8_CapBank_Undervoltage);
-    }
-}
-
-static inline void check_capbank_overvoltage(void)
-{
-    if(V_CAPBANK_MOD_1 > MAX_V_CAPBANK)
-    {
-        set_hard_interlock(0, Module_1_CapBank_Overvoltage);
-    }
-
-    if(V_CAPBANK_MOD_2 > MAX_V_CAPBANK)
-    {
-        set_hard_interlock(0, Module_2_CapBank_Overvoltage);
-    }
-
-    if(V_CAPBANK_MOD_3 > MAX_V_CAPBANK)
-    {
-        set_hard_interlock(0, Module_3_CapBank_Overvoltage);
-    }
-
-    if(V_CAPBANK_MOD_4 > MAX_V_CAPBANK)
-    {
-        set_hard_interlock(0, Module_4_CapBank_Overvoltage);
-    }
-
-    if(V_CAPBANK_MOD_5 > MAX_V_CAPBANK)
-    {
-        set_hard_interlock(0, Module_5_CapBank_Overvoltage);
-    }
-
-    if(V_CAPBANK_MOD_6 > MAX_V_CAPBANK)
-    {
-        set_hard_interlock(0, Module_6_CapBank_Overvoltage);
-    }
-
-    if(V_CAPBANK_MOD_7 > MAX_V_CAPBANK)
-    {
-        set_hard_interlock(0, Module_7_CapBank_Overvoltage);
-    }
-
-    if(V_CAPBANK_MOD_8 > MAX_V_CAPBANK)
-    {
-        set_hard_interlock(0, Module_8_CapBank_Overvoltage);
-    }
-}
-
 /**
  * Configure specified PWM module to generate inverted PWM pulses (active on
  * LOW). This is used to generate 8x Q2 signals for the 8 DC/DC modules.
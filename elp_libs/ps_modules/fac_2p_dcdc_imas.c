@@ -40,11 +40,13 @@
 #include "boards/udc_c28.h"
 #include "common/structs.h"
 #include "common/timeslicer.h"
+#include "common/timestamp.h"
 #include "control/control.h"
 #include "event_manager/event_manager.h"
 #include "HRADC_board/HRADC_Boards.h"
 #include "ipc/ipc.h"
 #include "parameters/parameters.h"
+#include "postmortem/postmortem.h"
 #include "pwm/pwm.h"
 
 #include "fac_2p_dcdc_imas.h"
@@ -199,7 +201,6 @@ typedef enum
  *  Private variables
  */
 static uint16_t decimation_factor;
-static float decimation_coeff;
 
 /**
  * Private functions
@@ -244,6 +245,7 @@ void main_fac_2p_dcdc_imas(void)
     while(1)
     {
         check_interlocks();
+        Run_HRADC_Offline_Calibration();
     }
 
     turn_off(0);
@@ -265,7 +267,6 @@ static void init_peripherals_drivers(void)
     stop_DMA();
 
     decimation_factor = (uint16_t) roundf(HRADC_FREQ_SAMP / ISR_CONTROL_FREQ);
-    decimation_coeff = 1.0 / (float) decimation_factor;
 
     HRADCs_Info.enable_Sampling = 0;
     HRADCs_Info.n_HRADC_boards = NUM_HRADC_BOARDS;
@@ -276,19 +277,17 @@ static void init_peripherals_drivers(void)
     Init_SPIMaster_Gpio();
     InitMcbspa20bit();
 
-    DELAY_US(500000);
-    send_ipc_lowpriority_msg(0,Enable_HRADC_Boards);
-    DELAY_US(2000000);
-
     for(i = 0; i < NUM_HRADC_BOARDS; i++)
     {
-        Init_HRADC_Info(&HRADCs_Info.HRADC_boards[i], i, decimation_factor,
-                        buffers_HRADC[i], TRANSDUCER_GAIN[i]);
-        Config_HRADC_board(&HRADCs_Info.HRADC_boards[i], TRANSDUCER_OUTPUT_TYPE[i],
-                           HRADC_HEATER_ENABLE[i], HRADC_MONITOR_ENABLE[i]);
+        Request_HRADC_board(i, decimation_factor, buffers_HRADC[0][i], TRANSDUCER_GAIN[i],
+                            TRANSDUCER_OUTPUT_TYPE[i], HRADC_HEATER_ENABLE[i],
+                            HRADC_MONITOR_ENABLE[i]);
     }
 
+    Bringup_HRADC_boards(NUM_HRADC_BOARDS);
+
     Config_HRADC_SoC(HRADC_FREQ_SAMP);
+    Update_HRADC_Calibration();
 
     /**
      * Initialization of PWM modules. PWM signals are mapped as the following:
@@ -335,6 +334,7 @@ static void init_peripherals_drivers(void)
 
     /// Initialization of timers
     InitCpuTimers();
+    init_timestamp();
     ConfigCpuTimer(&CpuTimer0, C28_FREQ_MHZ, 1000000);
     CpuTimer0Regs.TCR.bit.TIE = 0;
 }
@@ -358,6 +358,11 @@ static void init_controller(void)
     g_ipc_ctom.ps_module[2].ps_status.all = 0;
     g_ipc_ctom.ps_module[3].ps_status.all = 0;
 
+    init_soe();
+    reset_itlk_latency();
+    init_postmortem(&g_postmortem, POSTMORTEM_DECIMATION,
+                    POSTMORTEM_POST_TRIGGER);
+
     init_event_manager(0, ISR_CONTROL_FREQ,
                        NUM_HARD_INTERLOCKS, NUM_SOFT_INTERLOCKS,
                        &HARD_INTERLOCKS_DEBOUNCE_TIME,
@@ -570,9 +575,12 @@ static void init_controller(void)
     /** INITIALIZATION OF SCOPES **/
     /******************************/
 
-    init_scope(&SCOPE, ISR_CONTROL_FREQ, SCOPE_FREQ_SAMPLING_PARAM[0],
-               &g_buf_samples_ctom[0], SIZE_BUF_SAMPLES_CTOM,
-               SCOPE_SOURCE_PARAM[0], &run_scope_shared_ram);
+    init_scope_arena(&g_scope_arena_ctom, g_buf_samples_ctom,
+                     SIZE_BUF_SAMPLES_CTOM);
+
+    alloc_scope(&g_scope_arena_ctom, &SCOPE, ISR_CONTROL_FREQ,
+                SCOPE_FREQ_SAMPLING_PARAM[0], SIZE_BUF_SAMPLES_CTOM,
+                SCOPE_SOURCE_PARAM[0], &run_scope_shared_ram);
 
     /**
      * Reset all internal variables
@@ -701,47 +709,17 @@ static interrupt void isr_init_controller(void)
 static interrupt void isr_controller(void)
 {
     static float temp[4];
-    static uint16_t i;
 
     //CLEAR_DEBUG_GPIO1;
     SET_DEBUG_GPIO0;
     SET_DEBUG_GPIO1;
 
-    temp[0] = 0.0;
-    temp[1] = 0.0;
-    temp[2] = 0.0;
-    temp[3] = 0.0;
-
-    /// Get HRADC samples
-    for(i = 0; i < decimation_factor; i++)
-    {
-        temp[0] += (float) *(HRADCs_Info.HRADC_boards[0].SamplesBuffer++);
-        temp[1] += (float) *(HRADCs_Info.HRADC_boards[1].SamplesBuffer++);
-        temp[2] += (float) *(HRADCs_Info.HRADC_boards[2].SamplesBuffer++);
-        temp[3] += (float) *(HRADCs_Info.HRADC_boards[3].SamplesBuffer++);
-    }
-
-    //CLEAR_DEBUG_GPIO1;
-
-    HRADCs_Info.HRADC_boards[0].SamplesBuffer = buffers_HRADC[0];
-    HRADCs_Info.HRADC_boards[1].SamplesBuffer = buffers_HRADC[1];
-    HRADCs_Info.HRADC_boards[2].SamplesBuffer = buffers_HRADC[2];
-    HRADCs_Info.HRADC_boards[3].SamplesBuffer = buffers_HRADC[3];
+    /// Get calibrated HRADC samples
+    Get_HRADC_Samples(temp);
 
-    temp[0] *= HRADCs_Info.HRADC_boards[0].gain * decimation_coeff;
-    temp[0] += HRADCs_Info.HRADC_boards[0].offset;
     temp[0] *= I_LOAD_CAL_GAIN;
     temp[0] += I_LOAD_CAL_OFFSET;
 
-    temp[1] *= HRADCs_Info.HRADC_boards[1].gain * decimation_coeff;
-    temp[1] += HRADCs_Info.HRADC_boards[1].offset;
-
-    temp[2] *= HRADCs_Info.HRADC_boards[2].gain * decimation_coeff;
-    temp[2] += HRADCs_Info.HRADC_boards[2].offset;
-
-    temp[3] *= HRADCs_Info.HRADC_boards[3].gain * decimation_coeff;
-    temp[3] += HRADCs_Info.HRADC_boards[3].offset;
-
     I_LOAD = temp[0];
     V_CAPBANK_MOD_1 = temp[1];
     V_CAPBANK_MOD_2 = temp[2];
@@ -840,6 +818,9 @@ static interrupt void isr_controller(void)
 
     RUN_SCOPE(SCOPE);
 
+    run_ipc_snapshot();
+    run_postmortem(&g_postmortem);
+
     SET_INTERLOCKS_TIMEBASE_FLAG(0);
 
     PWM_MODULATOR_MOD_1->ETCLR.bit.INT = 1;
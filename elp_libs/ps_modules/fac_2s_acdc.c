@@ -26,11 +26,13 @@
 #include "boards/udc_c28.h"
 #include "common/structs.h"
 #include "common/timeslicer.h"
+#include "common/timestamp.h"
 #include "control/control.h"
 #include "event_manager/event_manager.h"
 #include "HRADC_board/HRADC_Boards.h"
 #include "ipc/ipc.h"
 #include "parameters/parameters.h"
+#include "postmortem/postmortem.h"
 #include "pwm/pwm.h"
 
 #include "fac_2s_acdc.h"
@@ -209,7 +211,6 @@ typedef enum
  *  Private variables
  */
 static float decimation_factor;
-static float decimation_coeff;
 
 /**
  * Private functions
@@ -256,6 +257,7 @@ void main_fac_2s_acdc(void)
     while(1)
     {
         check_interlocks();
+        Run_HRADC_Offline_Calibration();
     }
 
     turn_off(0);
@@ -274,7 +276,6 @@ static void init_peripherals_drivers(void)
     stop_DMA();
 
     decimation_factor = HRADC_FREQ_SAMP / ISR_CONTROL_FREQ;
-    decimation_coeff = 1.0 / decimation_factor;
 
 
     HRADCs_Info.enable_Sampling = 0;
@@ -286,19 +287,17 @@ static void init_peripherals_drivers(void)
     Init_SPIMaster_Gpio();
     InitMcbspa20bit();
 
-    DELAY_US(500000);
-    send_ipc_lowpriority_msg(0,Enable_HRADC_Boards);
-    DELAY_US(2000000);
-
     for(i = 0; i < NUM_HRADC_BOARDS; i++)
     {
-        Init_HRADC_Info(&HRADCs_Info.HRADC_boards[i], i, decimation_factor,
-                        buffers_HRADC[i], TRANSDUCER_GAIN[i]);
-        Config_HRADC_board(&HRADCs_Info.HRADC_boards[i], TRANSDUCER_OUTPUT_TYPE[i],
-                           HRADC_HEATER_ENABLE[i], HRADC_MONITOR_ENABLE[i]);
+        Request_HRADC_board(i, decimation_factor, buffers_HRADC[0][i], TRANSDUCER_GAIN[i],
+                            TRANSDUCER_OUTPUT_TYPE[i], HRADC_HEATER_ENABLE[i],
+                            HRADC_MONITOR_ENABLE[i]);
     }
 
+    Bringup_HRADC_boards(NUM_HRADC_BOARDS);
+
     Config_HRADC_SoC(HRADC_FREQ_SAMP);
+    Update_HRADC_Calibration();
 
     /// Initialization of PWM modules
     g_pwm_modules.num_modules = 2;
@@ -322,6 +321,7 @@ static void init_peripherals_drivers(void)
 
     /// Initialization of timers
     InitCpuTimers();
+    init_timestamp();
     ConfigCpuTimer(&CpuTimer0, C28_FREQ_MHZ, 1000000);
     CpuTimer0Regs.TCR.bit.TIE = 0;
 }
@@ -349,6 +349,11 @@ static void init_controller(void)
     g_ipc_ctom.ps_module[2].ps_status.all = 0;
     g_ipc_ctom.ps_module[3].ps_status.all = 0;
 
+    init_soe();
+    reset_itlk_latency();
+    init_postmortem(&g_postmortem, POSTMORTEM_DECIMATION,
+                    POSTMORTEM_POST_TRIGGER);
+
     init_event_manager(0, ISR_CONTROL_FREQ,
                        NUM_HARD_INTERLOCKS, NUM_SOFT_INTERLOCKS,
                        &HARD_INTERLOCKS_DEBOUNCE_TIME,
@@ -400,13 +405,16 @@ static void init_controller(void)
     /** INITIALIZATION OF SCOPES **/
     /******************************/
 
-    init_scope(&SCOPE_MOD_A, ISR_CONTROL_FREQ, SCOPE_FREQ_SAMPLING_PARAM[MOD_A_ID],
-               &g_buf_samples_ctom[0], SIZE_BUF_SAMPLES_CTOM/2,
-               SCOPE_SOURCE_PARAM[MOD_A_ID], &run_scope_shared_ram);
+    init_scope_arena(&g_scope_arena_ctom, g_buf_samples_ctom,
+                     SIZE_BUF_SAMPLES_CTOM);
+
+    alloc_scope(&g_scope_arena_ctom, &SCOPE_MOD_A, ISR_CONTROL_FREQ,
+                SCOPE_FREQ_SAMPLING_PARAM[MOD_A_ID], SIZE_BUF_SAMPLES_CTOM/2,
+                SCOPE_SOURCE_PARAM[MOD_A_ID], &run_scope_shared_ram);
 
-    init_scope(&SCOPE_MOD_B, ISR_CONTROL_FREQ, SCOPE_FREQ_SAMPLING_PARAM[MOD_B_ID],
-               &g_buf_samples_ctom[SIZE_BUF_SAMPLES_CTOM/2], SIZE_BUF_SAMPLES_CTOM/2,
-               SCOPE_SOURCE_PARAM[MOD_B_ID], &run_scope_shared_ram);
+    alloc_scope(&g_scope_arena_ctom, &SCOPE_MOD_B, ISR_CONTROL_FREQ,
+                SCOPE_FREQ_SAMPLING_PARAM[MOD_B_ID], SIZE_BUF_SAMPLES_CTOM/2,
+                SCOPE_SOURCE_PARAM[MOD_B_ID], &run_scope_shared_ram);
 
     /**
      * Reset all internal variables
@@ -499,43 +507,12 @@ static interrupt void isr_init_controller(void)
 static interrupt void isr_controller(void)
 {
     static float temp[4];
-    static uint16_t i;
 
     SET_DEBUG_GPIO0;
     SET_DEBUG_GPIO1;
 
-    temp[0] = 0.0;
-    temp[1] = 0.0;
-    temp[2] = 0.0;
-    temp[3] = 0.0;
-
-    /// Get HRADC samples
-    for(i = 0; i < decimation_factor; i++)
-    {
-        temp[0] += (float) *(HRADCs_Info.HRADC_boards[0].SamplesBuffer++);
-        temp[1] += (float) *(HRADCs_Info.HRADC_boards[1].SamplesBuffer++);
-        temp[2] += (float) *(HRADCs_Info.HRADC_boards[2].SamplesBuffer++);
-        temp[3] += (float) *(HRADCs_Info.HRADC_boards[3].SamplesBuffer++);
-    }
-
-    //CLEAR_DEBUG_GPIO1;
-
-    HRADCs_Info.HRADC_boards[0].SamplesBuffer = buffers_HRADC[0];
-    HRADCs_Info.HRADC_boards[1].SamplesBuffer = buffers_HRADC[1];
-    HRADCs_Info.HRADC_boards[2].SamplesBuffer = buffers_HRADC[2];
-    HRADCs_Info.HRADC_boards[3].SamplesBuffer = buffers_HRADC[3];
-
-    temp[0] *= HRADCs_Info.HRADC_boards[0].gain * decimation_coeff;
-    temp[0] += HRADCs_Info.HRADC_boards[0].offset;
-
-    temp[1] *= HRADCs_Info.HRADC_boards[1].gain * decimation_coeff;
-    temp[1] += HRADCs_Info.HRADC_boards[1].offset;
-
-    temp[2] *= HRADCs_Info.HRADC_boards[2].gain * decimation_coeff;
-    temp[2] += HRADCs_Info.HRADC_boards[2].offset;
-
-    temp[3] *= HRADCs_Info.HRADC_boards[3].gain * decimation_coeff;
-    temp[3] += HRADCs_Info.HRADC_boards[3].offset;
+    /// Get calibrated HRADC samples
+    Get_HRADC_Samples(temp);
 
     V_CAPBANK_MOD_A = temp[0];
     I_OUT_RECT_MOD_A = temp[1];
@@ -629,6 +606,9 @@ static interrupt void isr_controller(void)
     RUN_SCOPE(SCOPE_MOD_A);
     RUN_SCOPE(SCOPE_MOD_B);
 
+    run_ipc_snapshot();
+    run_postmortem(&g_postmortem);
+
     SET_INTERLOCKS_TIMEBASE_FLAG(0);
     SET_INTERLOCKS_TIMEBASE_FLAG(1);
 
@@ -23,13 +23,17 @@
 #include <float.h>
 
 #include "boards/udc_c28.h"
+#include "common/integrity.h"
+#include "common/statistics.h"
 #include "common/structs.h"
 #include "common/timeslicer.h"
+#include "common/timestamp.h"
 #include "control/control.h"
 #include "event_manager/event_manager.h"
 #include "HRADC_board/HRADC_Boards.h"
 #include "ipc/ipc.h"
 #include "parameters/parameters.h"
+#include "postmortem/postmortem.h"
 #include "pwm/pwm.h"
 
 #include "fap.h"
@@ -41,6 +45,12 @@
 #define TIMESLICER_I_SHARE_CONTROLLER       g_controller_ctom.timeslicer[TIMESLICER_I_SHARE_CONTROLLER_IDX]
 #define I_SHARE_CONTROLLER_FREQ_SAMP        TIMESLICER_FREQ[TIMESLICER_I_SHARE_CONTROLLER_IDX]
 
+/**
+ * DC-link voltage must be above minimum during a whole window of this tracker
+ * before PWM is enabled, so it's settled after contactor is closed
+ */
+#define STATS_V_DCLINK_FREQ_SAMP            1000.0
+
 /**
  * Analog variables parameters
  */
@@ -194,7 +204,10 @@ typedef enum
  *  Private variables
  */
 static uint16_t decimation_factor;
-static float decimation_coeff;
+static stats_t stats_v_dclink;
+
+/// Load current from raw samples, for overcurrent protection
+static volatile float i_load_mean_raw;
 
 /**
  * Private functions
@@ -240,6 +253,7 @@ void main_fap(void)
     while(1)
     {
         check_interlocks();
+        Run_HRADC_Offline_Calibration();
     }
 
     turn_off(0);
@@ -258,7 +272,6 @@ static void init_peripherals_drivers(void)
     stop_DMA();
 
     decimation_factor = (uint16_t) roundf(HRADC_FREQ_SAMP / ISR_CONTROL_FREQ);
-    decimation_coeff = 1.0 / (float) decimation_factor;
 
 
     HRADCs_Info.enable_Sampling = 0;
@@ -270,19 +283,17 @@ static void init_peripherals_drivers(void)
     Init_SPIMaster_Gpio();
     InitMcbspa20bit();
 
-    DELAY_US(500000);
-    send_ipc_lowpriority_msg(0,Enable_HRADC_Boards);
-    DELAY_US(2000000);
-
     for(i = 0; i < NUM_HRADC_BOARDS; i++)
     {
-        Init_HRADC_Info(&HRADCs_Info.HRADC_boards[i], i, decimation_factor,
-                        buffers_HRADC[i], TRANSDUCER_GAIN[i]);
-        Config_HRADC_board(&HRADCs_Info.HRADC_boards[i], TRANSDUCER_OUTPUT_TYPE[i],
-                           HRADC_HEATER_ENABLE[i], HRADC_MONITOR_ENABLE[i]);
+        Request_HRADC_board(i, decimation_factor, buffers_HRADC[0][i], TRANSDUCER_GAIN[i],
+                            TRANSDUCER_OUTPUT_TYPE[i], HRADC_HEATER_ENABLE[i],
+                            HRADC_MONITOR_ENABLE[i]);
     }
 
+    Bringup_HRADC_boards(NUM_HRADC_BOARDS);
+
     Config_HRADC_SoC(HRADC_FREQ_SAMP);
+    Update_HRADC_Calibration();
 
     /// Initialization of PWM modules
     g_pwm_modules.num_modules = 2;
@@ -305,6 +316,7 @@ static void init_peripherals_drivers(void)
 
     /// Initialization of timers
     InitCpuTimers();
+    init_timestamp();
     ConfigCpuTimer(&CpuTimer0, C28_FREQ_MHZ, 1000000);
     CpuTimer0Regs.TCR.bit.TIE = 0;
 }
@@ -328,6 +340,12 @@ static void init_controller(void)
     g_ipc_ctom.ps_module[2].ps_status.all = 0;
     g_ipc_ctom.ps_module[3].ps_status.all = 0;
 
+    init_soe();
+    reset_itlk_latency();
+    init_postmortem(&g_postmortem, POSTMORTEM_DECIMATION,
+                    POSTMORTEM_POST_TRIGGER);
+    init_integrity(&g_integrity);
+
     init_event_manager(0, ISR_CONTROL_FREQ,
                        NUM_HARD_INTERLOCKS, NUM_SOFT_INTERLOCKS,
                        &HARD_INTERLOCKS_DEBOUNCE_TIME,
@@ -506,9 +524,15 @@ static void init_controller(void)
     /** INITIALIZATION OF SCOPES **/
     /******************************/
 
-    init_scope(&SCOPE, ISR_CONTROL_FREQ, SCOPE_FREQ_SAMPLING_PARAM[0],
-               &g_buf_samples_ctom[0], SIZE_BUF_SAMPLES_CTOM,
-               SCOPE_SOURCE_PARAM[0], &run_scope_shared_ram);
+    init_scope_arena(&g_scope_arena_ctom, g_buf_samples_ctom,
+                     SIZE_BUF_SAMPLES_CTOM);
+
+    alloc_scope(&g_scope_arena_ctom, &SCOPE, ISR_CONTROL_FREQ,
+                SCOPE_FREQ_SAMPLING_PARAM[0], SIZE_BUF_SAMPLES_CTOM,
+                SCOPE_SOURCE_PARAM[0], &run_scope_shared_ram);
+
+    init_stats(&stats_v_dclink, ISR_CONTROL_FREQ, STATS_V_DCLINK_FREQ_SAMP,
+               STATS_MAX_WINDOW_SIZE, &V_DCLINK);
 
     /**
      * Reset all internal variables
@@ -594,65 +618,38 @@ static interrupt void isr_init_controller(void)
 static interrupt void isr_controller(void)
 {
     static float temp[4];
-    static uint16_t i;
 
 
     //CLEAR_DEBUG_GPIO1;
     SET_DEBUG_GPIO0;
     SET_DEBUG_GPIO1;
 
-    temp[0] = 0.0;
-    temp[1] = 0.0;
-    temp[2] = 0.0;
-    temp[3] = 0.0;
-
-    /// Get HRADC samples
-    for(i = 0; i < decimation_factor; i++)
-    {
-        temp[0] += (float) *(HRADCs_Info.HRADC_boards[0].SamplesBuffer++);
-        temp[1] += (float) *(HRADCs_Info.HRADC_boards[1].SamplesBuffer++);
-        temp[2] += (float) *(HRADCs_Info.HRADC_boards[2].SamplesBuffer++);
-        temp[3] += (float) *(HRADCs_Info.HRADC_boards[3].SamplesBuffer++);
-    }
-
-    //CLEAR_DEBUG_GPIO1;
-
-    HRADCs_Info.HRADC_boards[0].SamplesBuffer = buffers_HRADC[0];
-    HRADCs_Info.HRADC_boards[1].SamplesBuffer = buffers_HRADC[1];
-    HRADCs_Info.HRADC_boards[2].SamplesBuffer = buffers_HRADC[2];
-    HRADCs_Info.HRADC_boards[3].SamplesBuffer = buffers_HRADC[3];
-
-    temp[0] *= HRADCs_Info.HRADC_boards[0].gain * decimation_coeff;
-    temp[0] += HRADCs_Info.HRADC_boards[0].offset;
-
-    temp[1] *= HRADCs_Info.HRADC_boards[1].gain * decimation_coeff;
-    temp[1] += HRADCs_Info.HRADC_boards[1].offset;
-
-    temp[2] *= HRADCs_Info.HRADC_boards[2].gain * decimation_coeff;
-    temp[2] += HRADCs_Info.HRADC_boards[2].offset;
-
-    temp[3] *= HRADCs_Info.HRADC_boards[3].gain * decimation_coeff;
-    temp[3] += HRADCs_Info.HRADC_boards[3].offset;
+    /// Get calibrated HRADC samples
+    Get_HRADC_Samples(temp);
 
     if(NUM_DCCTs)
     {
-        I_LOAD_1 = temp[0];
-        I_LOAD_2 = temp[1];
+        I_LOAD_1 = run_sample_check(&g_integrity.check[0], temp[0]);
+        I_LOAD_2 = run_sample_check(&g_integrity.check[1], temp[1]);
         V_DCLINK = temp[2];
         g_controller_ctom.net_signals[20].f = temp[2];
 
-        I_LOAD_MEAN = 0.5*(I_LOAD_1 + I_LOAD_2);
+        /// Falls back to healthy DCCT while the other one is rejected
+        I_LOAD_MEAN = run_vote(&g_integrity.vote, &g_integrity.check[0],
+                               &g_integrity.check[1]);
         I_LOAD_DIFF = I_LOAD_1 - I_LOAD_2;
+        i_load_mean_raw = 0.5 * (temp[0] + temp[1]);
     }
     else
     {
-        I_LOAD_1 = temp[0];
+        I_LOAD_1 = run_sample_check(&g_integrity.check[0], temp[0]);
         V_DCLINK = temp[1];
         g_controller_ctom.net_signals[20].f = temp[2];
         g_controller_ctom.net_signals[21].f = temp[3];
 
         I_LOAD_MEAN = I_LOAD_1;
         I_LOAD_DIFF = 0;
+        i_load_mean_raw = temp[0];
     }
 
     I_IGBTS_DIFF = I_IGBT_1 - I_IGBT_2;
@@ -741,6 +738,10 @@ static interrupt void isr_controller(void)
     }
 
     RUN_SCOPE(SCOPE);
+    RUN_STATS(stats_v_dclink);
+
+    run_ipc_snapshot();
+    run_postmortem(&g_postmortem);
 
     SET_INTERLOCKS_TIMEBASE_FLAG(0);
 
@@ -893,7 +894,8 @@ static inline void check_interlocks(void)
 {
     //SET_DEBUG_GPIO1;
 
-    if(fabs(I_LOAD_MEAN) > MAX_ILOAD)
+    /// Checked samples could hold back a real fault current
+    if(fabs(i_load_mean_raw) > MAX_ILOAD)
     {
         set_hard_interlock(0, Load_Overcurrent);
     }
@@ -984,7 +986,8 @@ static inline void check_interlocks(void)
 
         if(g_ipc_ctom.ps_module[0].ps_status.bit.state == Initializing)
         {
-            if(V_DCLINK > MIN_V_DCLINK)
+            if( (stats_v_dclink.num_samples == stats_v_dclink.size) &&
+                (get_min_stats(&stats_v_dclink) > MIN_V_DCLINK) )
             {
                 g_ipc_ctom.ps_module[0].ps_status.bit.state = SlowRef;
                 enable_pwm_output(0);
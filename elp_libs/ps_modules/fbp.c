@@ -25,11 +25,14 @@
 
 #include "boards/udc_c28.h"
 #include "common/timeslicer.h"
+#include "common/timestamp.h"
 #include "control/control.h"
 #include "event_manager/event_manager.h"
+#include "fastref/fastref.h"
 #include "HRADC_board/HRADC_Boards.h"
 #include "ipc/ipc.h"
 #include "parameters/parameters.h"
+#include "postmortem/postmortem.h"
 #include "pwm/pwm.h"
 
 #include "fbp.h"
@@ -55,6 +58,10 @@
 #define WFMREF                  g_ipc_ctom.wfmref
 #define WFMREF_OUTPUT           g_controller_ctom.net_signals[13].f
 
+#define FASTREF                 g_fastref
+#define FASTREF_RING            g_fastref_ring
+#define FASTREF_FREQ_PRODUCER   1000.0      // Nominal rate of setpoints [Hz]
+
 #define PS_SETPOINT(i)          g_ipc_ctom.ps_module[i].ps_setpoint
 #define PS_REFERENCE(i)         g_ipc_ctom.ps_module[i].ps_reference
 
@@ -211,6 +218,35 @@ typedef enum
 
 #define ISR_FREQ_INTERLOCK_TIMEBASE     5000.0
 
+/**
+ * Threshold interlocks table of each power supply:
+ *
+ *  {signal, min, max, hysteresis, use_abs, interlock, type}
+ */
+#define NUM_THRESHOLD_ITLKS             4
+
+#define THRESHOLD_ITLKS_PS(id)                                                  \
+{                                                                               \
+    {&g_controller_ctom.net_signals[id].f, 0, &MAX_ILOAD(id), 0.0, 1,           \
+     Load_Overcurrent, Threshold_Hard_Itlk},                                    \
+    {&g_controller_mtoc.net_signals[id].f, 0, &MAX_DCLINK(id), 0.0, 1,          \
+     DCLink_Overvoltage, Threshold_Hard_Itlk},                                  \
+    {&g_controller_mtoc.net_signals[id+4].f, 0, &MAX_VLOAD(id), 0.0, 1,         \
+     Load_Overvoltage, Threshold_Hard_Itlk},                                    \
+    {&g_controller_mtoc.net_signals[id+8].f, 0, &MAX_TEMP(id), 0.0, 1,          \
+     Heatsink_Overtemperature, Threshold_Soft_Itlk}                             \
+}
+
+static threshold_itlk_t threshold_itlks_ps[NUM_MAX_PS_MODULES][NUM_THRESHOLD_ITLKS] =
+{
+    THRESHOLD_ITLKS_PS(0),
+    THRESHOLD_ITLKS_PS(1),
+    THRESHOLD_ITLKS_PS(2),
+    THRESHOLD_ITLKS_PS(3)
+};
+
+static threshold_itlks_t threshold_itlks[NUM_MAX_PS_MODULES];
+
 
 /**
  * Private functions
@@ -274,6 +310,8 @@ void main_fbp(void)
                 check_interlocks_ps_module(i);
             }
         }
+
+        Run_HRADC_Offline_Calibration();
     }
 
     for(i = 0; i < NUM_MAX_PS_MODULES; i++)
@@ -302,21 +340,22 @@ static void init_peripherals_drivers(void)
     Init_SPIMaster_Gpio();
     InitMcbspa20bit();
 
-    DELAY_US(500000);
-    send_ipc_lowpriority_msg(0,Enable_HRADC_Boards);
-    DELAY_US(2000000);
-
     for(i = 0; i < NUM_PS_MODULES; i++)
     {
-        Init_HRADC_Info(&HRADCs_Info.HRADC_boards[i], i, DECIMATION_FACTOR,
-                        buffers_HRADC[i], TRANSDUCER_GAIN[i]);
-        Config_HRADC_board(&HRADCs_Info.HRADC_boards[i], TRANSDUCER_OUTPUT_TYPE[i],
-                           HRADC_HEATER_ENABLE[i], HRADC_MONITOR_ENABLE[i]);
+        Request_HRADC_board(i, DECIMATION_FACTOR, buffers_HRADC[0][i], TRANSDUCER_GAIN[i],
+                            TRANSDUCER_OUTPUT_TYPE[i], HRADC_HEATER_ENABLE[i],
+                            HRADC_MONITOR_ENABLE[i]);
+
+        /// Each module has its own board, so a failed one only blocks its module
+        Set_HRADC_Boards_PS(i, 1 << i);
     }
 
+    Bringup_HRADC_boards(NUM_PS_MODULES);
+
     HRADCs_Info.n_HRADC_boards = NUM_PS_MODULES;
 
     Config_HRADC_SoC(HRADC_FREQ_SAMP);
+    Update_HRADC_Calibration();
 
     /// Initialization of PWM modules
     g_pwm_modules.num_modules = 8;
@@ -372,6 +411,7 @@ static void init_peripherals_drivers(void)
 
     /// Initialization of timers
     InitCpuTimers();
+    init_timestamp();
     ConfigCpuTimer(&CpuTimer0, C28_FREQ_MHZ,
                    (1000000.0/ISR_FREQ_INTERLOCK_TIMEBASE));
     CpuTimer0Regs.TCR.bit.TIE = 0;
@@ -385,6 +425,14 @@ static void init_controller(void)
 {
     static uint16_t i;
 
+    init_scope_arena(&g_scope_arena_ctom, g_buf_samples_ctom,
+                     SIZE_BUF_SAMPLES_CTOM);
+
+    init_soe();
+    reset_itlk_latency();
+    init_postmortem(&g_postmortem, POSTMORTEM_DECIMATION,
+                    POSTMORTEM_POST_TRIGGER);
+
     for(i = 0; i < NUM_MAX_PS_MODULES; i++)
     {
         init_ps_module(&g_ipc_ctom.ps_module[i],
@@ -399,6 +447,9 @@ static void init_controller(void)
                            &SOFT_INTERLOCKS_DEBOUNCE_TIME,
                            &SOFT_INTERLOCKS_RESET_TIME);
 
+        init_threshold_interlocks(&threshold_itlks[i], threshold_itlks_ps[i],
+                                  NUM_THRESHOLD_ITLKS);
+
         if(!g_ipc_mtoc.ps_module[i].ps_status.bit.active)
         {
             g_ipc_ctom.ps_module[i].ps_status.bit.active = 0;
@@ -409,11 +460,10 @@ static void init_controller(void)
                     WFMREF_OFFSET_PARAM[i], &g_wfmref_data.data_fbp[i],
                     SIZE_WFMREF_FBP, &PS_REFERENCE(i));
 
-        init_scope(&SCOPE_CTOM[i], ISR_CONTROL_FREQ,
-                   SCOPE_FREQ_SAMPLING_PARAM[i],
-                   &g_buf_samples_ctom[SIZE_BUF_SAMPLES_CTOM * i / NUM_MAX_PS_MODULES],
-                   SIZE_BUF_SAMPLES_CTOM / NUM_MAX_PS_MODULES,
-                   SCOPE_SOURCE_PARAM[i], &run_scope_shared_ram);
+        alloc_scope(&g_scope_arena_ctom, &SCOPE_CTOM[i], ISR_CONTROL_FREQ,
+                    SCOPE_FREQ_SAMPLING_PARAM[i],
+                    SIZE_BUF_SAMPLES_CTOM / NUM_MAX_PS_MODULES,
+                    SCOPE_SOURCE_PARAM[i], &run_scope_shared_ram);
 
         /// Initialization of signal generator module
         disable_siggen(&SIGGEN[i]);
@@ -425,6 +475,11 @@ static void init_controller(void)
                    SIGGEN_OFFSET_PARAM, SIGGEN_AUX_PARAM);
     }
 
+    /// Initialization of fast references module
+    init_fastref(&FASTREF, &FASTREF_RING,
+                 get_fastref_latency(ISR_CONTROL_FREQ, FASTREF_FREQ_PRODUCER),
+                 FastRef_Linear);
+
     init_control_framework(&g_controller_ctom);
 
     init_ipc();
@@ -633,29 +688,17 @@ static interrupt void isr_controller(void)
     SET_DEBUG_GPIO0;
     SET_DEBUG_GPIO1;
 
-    /// Get HRADC samples
-    temp[0] = (float) *(HRADCs_Info.HRADC_boards[0].SamplesBuffer);
-    temp[1] = (float) *(HRADCs_Info.HRADC_boards[1].SamplesBuffer);
-    temp[2] = (float) *(HRADCs_Info.HRADC_boards[2].SamplesBuffer);
-    temp[3] = (float) *(HRADCs_Info.HRADC_boards[3].SamplesBuffer);
-
-    temp[0] *= HRADCs_Info.HRADC_boards[0].gain;
-    temp[0] += HRADCs_Info.HRADC_boards[0].offset;
-
-    temp[1] *= HRADCs_Info.HRADC_boards[1].gain;
-    temp[1] += HRADCs_Info.HRADC_boards[1].offset;
-
-    temp[2] *= HRADCs_Info.HRADC_boards[2].gain;
-    temp[2] += HRADCs_Info.HRADC_boards[2].offset;
-
-    temp[3] *= HRADCs_Info.HRADC_boards[3].gain;
-    temp[3] += HRADCs_Info.HRADC_boards[3].offset;
+    /// Get calibrated HRADC samples
+    Get_HRADC_Samples(temp);
 
     PS1_LOAD_CURRENT = temp[0];
     PS2_LOAD_CURRENT = temp[1];
     PS3_LOAD_CURRENT = temp[2];
     PS4_LOAD_CURRENT = temp[3];
 
+    /// Consume streamed setpoints for FastRef mode
+    run_fastref(&FASTREF, &FASTREF_RING);
+
     /// Loop through active power supplies
     for(i = 0; i < NUM_MAX_PS_MODULES; i++)
     {
@@ -680,6 +723,11 @@ static interrupt void isr_controller(void)
                         run_wfmref(&WFMREF[i]);
                         break;
                     }
+                    case FastRef:
+                    {
+                        PS_REFERENCE(i) = FASTREF.out[i];
+                        break;
+                    }
                     case Cycle:
                     {
                         SIGGEN[i].amplitude = SIGGEN_MTOC[i].amplitude;
@@ -732,6 +780,9 @@ static interrupt void isr_controller(void)
     RUN_SCOPE(PS3_SCOPE);
     RUN_SCOPE(PS4_SCOPE);
 
+    run_ipc_snapshot();
+    run_postmortem(&g_postmortem);
+
     PS1_PWM_MODULATOR->ETCLR.bit.INT = 1;
     PS1_PWM_MODULATOR_NEG->ETCLR.bit.INT = 1;
     PS2_PWM_MODULATOR->ETCLR.bit.INT = 1;
@@ -1010,25 +1061,7 @@ static void close_relay(uint16_t id)
  */
 static void check_interlocks_ps_module(uint16_t id)
 {
-    if(fabs(g_controller_ctom.net_signals[id].f) > MAX_ILOAD(id))
-    {
-        set_hard_interlock(id, Load_Overcurrent);
-    }
-
-    if(fabs(g_controller_mtoc.net_signals[id].f) > MAX_DCLINK(id))
-    {
-        set_hard_interlock(id, DCLink_Overvoltage);
-    }
-
-    if(fabs(g_controller_mtoc.net_signals[id+4].f) > MAX_VLOAD(id))
-    {
-        set_hard_interlock(id, Load_Overvoltage);
-    }
-
-    if(fabs(g_controller_mtoc.net_signals[id+8].f) > MAX_TEMP(id))
-    {
-        set_soft_interlock(id, Heatsink_Overtemperature);
-    }
+    run_threshold_interlocks(id, &threshold_itlks[id]);
 
     switch(id)
     {
@@ -20,9 +20,11 @@
  */
 
 #include "boards/udc_c28.h"
+#include "common/timestamp.h"
 #include "control/control.h"
 #include "event_manager/event_manager.h"
 #include "ipc/ipc.h"
+#include "postmortem/postmortem.h"
 #include "pwm/pwm.h"
 
 #include "fbp_dclink.h"
@@ -100,12 +102,15 @@ typedef enum
 /**
  * Private functions
  */
+#pragma CODE_SECTION(isr_timebase, "ramfuncs");
+
 static void init_controller(void);
 
 static void init_peripherals_drivers(void);
 
 static void init_interruptions(void);
 static void term_interruptions(void);
+static interrupt void isr_timebase(void);
 
 static void turn_on(uint16_t id);
 static void turn_off(uint16_t id);
@@ -178,6 +183,11 @@ static void init_controller(void)
                    &turn_on, &turn_off, &isr_soft_interlock,
                    &isr_hard_interlock, &reset_interlocks);
 
+    init_soe();
+    reset_itlk_latency();
+    init_postmortem(&g_postmortem, POSTMORTEM_DECIMATION,
+                    POSTMORTEM_POST_TRIGGER);
+
     init_event_manager(0, ISR_FREQ_INTERLOCK_TIMEBASE,
                        NUM_HARD_INTERLOCKS, NUM_SOFT_INTERLOCKS,
                        &HARD_INTERLOCKS_DEBOUNCE_TIME,
@@ -200,6 +210,7 @@ static void init_peripherals_drivers(void)
 {
     /// Initialization of timers
     InitCpuTimers();
+    init_timestamp();
 
     /// Timer for time-base of interlocks debouncing
     ConfigCpuTimer(&CpuTimer0, C28_FREQ_MHZ, (1000000.0/ISR_FREQ_INTERLOCK_TIMEBASE) );
@@ -209,7 +220,7 @@ static void init_peripherals_drivers(void)
 static void init_interruptions(void)
 {
     EALLOW;
-    PieVectTable.TINT0 = &isr_interlocks_timebase;
+    PieVectTable.TINT0 = &isr_timebase;
     EDIS;
 
     /// Enable TINT0 in the PIE: Group 1 interrupt 7
@@ -223,6 +234,23 @@ static void init_interruptions(void)
     ERTM;
 }
 
+/**
+ * Interlocks time-base ISR. Since this module has no control ISR, it's also
+ * the fixed-rate tick for status snapshot and post-mortem.
+ */
+static interrupt void isr_timebase(void)
+{
+    SET_INTERLOCKS_TIMEBASE_FLAG(0);
+
+    /// Keep 64-bit timestamp extension up to date
+    get_timestamp64();
+
+    run_ipc_snapshot();
+    run_postmortem(&g_postmortem);
+
+    PieCtrlRegs.PIEACK.all |= PIEACK_GROUP1;
+}
+
 /**
  * Turn on specified power supply.
  *
@@ -26,6 +26,9 @@
 
 #include "pwm.h"
 
+#pragma CODE_SECTION(set_pwm_period,"ramfuncs");
+#pragma CODE_SECTION(get_pwm_elapsed_fraction,"ramfuncs");
+
 #define STATUS_SUCCESS  1
 #define STATUS_FAIL     0
 #define AUTOCONVERT     0   // 0: Off ; 1: On
@@ -78,6 +81,43 @@ uint16_t set_pwm_freq(volatile struct EPWM_REGS *p_pwm_module, double freq)
     return period;
 }
 
+/**
+ * Set period of specified PWM module, in system clocks. Period is loaded from
+ * shadow register on next counter zero event, so it may be changed while
+ * counter is running without glitches.
+ *
+ * @param p_pwm_module specified PWM module
+ * @param period TBPRD register value
+ */
+void set_pwm_period(volatile struct EPWM_REGS *p_pwm_module, uint16_t period)
+{
+    p_pwm_module->TBCTL.bit.PRDLD = TB_SHADOW;
+    p_pwm_module->TBPRD = period;
+}
+
+/**
+ * Get elapsed fraction of current interrupt period of specified PWM module,
+ * taking into account interrupt event prescaling (ETPS.INTPRD).
+ *
+ * @param p_pwm_module specified PWM module
+ * @return elapsed fraction of interrupt period [0.0 - 1.0)
+ */
+float get_pwm_elapsed_fraction(volatile struct EPWM_REGS *p_pwm_module)
+{
+    float fraction;
+
+    fraction = (float) p_pwm_module->TBCTR /
+               ((float) p_pwm_module->TBPRD + 1.0);
+
+    if(p_pwm_module->ETPS.bit.INTPRD > 1)
+    {
+        fraction = ((float) p_pwm_module->ETPS.bit.INTCNT + fraction) /
+                   (float) p_pwm_module->ETPS.bit.INTPRD;
+    }
+
+    return fraction;
+}
+
 /**
  * Set dead time between channel A and B from specified PWM module. It applies
  * only when channel B configured as complementary. See `cfg_pwm_channel_b()`
@@ -358,11 +398,21 @@ void init_pwm_module(volatile struct EPWM_REGS *p_pwm_module, double freq,
  */
 void enable_pwm_output(uint16_t pwm_module)
 {
+    uint16_t int_status;
+
+    /**
+     * Trip flag and PWM state are updated together, so trip-zone ISR never
+     * sees them inconsistent
+     */
+    int_status = __disable_interrupts();
+
     // Clear trip flag, enabling PWM outputs
     EALLOW;
     g_pwm_modules.pwm_regs[pwm_module]->TZCLR.bit.OST = 1;
     g_pwm_modules.pwm_state[pwm_module] = PWM_ENABLED;
     EDIS;
+
+    __restore_interrupts(int_status);
 }
 
 /**
@@ -372,11 +422,21 @@ void enable_pwm_output(uint16_t pwm_module)
  */
 void disable_pwm_output(uint16_t pwm_module)
 {
+    uint16_t int_status;
+
+    /**
+     * PWM state is updated before forcing trip, and both with interrupts
+     * disabled, so trip-zone ISR doesn't take it as a hardware trip
+     */
+    int_status = __disable_interrupts();
+
     // Force trip via software, disabling PWM outputs
     EALLOW;
-    g_pwm_modules.pwm_regs[pwm_module]->TZFRC.bit.OST = 1;
     g_pwm_modules.pwm_state[pwm_module] = PWM_DISABLED;
+    g_pwm_modules.pwm_regs[pwm_module]->TZFRC.bit.OST = 1;
     EDIS;
+
+    __restore_interrupts(int_status);
 }
 
 
@@ -385,7 +445,9 @@ void disable_pwm_output(uint16_t pwm_module)
  */
 void enable_pwm_outputs(void)
 {
-    uint16_t i;
+    uint16_t i, int_status;
+
+    int_status = __disable_interrupts();
 
     // Clear trip flags, enabling PWM outputs
     EALLOW;
@@ -395,6 +457,8 @@ void enable_pwm_outputs(void)
         g_pwm_modules.pwm_state[i] = PWM_ENABLED;
     }
     EDIS;
+
+    __restore_interrupts(int_status);
 }
 
 /**
@@ -402,14 +466,109 @@ void enable_pwm_outputs(void)
  */
 void disable_pwm_outputs(void)
 {
-    uint16_t i;
+    uint16_t i, int_status;
+
+    int_status = __disable_interrupts();
 
     // Force trip via software, disabling PWM outputs
     EALLOW;
     for(i = 0; i < g_pwm_modules.num_modules; i++)
     {
-        g_pwm_modules.pwm_regs[i]->TZFRC.bit.OST = 1;
         g_pwm_modules.pwm_state[i] = PWM_DISABLED;
+        g_pwm_modules.pwm_regs[i]->TZFRC.bit.OST = 1;
+    }
+    EDIS;
+
+    __restore_interrupts(int_status);
+}
+
+/**
+ * Map specified C28 GPIO to trip-zone input. A falling edge on this GPIO
+ * forces outputs off by hardware on every PWM module which has this input
+ * enabled. TZ1 is reserved for enabling/disabling outputs via software.
+ *
+ * @param tz trip-zone input [2 - 3]
+ * @param gpio C28 GPIO [0 - 63]
+ * @return 1 if arguments are invalid, 0 otherwise
+ */
+uint16_t cfg_pwm_trip_zone_input(uint16_t tz, uint16_t gpio)
+{
+    if(gpio > 63)
+    {
+        return 1;
+    }
+
+    EALLOW;
+    switch(tz)
+    {
+        case 2:
+        {
+            GpioG1TripRegs.GPTRIP2SEL.bit.GPTRIP2SEL = gpio;
+            break;
+        }
+
+        case 3:
+        {
+            GpioG1TripRegs.GPTRIP3SEL.bit.GPTRIP3SEL = gpio;
+            break;
+        }
+
+        default:
+        {
+            EDIS;
+            return 1;
+        }
+    }
+    EDIS;
+
+    return 0;
+}
+
+/**
+ * Enable specified trip-zone input as one-shot trip source of specified PWM
+ * module, also enabling its trip-zone interrupt, so software is notified.
+ *
+ * @param p_pwm_module specified PWM module
+ * @param tz trip-zone input [2 - 3]
+ */
+void enable_pwm_trip_zone(volatile struct EPWM_REGS *p_pwm_module, uint16_t tz)
+{
+    EALLOW;
+    if(tz == 2)
+    {
+        p_pwm_module->TZSEL.bit.OSHT2 = 1;
+    }
+    else if(tz == 3)
+    {
+        p_pwm_module->TZSEL.bit.OSHT3 = 1;
+    }
+
+    p_pwm_module->TZCLR.bit.INT = 1;
+    p_pwm_module->TZEINT.bit.OST = 1;
+    EDIS;
+}
+
+/**
+ * Disable specified trip-zone input as trip source of specified PWM module.
+ *
+ * @param p_pwm_module specified PWM module
+ * @param tz trip-zone input [2 - 3]
+ */
+void disable_pwm_trip_zone(volatile struct EPWM_REGS *p_pwm_module, uint16_t tz)
+{
+    EALLOW;
+    if(tz == 2)
+    {
+        p_pwm_module->TZSEL.bit.OSHT2 = 0;
+    }
+    else if(tz == 3)
+    {
+        p_pwm_module->TZSEL.bit.OSHT3 = 0;
+    }
+
+    if(!p_pwm_module->TZSEL.bit.OSHT2 && !p_pwm_module->TZSEL.bit.OSHT3)
+    {
+        p_pwm_module->TZEINT.bit.OST = 0;
     }
     EDIS;
 }
@@ -63,6 +63,9 @@ extern pwm_modules_t g_pwm_modules;
 
 extern uint16_t set_pwm_freq(volatile struct EPWM_REGS *p_pwm_module,
                              double freq);
+extern void set_pwm_period(volatile struct EPWM_REGS *p_pwm_module,
+                           uint16_t period);
+extern float get_pwm_elapsed_fraction(volatile struct EPWM_REGS *p_pwm_module);
 extern void set_pwm_deadtime(volatile struct EPWM_REGS *p_pwm_module,
                              uint16_t deadtime);
 extern void set_pwm_sync_phase(volatile struct EPWM_REGS *p_pwm_module,
@@ -91,6 +94,12 @@ extern void disable_pwm_output(uint16_t pwm_module);
 extern void enable_pwm_outputs(void);
 extern void disable_pwm_outputs(void);
 
+extern uint16_t cfg_pwm_trip_zone_input(uint16_t tz, uint16_t gpio);
+extern void enable_pwm_trip_zone(volatile struct EPWM_REGS *p_pwm_module,
+                                 uint16_t tz);
+extern void disable_pwm_trip_zone(volatile struct EPWM_REGS *p_pwm_module,
+                                  uint16_t tz);
+
 extern void enable_pwm_tbclk(void);
 extern void disable_pwm_tbclk(void);
 
@@ -22,6 +22,13 @@
 
 #include "scope/scope.h"
 
+#pragma CODE_SECTION(run_scope_shared_ram_delta, "ramfuncs");
+
+static void reset_codec_scope(scope_t *p_scp);
+static void start_block_delta(scope_t *p_scp, int32_t code);
+static inline void put_bits_delta(scope_t *p_scp, uint32_t bits,
+                                  uint16_t num_bits);
+
 void init_scope(scope_t *p_scp, float freq_base, float freq_sampling,
                 float *p_buf_start, uint16_t size, float *p_source,
                 void *p_run_scope)
@@ -29,12 +36,22 @@ void init_scope(scope_t *p_scp, float freq_base, float freq_sampling,
     /// This function needs to run first to set "size" parameter, used by
     /// cfg_freq_scope()
     init_buffer(&p_scp->buffer, p_buf_start, size);
+    p_scp->size = size;
 
     init_timeslicer(&p_scp->timeslicer, freq_base);
     cfg_freq_scope(p_scp, freq_sampling);
 
     p_scp->p_source = p_source;
     p_scp->p_run_scope = p_run_scope;
+
+    p_scp->codec.lsb = 0.0;
+    p_scp->codec.inv_lsb = 0.0;
+    p_scp->codec.offset = 0.0;
+    reset_codec_scope(p_scp);
+
+    p_scp->stamp.timestamp = 0;
+    p_scp->stamp.counter = 0;
+    p_scp->stamp.carrier_phase = 0.0;
 }
 
 void cfg_source_scope(scope_t *p_scp, float *p_source)
@@ -45,14 +62,20 @@ void cfg_source_scope(scope_t *p_scp, float *p_source)
 void cfg_freq_scope(scope_t *p_scp, float freq_sampling)
 {
     cfg_timeslicer(&p_scp->timeslicer, freq_sampling);
-    p_scp->duration = ((float) (size_buffer(&p_scp->buffer) + 1)) / p_scp->timeslicer.freq_sampling;
+    p_scp->duration = ((float) p_scp->size) / p_scp->timeslicer.freq_sampling;
 }
 
 void cfg_duration_scope(scope_t *p_scp, float duration)
 {
     float freq_sampling;
 
-    freq_sampling = ((float) size_buffer(&p_scp->buffer) + 1) / duration;
+    /// Released scope has no duration
+    if(p_scp->size == 0)
+    {
+        return;
+    }
+
+    freq_sampling = ((float) p_scp->size) / duration;
     cfg_freq_scope(p_scp, freq_sampling);
 }
 
@@ -69,13 +92,432 @@ void disable_scope(scope_t *p_scp)
 void reset_scope(scope_t *p_scp)
 {
     reset_buffer(&p_scp->buffer);
+    reset_codec_scope(p_scp);
+
+    p_scp->stamp.timestamp = 0;
+    p_scp->stamp.counter = 0;
+    p_scp->stamp.carrier_phase = 0.0;
 }
 
 void run_scope_shared_ram(scope_t *p_scp)
 {
+    if( (p_scp->buffer.status == Buffering) ||
+        (p_scp->buffer.status == Postmortem) )
+    {
+        latch_frame_stamp(&p_scp->stamp);
+    }
+
     insert_buffer(&p_scp->buffer, *p_scp->p_source);
 }
 
+/**
+ * Configure delta-compressed capture for specified scope. Buffer is reset, and
+ * a new header is written when capture starts.
+ *
+ * @param p_scp pointer to scope
+ * @param lsb quantization step. If 0, compression is disabled.
+ * @param offset quantization offset
+ * @return 0 if successful, 1 if arguments are invalid or buffer is too small
+ */
+uint16_t cfg_compression_scope(scope_t *p_scp, float lsb, float offset)
+{
+    if( (lsb < 0.0) || ( (lsb > 0.0) &&
+        (size_buffer(&p_scp->buffer) + 1 <
+         SCOPE_DELTA_HEADER_SIZE + SCOPE_DELTA_BLOCK_SIZE) ) )
+    {
+        return 1;
+    }
+
+    if(lsb > 0.0)
+    {
+        p_scp->codec.lsb = lsb;
+        p_scp->codec.inv_lsb = 1.0 / lsb;
+        p_scp->codec.offset = offset;
+        p_scp->p_run_scope = &run_scope_shared_ram_delta;
+    }
+    else
+    {
+        p_scp->codec.lsb = 0.0;
+        p_scp->codec.inv_lsb = 0.0;
+        p_scp->codec.offset = 0.0;
+        p_scp->p_run_scope = &run_scope_shared_ram;
+    }
+
+    reset_scope(p_scp);
+
+    return 0;
+}
+
+/**
+ * Insert new sample into delta-compressed buffer. Encoding cost is bounded:
+ * one quantization, up to two 2-word bit insertions and, when a new block is
+ * started, clearing of one block.
+ *
+ * Buffer index pointer addresses the block being filled. As with
+ * run_scope_shared_ram(), blocks wrap around while buffering, and capture
+ * stops after the last block when in postmortem.
+ *
+ * @param p_scp pointer to scope
+ */
+void run_scope_shared_ram_delta(scope_t *p_scp)
+{
+    float code_f;
+    int32_t code, delta;
+    uint32_t zigzag;
+    uint16_t prefix, num_bits;
+
+    if( (p_scp->buffer.status != Buffering) &&
+        (p_scp->buffer.status != Postmortem) )
+    {
+        return;
+    }
+
+    latch_frame_stamp(&p_scp->stamp);
+
+    code_f = (*p_scp->p_source - p_scp->codec.offset) * p_scp->codec.inv_lsb;
+
+    if(code_f > SCOPE_DELTA_MAX_CODE)
+    {
+        code_f = SCOPE_DELTA_MAX_CODE;
+    }
+    else if(code_f < -SCOPE_DELTA_MAX_CODE)
+    {
+        code_f = -SCOPE_DELTA_MAX_CODE;
+    }
+
+    code = (int32_t) ((code_f >= 0.0) ? (code_f + 0.5) : (code_f - 0.5));
+
+    if(p_scp->codec.num_samples)
+    {
+        delta = code - p_scp->codec.last_code;
+        zigzag = ((uint32_t) delta << 1) ^ ((uint32_t) (delta >> 31));
+
+        if(zigzag < 0x10)
+        {
+            prefix = 0;
+            num_bits = 4;
+        }
+        else if(zigzag < 0x100)
+        {
+            prefix = 1;
+            num_bits = 8;
+        }
+        else if(zigzag < 0x10000)
+        {
+            prefix = 2;
+            num_bits = 16;
+        }
+        else
+        {
+            prefix = 3;
+            num_bits = 32;
+        }
+
+        if(p_scp->codec.bit_pos + 2 + num_bits <= SCOPE_DELTA_BLOCK_BITS)
+        {
+            put_bits_delta(p_scp, prefix, 2);
+            put_bits_delta(p_scp, zigzag, num_bits);
+
+            p_scp->codec.last_code = code;
+            p_scp->codec.num_samples++;
+
+            ((volatile uint32_t *) p_scp->buffer.p_buf_idx)[1] =
+                    p_scp->codec.num_samples;
+            return;
+        }
+
+        /// Current block is full: move to next one
+        p_scp->buffer.p_buf_idx += SCOPE_DELTA_BLOCK_SIZE;
+
+        if(p_scp->buffer.p_buf_idx + SCOPE_DELTA_BLOCK_SIZE - 1 >
+           p_scp->buffer.p_buf_end)
+        {
+            p_scp->buffer.p_buf_idx = p_scp->buffer.p_buf_start +
+                                      SCOPE_DELTA_HEADER_SIZE;
+
+            if(p_scp->buffer.status == Postmortem)
+            {
+                p_scp->buffer.status = Disabled;
+                p_scp->codec.num_samples = 0;
+                return;
+            }
+        }
+    }
+
+    start_block_delta(p_scp, code);
+}
+
+/**
+ * Initialization of scope arena, releasing all previously allocated buffers.
+ *
+ * @param p_arena pointer to scope arena
+ * @param p_start pointer to the first element of samples array
+ * @param size number of elements of samples array
+ */
+void init_scope_arena(scope_arena_t *p_arena, volatile float *p_start,
+                      uint16_t size)
+{
+    p_arena->p_start = p_start;
+    p_arena->size = size;
+    p_arena->size_reserved = 0;
+    p_arena->num_scopes = 0;
+}
+
+/**
+ * Initialize scope with a buffer of specified size allocated from arena. A
+ * scope with size 0 holds no buffer, but keeps its place on arena, so it may
+ * be resized later.
+ *
+ * @param p_arena pointer to scope arena
+ * @param p_scp pointer to scope
+ * @param freq_base frequency of calls to RUN_SCOPE() [Hz]
+ * @param freq_sampling sampling frequency of scope [Hz]
+ * @param size number of samples of scope buffer
+ * @param p_source pointer to source signal
+ * @param p_run_scope pointer to scope run function
+ * @return 0 if successful, 1 if there is not enough space on arena
+ */
+uint16_t alloc_scope(scope_arena_t *p_arena, scope_t *p_scp,
+                     float freq_base, float freq_sampling, uint16_t size,
+                     float *p_source, void *p_run_scope)
+{
+    if( (p_arena->num_scopes >= NUM_MAX_SCOPES) ||
+        (size > size_free_scope_arena(p_arena)) )
+    {
+        return 1;
+    }
+
+    init_scope(p_scp, freq_base, freq_sampling,
+               (float *) (p_arena->p_start + p_arena->size -
+                          size_free_scope_arena(p_arena)),
+               size, p_source, p_run_scope);
+
+    p_arena->p_scopes[p_arena->num_scopes++] = p_scp;
+
+    return 0;
+}
+
+/**
+ * Change buffer size of specified scope. Scopes allocated after it are moved
+ * to keep arena contiguous, and buffers which are moved or resized are
+ * cleared and disabled. Sampling frequency is kept, so duration is updated.
+ * Size 0 releases the buffer of specified scope, so its samples may be given
+ * to other scopes. Compression is disabled on buffers too small for it.
+ *
+ * Layout is updated with interrupts disabled, so it's never seen half-done by
+ * control ISR. Buffers are cleared afterwards, with interrupts enabled, since
+ * affected scopes are already disabled.
+ *
+ * @param p_arena pointer to scope arena
+ * @param p_scp pointer to scope
+ * @param size new number of samples of scope buffer
+ * @return 0 if successful, 1 if scope isn't allocated from arena or if there
+ *         is not enough space on arena
+ */
+uint16_t cfg_size_scope(scope_arena_t *p_arena, scope_t *p_scp, uint16_t size)
+{
+    uint16_t i, total, int_status, changed;
+    volatile float *p_buf_start;
+    scope_t *p_arena_scp;
+
+    total = 0;
+
+    for(i = 0; i < p_arena->num_scopes; i++)
+    {
+        if(p_arena->p_scopes[i] == p_scp)
+        {
+            break;
+        }
+
+        total += p_arena->p_scopes[i]->size;
+    }
+
+    if(i == p_arena->num_scopes)
+    {
+        return 1;
+    }
+
+    for( ; i < p_arena->num_scopes; i++)
+    {
+        total += (p_arena->p_scopes[i] == p_scp) ? size :
+                                                   p_arena->p_scopes[i]->size;
+    }
+
+    if(total > p_arena->size - p_arena->size_reserved)
+    {
+        return 1;
+    }
+
+    changed = 0;
+
+    int_status = __disable_interrupts();
+
+    p_scp->size = size;
+    p_buf_start = p_arena->p_start;
+
+    for(i = 0; i < p_arena->num_scopes; i++)
+    {
+        p_arena_scp = p_arena->p_scopes[i];
+
+        if( (p_arena_scp == p_scp) ||
+            (p_arena_scp->buffer.p_buf_start != p_buf_start) )
+        {
+            p_arena_scp->buffer.status = Disabled;
+            p_arena_scp->buffer.p_buf_start = p_buf_start;
+            p_arena_scp->buffer.p_buf_end = p_buf_start + p_arena_scp->size - 1;
+            p_arena_scp->buffer.p_buf_idx = p_buf_start;
+
+            if( (p_arena_scp->codec.lsb > 0.0) &&
+                (p_arena_scp->size < SCOPE_DELTA_HEADER_SIZE +
+                                     SCOPE_DELTA_BLOCK_SIZE) )
+            {
+                p_arena_scp->codec.lsb = 0.0;
+                p_arena_scp->codec.inv_lsb = 0.0;
+                p_arena_scp->codec.offset = 0.0;
+                p_arena_scp->p_run_scope = &run_scope_shared_ram;
+            }
+
+            reset_codec_scope(p_arena_scp);
+            cfg_freq_scope(p_arena_scp, p_arena_scp->timeslicer.freq_sampling);
+
+            changed |= (1 << i);
+        }
+
+        p_buf_start += p_arena_scp->size;
+    }
+
+    __restore_interrupts(int_status);
+
+    for(i = 0; i < p_arena->num_scopes; i++)
+    {
+        if( (changed & (1 << i)) && p_arena->p_scopes[i]->size )
+        {
+            reset_buffer(&p_arena->p_scopes[i]->buffer);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Return number of samples neither allocated to scopes nor reserved on arena.
+ *
+ * @param p_arena pointer to scope arena
+ * @return number of free samples
+ */
+uint16_t size_free_scope_arena(scope_arena_t *p_arena)
+{
+    uint16_t i, total;
+
+    total = p_arena->size_reserved;
+
+    for(i = 0; i < p_arena->num_scopes; i++)
+    {
+        total += p_arena->p_scopes[i]->size;
+    }
+
+    return p_arena->size - total;
+}
+
+/**
+ * Reserve specified number of samples at the end of arena, which starts at
+ * ```p_start + size - size_reserved```. Previous reservation is replaced, so
+ * size 0 releases it. Space must be freed from scopes beforehand.
+ *
+ * @param p_arena pointer to scope arena
+ * @param size number of reserved samples
+ * @return 0 if successful, 1 if there is not enough space on arena
+ */
+uint16_t reserve_scope_arena(scope_arena_t *p_arena, uint16_t size)
+{
+    if(size > size_free_scope_arena(p_arena) + p_arena->size_reserved)
+    {
+        return 1;
+    }
+
+    p_arena->size_reserved = size;
+
+    return 0;
+}
+
+static void reset_codec_scope(scope_t *p_scp)
+{
+    p_scp->codec.last_code = 0;
+    p_scp->codec.bit_pos = 0;
+    p_scp->codec.num_samples = 0;
+    p_scp->codec.block_seq = 0;
+}
+
+/**
+ * Start new block with a keyframe at the position addressed by buffer index
+ * pointer. If it's not past the buffer header yet, header is written first.
+ */
+static void start_block_delta(scope_t *p_scp, int32_t code)
+{
+    uint16_t i;
+    volatile uint32_t *p_block;
+
+    if(p_scp->buffer.p_buf_idx <
+       p_scp->buffer.p_buf_start + SCOPE_DELTA_HEADER_SIZE)
+    {
+        p_block = (volatile uint32_t *) p_scp->buffer.p_buf_start;
+
+        p_block[0] = SCOPE_DELTA_MAGIC;
+        p_scp->buffer.p_buf_start[1] = p_scp->codec.lsb;
+        p_scp->buffer.p_buf_start[2] = p_scp->codec.offset;
+        p_block[3] = ((uint32_t) ((size_buffer(&p_scp->buffer) + 1 -
+                                   SCOPE_DELTA_HEADER_SIZE) /
+                                  SCOPE_DELTA_BLOCK_SIZE) << 16) |
+                     SCOPE_DELTA_BLOCK_SIZE;
+
+        p_scp->buffer.p_buf_idx = p_scp->buffer.p_buf_start +
+                                  SCOPE_DELTA_HEADER_SIZE;
+    }
+
+    p_block = (volatile uint32_t *) p_scp->buffer.p_buf_idx;
+
+    p_scp->codec.block_seq++;
+
+    p_block[0] = (uint32_t) code;
+    p_block[1] = 1;
+    p_block[2] = p_scp->codec.block_seq;
+
+    for(i = SCOPE_DELTA_BLOCK_HEADER; i < SCOPE_DELTA_BLOCK_SIZE; i++)
+    {
+        p_block[i] = 0;
+    }
+
+    p_scp->codec.last_code = code;
+    p_scp->codec.bit_pos = 0;
+    p_scp->codec.num_samples = 1;
+}
+
+/**
+ * Append ```num_bits``` less significant bits of ```bits``` to bitstream of
+ * current block. Caller must ensure they fit in the block.
+ */
+static inline void put_bits_delta(scope_t *p_scp, uint32_t bits,
+                                  uint16_t num_bits)
+{
+    uint16_t word, shift;
+    volatile uint32_t *p_stream;
+
+    p_stream = ((volatile uint32_t *) p_scp->buffer.p_buf_idx) +
+               SCOPE_DELTA_BLOCK_HEADER;
+
+    word = p_scp->codec.bit_pos >> 5;
+    shift = p_scp->codec.bit_pos & 0x1F;
+
+    p_stream[word] |= bits << shift;
+
+    if( shift && (shift + num_bits > 32) )
+    {
+        p_stream[word + 1] |= bits >> (32 - shift);
+    }
+
+    p_scp->codec.bit_pos += num_bits;
+}
+
 /// TODO: Prototype for function which uses onboard RAM
 void run_scope_onboard_ram(scope_t *p_scp)
 {
@@ -26,14 +26,66 @@
 #include <stdint.h>
 #include "common/structs.h"
 #include "common/timeslicer.h"
+#include "common/timestamp.h"
 
 #define NUM_MAX_SCOPES      4
 
+/**
+ * Delta-compressed capture format
+ *
+ * Samples are quantized as ```code = round((x - offset) / lsb)```, where
+ * ```lsb``` is usually the LSB of the HRADC which acquires the source signal,
+ * so compression is lossless with respect to acquisition resolution. Buffer
+ * is interpreted as an array of 32-bit words:
+ *
+ *  - Header (SCOPE_DELTA_HEADER_SIZE words):
+ *      [0] SCOPE_DELTA_MAGIC
+ *      [1] lsb (float)
+ *      [2] offset (float)
+ *      [3] block size in words (LSW) | number of blocks (MSW)
+ *
+ *  - Blocks (SCOPE_DELTA_BLOCK_SIZE words each):
+ *      [0]     keyframe: code of first sample (int32)
+ *      [1]     number of samples
+ *      [2]     block sequence number
+ *      [3..]   bitstream of deltas to previous sample, LSB first. Each delta
+ *              is zigzag-encoded and written as a 2-bit prefix followed by
+ *              4, 8, 16 or 32 bits (prefix = 0, 1, 2 or 3).
+ *
+ * A delta which doesn't fit in current block starts a new block with a
+ * keyframe, so every block decodes on its own, and the oldest block after a
+ * wrap-around is the one with lowest sequence number. Sequence number is
+ * 32-bit, so it only wraps around after days of continuous buffering at
+ * control rate. Decoding is done by ARM or host tools.
+ *
+ * Both formats latch the stamp of the acquisition frame of last inserted sample
+ * (see common/timestamp.h) on ```stamp```, from which time of all samples is
+ * recovered with scope sampling frequency.
+ */
+#define SCOPE_DELTA_MAGIC           0x444C5432      // "DLT2"
+#define SCOPE_DELTA_HEADER_SIZE     4
+#define SCOPE_DELTA_BLOCK_SIZE      16
+#define SCOPE_DELTA_BLOCK_HEADER    3
+#define SCOPE_DELTA_BLOCK_BITS      ((SCOPE_DELTA_BLOCK_SIZE - \
+                                      SCOPE_DELTA_BLOCK_HEADER) * 32)
+#define SCOPE_DELTA_MAX_CODE        1073741823.0
+
 #define RUN_SCOPE(scp)  RUN_TIMESLICER(scp.timeslicer)  \
                             scp.p_run_scope(&scp);      \
                             CLEAR_DEBUG_GPIO0;          \
                         END_TIMESLICER(scp.timeslicer)
 
+typedef volatile struct
+{
+    float       lsb;
+    float       inv_lsb;
+    float       offset;
+    int32_t     last_code;
+    uint16_t    bit_pos;
+    uint16_t    num_samples;
+    uint32_t    block_seq;
+} scope_codec_t;
+
 typedef volatile struct scope_t scope_t;
 struct scope_t
 {
@@ -43,8 +95,28 @@ struct scope_t
     float           duration;
     float           *p_source;
     void            (*p_run_scope)(scope_t *p_scp);
+    uint16_t        size;
+    scope_codec_t   codec;
+    frame_stamp_t   stamp;
 };
 
+/**
+ * Arena of samples shared among scopes. Each scope requests a buffer with
+ * configurable length, which is carved from the arena in allocation order.
+ * When a scope is resized, the arena is laid out again and the space is
+ * reclaimed, with scopes after the resized one being moved (and cleared).
+ * Samples at the end of arena may be reserved for other users, such as
+ * post-mortem capture, out of space not allocated to scopes.
+ */
+typedef volatile struct
+{
+    volatile float  *p_start;
+    uint16_t        size;
+    uint16_t        size_reserved;
+    uint16_t        num_scopes;
+    scope_t         *p_scopes[NUM_MAX_SCOPES];
+} scope_arena_t;
+
 inline void run_scope(scope_t *p_scp)
 {
     /*********************************************/
@@ -66,5 +138,17 @@ extern void enable_scope(scope_t *p_scp);
 extern void disable_scope(scope_t *p_scp);
 extern void reset_scope(scope_t *p_scp);
 extern void run_scope_shared_ram(scope_t *p_scp);
+extern void run_scope_shared_ram_delta(scope_t *p_scp);
+extern uint16_t cfg_compression_scope(scope_t *p_scp, float lsb, float offset);
+
+extern void init_scope_arena(scope_arena_t *p_arena, volatile float *p_start,
+                             uint16_t size);
+extern uint16_t alloc_scope(scope_arena_t *p_arena, scope_t *p_scp,
+                            float freq_base, float freq_sampling, uint16_t size,
+                            float *p_source, void *p_run_scope);
+extern uint16_t cfg_size_scope(scope_arena_t *p_arena, scope_t *p_scp,
+                               uint16_t size);
+extern uint16_t size_free_scope_arena(scope_arena_t *p_arena);
+extern uint16_t reserve_scope_arena(scope_arena_t *p_arena, uint16_t size);
 
 #endif
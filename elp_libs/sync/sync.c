@@ -0,0 +1,489 @@
+/******************************************************************************
+ * Copyright (C) 2026 by LNLS - Brazilian Synchrotron Light Laboratory
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. LNLS and
+ * the Brazilian Center for Research in Energy and Materials (CNPEM) are not
+ * liable for any misuse of this material.
+ *
+ *****************************************************************************/
+
+/**
+ * @file sync.c
+ * @brief Synchronization pulse module
+ *
+ * This module timestamps each synchronization pulse from timing system and
+ * keeps statistics about it.
+ *
+ * @author gabriel.brunheira
+ * @date 19/10/2026
+ *
+ */
+
+#include "common/timestamp.h"
+#include "pwm/pwm.h"
+#include "sync.h"
+
+#pragma DATA_SECTION(g_sync,"SHARERAMS1_1_SYNC");
+#pragma DATA_SECTION(g_sync_pll,"SHARERAMS1_1_SYNC");
+volatile sync_t g_sync;
+volatile sync_pll_t g_sync_pll;
+
+#pragma CODE_SECTION(run_sync,"ramfuncs");
+#pragma CODE_SECTION(run_sync_pll,"ramfuncs");
+
+static void set_sync_pll_period(sync_pll_t *p_pll, uint16_t period);
+static uint16_t scale_sync_pll(uint16_t nominal, uint16_t period,
+                               uint16_t period_nominal);
+
+#pragma CODE_SECTION(set_sync_pll_period,"ramfuncs");
+#pragma CODE_SECTION(scale_sync_pll,"ramfuncs");
+
+/// Nominal period and phase of PWM modules and HRADC SoC generator
+static uint16_t pwm_period_nominal[NUM_MAX_PWM_MODULES];
+static uint16_t pwm_phase_nominal[NUM_MAX_PWM_MODULES];
+static uint16_t soc_period_nominal;
+static uint16_t soc_phase_nominal;
+
+/**
+ * Initialization of synchronization pulse module.
+ *
+ * @param p_sync pointer to sync struct
+ * @param freq_nominal nominal frequency of sync pulses, or 0 to take first
+ *                     measured period as nominal [Hz]
+ * @param jitter_bin_width width of jitter histogram bins [s]
+ */
+void init_sync(sync_t *p_sync, float freq_nominal, float jitter_bin_width)
+{
+    cfg_sync(p_sync, freq_nominal, jitter_bin_width);
+}
+
+/**
+ * Configure nominal frequency and jitter histogram. Statistics are cleared.
+ *
+ * @param p_sync pointer to sync struct
+ * @param freq_nominal nominal frequency of sync pulses, or 0 to take first
+ *                     measured period as nominal [Hz]
+ * @param jitter_bin_width width of jitter histogram bins [s]
+ */
+void cfg_sync(sync_t *p_sync, float freq_nominal, float jitter_bin_width)
+{
+    if(freq_nominal > 0.0)
+    {
+        p_sync->period_nominal = (uint32_t) (TIMESTAMP_FREQ / freq_nominal);
+    }
+    else
+    {
+        p_sync->period_nominal = 0;
+    }
+
+    if(jitter_bin_width * TIMESTAMP_FREQ >= 1.0)
+    {
+        p_sync->jitter_bin_width = (uint16_t) (jitter_bin_width * TIMESTAMP_FREQ);
+    }
+    else
+    {
+        p_sync->jitter_bin_width = SYNC_JITTER_BIN_WIDTH;
+    }
+
+    reset_sync(p_sync);
+}
+
+/**
+ * Clear statistics. Nominal period is kept.
+ *
+ * @param p_sync pointer to sync struct
+ */
+void reset_sync(sync_t *p_sync)
+{
+    uint16_t i;
+
+    p_sync->timestamp = 0;
+    p_sync->period = 0;
+    p_sync->period_min = 0xFFFFFFFF;
+    p_sync->period_max = 0;
+    p_sync->jitter = 0;
+
+    for(i = 0; i < SYNC_JITTER_HIST_SIZE; i++)
+    {
+        p_sync->jitter_hist[i] = 0;
+    }
+
+    p_sync->counter_pulses = 0;
+    p_sync->counter_xint = 0;
+    p_sync->counter_ipc = 0;
+    p_sync->counter_missed = 0;
+    p_sync->drift_ppm = 0.0;
+}
+
+/**
+ * Register new sync pulse. It must be called from sync pulse ISR, with the
+ * timestamp taken at ISR entry.
+ *
+ * @param p_sync pointer to sync struct
+ * @param timestamp 64-bit timestamp of sync pulse [cycles]
+ * @param from_ipc 1 if pulse was signaled by ARM, 0 if by XINT2
+ */
+void run_sync(sync_t *p_sync, uint64_t timestamp, uint16_t from_ipc)
+{
+    uint32_t period, num_periods;
+    int32_t jitter;
+    int32_t bin;
+
+    if(from_ipc)
+    {
+        p_sync->counter_ipc++;
+    }
+    else
+    {
+        p_sync->counter_xint++;
+    }
+
+    /// First pulse only sets time reference
+    if(p_sync->counter_pulses++ == 0)
+    {
+        p_sync->timestamp = timestamp;
+        return;
+    }
+
+    period = (uint32_t) (timestamp - p_sync->timestamp);
+    p_sync->timestamp = timestamp;
+    p_sync->period = period;
+
+    if(p_sync->period_nominal == 0)
+    {
+        p_sync->period_nominal = period;
+    }
+
+    /// Number of nominal periods elapsed, so missed pulses are accounted
+    num_periods = (period + (p_sync->period_nominal >> 1)) /
+                  p_sync->period_nominal;
+
+    if(num_periods == 0)
+    {
+        num_periods = 1;
+    }
+    else if(num_periods > 1)
+    {
+        p_sync->counter_missed += num_periods - 1;
+    }
+    else
+    {
+        if(period < p_sync->period_min)
+        {
+            p_sync->period_min = period;
+        }
+
+        if(period > p_sync->period_max)
+        {
+            p_sync->period_max = period;
+        }
+    }
+
+    jitter = (int32_t) (period - num_periods * p_sync->period_nominal);
+    p_sync->jitter = jitter;
+
+    /// Histogram is centered on zero jitter, with bins rounded down
+    if(jitter >= 0)
+    {
+        bin = jitter / (int32_t) p_sync->jitter_bin_width;
+    }
+    else
+    {
+        bin = -((-jitter + (int32_t) p_sync->jitter_bin_width - 1) /
+                (int32_t) p_sync->jitter_bin_width);
+    }
+
+    bin += SYNC_JITTER_HIST_SIZE >> 1;
+
+    if(bin < 0)
+    {
+        bin = 0;
+    }
+    else if(bin >= SYNC_JITTER_HIST_SIZE)
+    {
+        bin = SYNC_JITTER_HIST_SIZE - 1;
+    }
+
+    p_sync->jitter_hist[bin]++;
+
+    p_sync->drift_ppm += SYNC_DRIFT_FILTER_GAIN *
+                         ( ((float) jitter * 1.0e6 /
+                            ((float) num_periods * (float) p_sync->period_nominal))
+                           - p_sync->drift_ppm );
+}
+
+/**
+ * Initialization of sync PLL. It starts disabled, with default gains.
+ *
+ * @param p_pll pointer to sync PLL struct
+ */
+void init_sync_pll(sync_pll_t *p_pll)
+{
+    p_pll->enable = 0;
+    p_pll->locked = 0;
+    p_pll->counter_unlock = 0;
+
+    cfg_sync_pll(p_pll, SYNC_PLL_KP, SYNC_PLL_KI, 0);
+}
+
+/**
+ * Configure sync PLL controller. Integrator is cleared.
+ *
+ * @param p_pll pointer to sync PLL struct
+ * @param kp proportional gain [pu of phase error per pulse]
+ * @param ki integral gain [pu of accumulated phase error per pulse]
+ * @param phase_target PWM master counter value on sync pulse, which may be
+ *                     used to compensate ISR latency [cycles]
+ */
+void cfg_sync_pll(sync_pll_t *p_pll, float kp, float ki, uint16_t phase_target)
+{
+    p_pll->kp = kp;
+    p_pll->ki = ki;
+    p_pll->phase_target = phase_target;
+    p_pll->integral = 0.0;
+    p_pll->counter_in_window = 0;
+    p_pll->locked = 0;
+}
+
+/**
+ * Enable sync PLL. Current periods and phases of PWM modules and HRADC SoC
+ * generator are taken as nominal ones. It must be called after PWM modules
+ * and HRADC initialization.
+ *
+ * @param p_pll pointer to sync PLL struct
+ */
+void enable_sync_pll(sync_pll_t *p_pll)
+{
+    uint16_t i;
+
+    if(!p_pll->enable)
+    {
+        for(i = 0; i < g_pwm_modules.num_modules; i++)
+        {
+            pwm_period_nominal[i] = g_pwm_modules.pwm_regs[i]->TBPRD;
+            pwm_phase_nominal[i] = g_pwm_modules.pwm_regs[i]->TBPHS.half.TBPHS;
+        }
+
+        soc_period_nominal = SYNC_HRADC_SOC.TBPRD;
+        soc_phase_nominal = SYNC_HRADC_SOC.TBPHS.half.TBPHS;
+
+        p_pll->period_nominal = SYNC_PWM_MASTER.TBPRD;
+        p_pll->period = p_pll->period_nominal;
+        p_pll->max_trim = (uint16_t) ((float) p_pll->period_nominal *
+                                      SYNC_PLL_MAX_TRIM);
+        p_pll->integral = 0.0;
+        p_pll->counter_in_window = 0;
+        p_pll->locked = 0;
+        p_pll->enable = 1;
+    }
+}
+
+/**
+ * Disable sync PLL, restoring nominal period of PWM modules.
+ *
+ * @param p_pll pointer to sync PLL struct
+ */
+void disable_sync_pll(sync_pll_t *p_pll)
+{
+    if(p_pll->enable)
+    {
+        p_pll->enable = 0;
+        p_pll->locked = 0;
+        set_sync_pll_period(p_pll, p_pll->period_nominal);
+    }
+}
+
+/**
+ * Restart lock detection of sync PLL, after PWM time base was stopped or
+ * reloaded, which breaks its phase relation to sync pulses. Integrator is
+ * kept, since it holds the frequency offset of local clock, which isn't
+ * affected.
+ *
+ * @param p_pll pointer to sync PLL struct
+ */
+void relock_sync_pll(sync_pll_t *p_pll)
+{
+    uint16_t int_status;
+
+    int_status = __disable_interrupts();
+
+    if(p_pll->enable)
+    {
+        if(p_pll->locked)
+        {
+            p_pll->counter_unlock++;
+        }
+
+        p_pll->counter_in_window = 0;
+        p_pll->locked = 0;
+    }
+
+    __restore_interrupts(int_status);
+}
+
+/**
+ * Run sync PLL. It must be called from sync pulse ISR, after run_sync(), with
+ * PWM master counter value taken at ISR entry.
+ *
+ * @param p_pll pointer to sync PLL struct
+ * @param p_sync pointer to sync struct
+ * @param counter PWM master counter (TBCTR) on sync pulse
+ */
+void run_sync_pll(sync_pll_t *p_pll, sync_t *p_sync, uint16_t counter)
+{
+    int32_t error, half_period;
+    float trim;
+
+    if( !p_pll->enable || (p_sync->period_nominal == 0) )
+    {
+        return;
+    }
+
+    /// Number of PWM periods per sync pulse period
+    p_pll->num_periods = (p_sync->period_nominal +
+                          ((uint32_t) p_pll->period_nominal >> 1)) /
+                         ((uint32_t) p_pll->period_nominal + 1);
+
+    if(p_pll->num_periods == 0)
+    {
+        return;
+    }
+
+    /**
+     * Phase error is wrapped around PWM period. It's positive when PWM counter
+     * is ahead of sync pulse, so period must be increased.
+     */
+    half_period = ((int32_t) p_pll->period_nominal + 1) >> 1;
+    error = (int32_t) counter - (int32_t) p_pll->phase_target;
+
+    if(error > half_period)
+    {
+        error -= (int32_t) p_pll->period_nominal + 1;
+    }
+    else if(error < -half_period)
+    {
+        error += (int32_t) p_pll->period_nominal + 1;
+    }
+
+    p_pll->phase_error = error;
+
+    /// Trim is spread over all PWM periods until next sync pulse
+    p_pll->integral += p_pll->ki * (float) error;
+
+    if(p_pll->integral > (float) p_pll->max_trim * (float) p_pll->num_periods)
+    {
+        p_pll->integral = (float) p_pll->max_trim * (float) p_pll->num_periods;
+    }
+    else if(p_pll->integral < -(float) p_pll->max_trim * (float) p_pll->num_periods)
+    {
+        p_pll->integral = -(float) p_pll->max_trim * (float) p_pll->num_periods;
+    }
+
+    trim = (p_pll->kp * (float) error + p_pll->integral) /
+           (float) p_pll->num_periods;
+
+    if(trim > (float) p_pll->max_trim)
+    {
+        trim = (float) p_pll->max_trim;
+    }
+    else if(trim < -(float) p_pll->max_trim)
+    {
+        trim = -(float) p_pll->max_trim;
+    }
+
+    /// Round to nearest
+    if(trim >= 0.0)
+    {
+        trim += 0.5;
+    }
+    else
+    {
+        trim -= 0.5;
+    }
+
+    set_sync_pll_period(p_pll, (uint16_t) ((int32_t) p_pll->period_nominal +
+                                           (int32_t) trim));
+
+    /// Lock detection
+    if( (error <= SYNC_PLL_LOCK_WINDOW) && (error >= -SYNC_PLL_LOCK_WINDOW) )
+    {
+        if(p_pll->counter_in_window < SYNC_PLL_LOCK_COUNT)
+        {
+            p_pll->counter_in_window++;
+        }
+        else
+        {
+            p_pll->locked = 1;
+        }
+    }
+    else
+    {
+        if(p_pll->locked)
+        {
+            p_pll->counter_unlock++;
+        }
+
+        p_pll->counter_in_window = 0;
+        p_pll->locked = 0;
+    }
+}
+
+/**
+ * Set period of PWM master. Period and phase of all PWM modules and HRADC SoC
+ * generator are scaled from their nominal values by the same ratio. Phases
+ * are loaded on next sync event from PWM master, which happens when new
+ * period takes effect.
+ *
+ * @param p_pll pointer to sync PLL struct
+ * @param period TBPRD register value of PWM master
+ */
+static void set_sync_pll_period(sync_pll_t *p_pll, uint16_t period)
+{
+    uint16_t i;
+
+    p_pll->period = period;
+
+    for(i = 0; i < g_pwm_modules.num_modules; i++)
+    {
+        set_pwm_period(g_pwm_modules.pwm_regs[i],
+                       scale_sync_pll(pwm_period_nominal[i], period,
+                                      p_pll->period_nominal));
+        g_pwm_modules.pwm_regs[i]->TBPHS.half.TBPHS =
+                       scale_sync_pll(pwm_phase_nominal[i], period,
+                                      p_pll->period_nominal);
+    }
+
+    /// HRADC SoC generator is not configured on modules without HRADC
+    if(soc_period_nominal)
+    {
+        set_pwm_period(&SYNC_HRADC_SOC,
+                       scale_sync_pll(soc_period_nominal, period,
+                                      p_pll->period_nominal));
+        SYNC_HRADC_SOC.TBPHS.half.TBPHS =
+                       scale_sync_pll(soc_phase_nominal, period,
+                                      p_pll->period_nominal);
+    }
+}
+
+/**
+ * Scale nominal register value by ratio between new and nominal PWM master
+ * periods, rounding to nearest.
+ *
+ * @param nominal nominal register value
+ * @param period new PWM master period
+ * @param period_nominal nominal PWM master period
+ * @return scaled register value
+ */
+static uint16_t scale_sync_pll(uint16_t nominal, uint16_t period,
+                               uint16_t period_nominal)
+{
+    if( (period == period_nominal) || (period_nominal == 0) )
+    {
+        return nominal;
+    }
+
+    return (uint16_t) (((uint32_t) nominal * (uint32_t) period +
+                        ((uint32_t) period_nominal >> 1)) /
+                       (uint32_t) period_nominal);
+}
@@ -0,0 +1,108 @@
+/******************************************************************************
+ * Copyright (C) 2026 by LNLS - Brazilian Synchrotron Light Laboratory
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. LNLS and
+ * the Brazilian Center for Research in Energy and Materials (CNPEM) are not
+ * liable for any misuse of this material.
+ *
+ *****************************************************************************/
+
+/**
+ * @file sync.h
+ * @brief Synchronization pulse module
+ *
+ * This module timestamps each synchronization pulse from timing system,
+ * against the 64-bit timestamp, and keeps statistics about it: measured
+ * period, jitter histogram, missed pulses and drift of local clock relative
+ * to timing system. These are published on shared RAM for diagnostics.
+ *
+ * Jitter is the deviation of each measured interval from the closest
+ * multiple of nominal period, so missed pulses don't pollute it. Drift is the
+ * low-pass filtered relative deviation, in ppm, and it's positive when local
+ * clock is faster than timing system.
+ *
+ * It also implements a software PLL, which phase-locks PWM time base (and so
+ * the control ISR) to sync pulses. On each pulse, PWM master counter (ePWM1,
+ * which triggers control ISR on all modules) is compared to target phase, and
+ * a PI controller trims period of all PWM modules around its nominal value.
+ * Period of HRADC SoC generator (ePWM10) and phase of all synchronized modules
+ * are scaled by the same ratio, so sampling instants and interleaving keep
+ * their relation to PWM carrier.
+ * Sync pulse period must be a multiple of PWM period. Since period is trimmed
+ * by whole system clocks, phase error dithers around zero when locked.
+ *
+ * @author gabriel.brunheira
+ * @date 19/10/2026
+ *
+ */
+
+#ifndef SYNC_H_
+#define SYNC_H_
+
+#include <stdint.h>
+
+#define SYNC_PWM_MASTER             EPwm1Regs   // Triggers control ISR
+#define SYNC_HRADC_SOC              EPwm10Regs  // Triggers HRADC conversions
+
+#define SYNC_JITTER_HIST_SIZE       16
+#define SYNC_JITTER_BIN_WIDTH       15          // [cycles]
+#define SYNC_DRIFT_FILTER_GAIN      0.015625    // 1/64
+
+#define SYNC_PLL_KP                 0.5
+#define SYNC_PLL_KI                 0.05
+#define SYNC_PLL_MAX_TRIM           0.01        // [pu of nominal period]
+#define SYNC_PLL_LOCK_WINDOW        150         // [cycles]
+#define SYNC_PLL_LOCK_COUNT         8           // [pulses]
+
+typedef volatile struct
+{
+    uint64_t    timestamp;
+    uint32_t    period;
+    uint32_t    period_nominal;
+    uint32_t    period_min;
+    uint32_t    period_max;
+    int32_t     jitter;
+    uint16_t    jitter_bin_width;
+    uint32_t    jitter_hist[SYNC_JITTER_HIST_SIZE];
+    uint32_t    counter_pulses;
+    uint32_t    counter_xint;
+    uint32_t    counter_ipc;
+    uint32_t    counter_missed;
+    float       drift_ppm;
+} sync_t;
+
+typedef volatile struct
+{
+    uint16_t    enable;
+    uint16_t    locked;
+    uint16_t    counter_in_window;
+    uint16_t    period_nominal;
+    uint16_t    period;
+    uint16_t    max_trim;
+    uint16_t    phase_target;
+    uint32_t    num_periods;
+    int32_t     phase_error;
+    float       kp;
+    float       ki;
+    float       integral;
+    uint32_t    counter_unlock;
+} sync_pll_t;
+
+extern volatile sync_t g_sync;
+extern volatile sync_pll_t g_sync_pll;
+
+extern void init_sync(sync_t *p_sync, float freq_nominal, float jitter_bin_width);
+extern void cfg_sync(sync_t *p_sync, float freq_nominal, float jitter_bin_width);
+extern void reset_sync(sync_t *p_sync);
+extern void run_sync(sync_t *p_sync, uint64_t timestamp, uint16_t from_ipc);
+
+extern void init_sync_pll(sync_pll_t *p_pll);
+extern void cfg_sync_pll(sync_pll_t *p_pll, float kp, float ki,
+                         uint16_t phase_target);
+extern void enable_sync_pll(sync_pll_t *p_pll);
+extern void disable_sync_pll(sync_pll_t *p_pll);
+extern void relock_sync_pll(sync_pll_t *p_pll);
+extern void run_sync_pll(sync_pll_t *p_pll, sync_t *p_sync, uint16_t counter);
+
+#endif /* SYNC_H_ */
@@ -58,6 +58,7 @@ void init_wfmref(wfmref_t *p_wfmref, uint16_t wfmref_selected,
      */
     ///p_wfmref->lerp.inv_decimation = freq_wfmref / freq_lerp;
     p_wfmref->lerp.inv_decimation = 1.0/(roundf(freq_lerp/freq_wfmref));
+    p_wfmref->lerp.delay = 0.0;
     p_wfmref->lerp.out = 0.0;
 }
 
@@ -95,6 +96,7 @@ void reset_wfmref(wfmref_t *p_wfmref)
     }
 
     p_wfmref->lerp.counter = 0;
+    p_wfmref->lerp.delay = 0.0;
     //p_wfmref->lerp.out = *(p_wfmref->wfmref_data[p_wfmref->wfmref_selected].p_buf_end);
 }
 
@@ -113,7 +115,18 @@ void update_wfmref(wfmref_t *p_wfmref, wfmref_t *p_wfmref_new)
     p_wfmref->sync_mode         = p_wfmref_new->sync_mode;
 }
 
-void sync_wfmref(wfmref_t *p_wfmref, wfmref_t *p_wfmref_new)
+/**
+ * Synchronize waveform reference with sync pulse.
+ *
+ * Since waveform only advances on next control ISR, its start is delayed by a
+ * random fraction of ISR period. This is compensated by a fractional offset
+ * on interpolation, which is kept until next sync pulse.
+ *
+ * @param p_wfmref pointer to current waveform reference
+ * @param p_wfmref_new pointer to new waveform reference
+ * @param delay time from sync pulse until next control ISR [pu of ISR period]
+ */
+void sync_wfmref(wfmref_t *p_wfmref, wfmref_t *p_wfmref_new, float delay)
 {
     static uint16_t sel;
 
@@ -191,7 +204,17 @@ void sync_wfmref(wfmref_t *p_wfmref, wfmref_t *p_wfmref_new)
         }
     }
 
+    if(delay < 0.0)
+    {
+        delay = 0.0;
+    }
+    else if(delay > 1.0)
+    {
+        delay = 1.0;
+    }
+
     p_wfmref->lerp.counter = 0;
+    p_wfmref->lerp.delay = delay;
 }
 
 void run_wfmref(wfmref_t *p_wfmref)
@@ -211,7 +234,8 @@ void run_wfmref(wfmref_t *p_wfmref)
                 if(p_wfmref->lerp.counter < p_wfmref->lerp.max_count)
                 {
                     p_wfmref->lerp.fraction = p_wfmref->lerp.inv_decimation *
-                                              p_wfmref->lerp.counter++;
+                                              ((float) p_wfmref->lerp.counter++ +
+                                               p_wfmref->lerp.delay);
 
                     p_wfmref->lerp.out =
                          INTERPOLATE( *(p_wfmref->wfmref_data[sel].p_buf_idx),
@@ -245,7 +269,8 @@ void run_wfmref(wfmref_t *p_wfmref)
                 if(p_wfmref->lerp.counter < p_wfmref->lerp.max_count)
                 {
                     p_wfmref->lerp.fraction = p_wfmref->lerp.inv_decimation *
-                                              p_wfmref->lerp.counter++;
+                                              ((float) p_wfmref->lerp.counter++ +
+                                               p_wfmref->lerp.delay);
 
                     p_wfmref->lerp.out =
                          INTERPOLATE( *(p_wfmref->wfmref_data[sel].p_buf_idx),
@@ -56,6 +56,7 @@ typedef volatile struct
     float           freq_base;
     float           inv_decimation;
     float           fraction;
+    float           delay;
     float           out;
 } wfmref_lerp_t;
 
@@ -161,7 +162,8 @@ extern void init_wfmref(wfmref_t *p_wfmref, uint16_t wfmref_selected,
 extern void cfg_wfmref(wfmref_t *p_wfmref, wfmref_t *p_wfmref_new);
 extern void reset_wfmref(wfmref_t *p_wfmref);
 extern void update_wfmref(wfmref_t *p_wfmref, wfmref_t *p_wfmref_new);
-extern void sync_wfmref(wfmref_t *p_wfmref, wfmref_t *p_wfmref_new);
+extern void sync_wfmref(wfmref_t *p_wfmref, wfmref_t *p_wfmref_new,
+                        float delay);
 extern void run_wfmref(wfmref_t *p_wfmref);
 
 #endif /* WFMREF_H_ */